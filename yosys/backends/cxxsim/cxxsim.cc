@@ -0,0 +1,980 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Clifford Wolf <clifford@clifford.at>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *  ---
+ *
+ *  A backend that writes a compiled cycle-based simulator for a module as a
+ *  C++ class. The combinational cells are sorted topologically once and
+ *  evaluated in that order, all signals are held in cxxsim::value<> words
+ *  (see cxxsim.h).
+ *
+ */
+
+#include "kernel/yosys.h"
+#include "kernel/sigtools.h"
+#include "kernel/celltypes.h"
+
+USING_YOSYS_NAMESPACE
+PRIVATE_NAMESPACE_BEGIN
+
+struct CxxsimWorker
+{
+	// signals with a public name are members with that name, all others are
+	// elements of an array per width (compilers are slow on huge classes)
+	struct var_t {
+		std::string name;
+		int width;
+		std::string array;
+	};
+
+	struct node_t {
+		RTLIL::Cell *cell;
+		std::string code;
+		pool<int> inputs;
+	};
+
+	struct mem_t {
+		std::string name;
+		int width, size;
+	};
+
+	RTLIL::Module *module;
+	std::ostream &f;
+	std::string clock_port;
+	CellTypes ct;
+	SigMap sigmap;
+
+	pool<std::string> used_names;
+	std::vector<var_t> vars;
+	dict<std::string, int> array_sizes;
+	dict<RTLIL::SigBit, std::pair<int, int>> bit_vars;
+
+	std::vector<int> input_vars, output_vars, state_vars, net_vars;
+	dict<RTLIL::Wire*, int> port_vars;
+	std::vector<mem_t> mems;
+	std::string init_code;
+	dict<int, int> net_nodes;
+	std::vector<node_t> nodes;
+
+	static const int chunk_size = 256;
+
+	// clock bits and the code for the update() function
+	dict<RTLIL::SigBit, int> clocks;
+	std::vector<std::string> ff_code;
+	std::string rd_code, wr_code, trans_rd_code;
+
+	CxxsimWorker(RTLIL::Module *module, std::ostream &f, std::string clock_port) :
+			module(module), f(f), clock_port(clock_port), ct(module->design), sigmap(module)
+	{
+	}
+
+	std::string new_name(std::string prefix, RTLIL::IdString hint)
+	{
+		std::string name = prefix;
+		for (auto c : hint.str().substr(1))
+			name += (isalnum(c) ? c : '_');
+		if (used_names.count(name)) {
+			int idx = 1;
+			while (used_names.count(stringf("%s_%d", name.c_str(), idx)))
+				idx++;
+			name = stringf("%s_%d", name.c_str(), idx);
+		}
+		used_names.insert(name);
+		return name;
+	}
+
+	// creates a variable that holds the value of the given signal
+	int add_var(std::string prefix, const RTLIL::SigSpec &sig)
+	{
+		int idx = GetSize(vars);
+		if (sig.is_wire() && sig.as_wire()->name[0] == '\\') {
+			vars.push_back(var_t{new_name(prefix, sig.as_wire()->name), GetSize(sig), ""});
+		} else {
+			std::string array = stringf("%s_%d", prefix == "s_" ? "state" : "nets", GetSize(sig));
+			vars.push_back(var_t{stringf("%s[%d]", array.c_str(), array_sizes[array]++), GetSize(sig), array});
+		}
+
+		for (int i = 0; i < GetSize(sig); i++) {
+			RTLIL::SigBit bit = sigmap(sig[i]);
+			if (bit.wire == nullptr)
+				continue;
+			if (bit_vars.count(bit))
+				log_error("Signal %s in module %s has multiple drivers.\n", log_signal(bit), log_id(module));
+			bit_vars[bit] = std::make_pair(idx, i);
+		}
+		return idx;
+	}
+
+	static std::string value_type(int width) {
+		return stringf("cxxsim::value<%d>", width);
+	}
+
+	// an initializer for a value<>. x and z bits are zero.
+	static std::string value_init(const std::vector<RTLIL::State> &bits)
+	{
+		std::string s = "{{";
+		int words = std::max((GetSize(bits) + 63) / 64, 1);
+		for (int i = 0; i < words; i++) {
+			uint64_t w = 0;
+			for (int j = 0; j < 64 && 64*i+j < GetSize(bits); j++)
+				if (bits[64*i+j] == RTLIL::S1)
+					w |= uint64_t(1) << j;
+			s += stringf("%s0x%llxull", i ? ", " : "", (unsigned long long)w);
+		}
+		return s + "}}";
+	}
+
+	static std::string const_expr(const std::vector<RTLIL::State> &bits) {
+		return value_type(GetSize(bits)) + value_init(bits);
+	}
+
+	// an expression of type value<GetSize(sig)>. undriven bits are zero.
+	std::string expr(const RTLIL::SigSpec &sig, pool<int> *inputs)
+	{
+		// a run is a constant, a part of a variable or a repeated bit of a
+		// variable (as in sign extensions)
+		struct run_t {
+			int var, offset, width;
+			bool repeat;
+			std::vector<RTLIL::State> bits;
+		};
+		std::vector<run_t> runs;
+
+		for (auto bit : sigmap(sig)) {
+			int var = -1, offset = 0;
+			RTLIL::State state = RTLIL::S0;
+			if (bit.wire == nullptr)
+				state = bit.data;
+			else if (bit_vars.count(bit))
+				std::tie(var, offset) = bit_vars.at(bit);
+			if (!runs.empty() && runs.back().var == var) {
+				auto &run = runs.back();
+				if (var < 0 || (!run.repeat && run.offset + run.width == offset)) {
+					run.width++;
+					run.bits.push_back(state);
+					continue;
+				}
+				if ((run.repeat || run.width == 1) && run.offset == offset) {
+					run.width++;
+					run.repeat = true;
+					continue;
+				}
+			}
+			runs.push_back(run_t{var, offset, 1, false, std::vector<RTLIL::State>{state}});
+		}
+
+		if (runs.empty())
+			return "cxxsim::value<0>()";
+
+		std::string s;
+		for (int i = 0; i < GetSize(runs); i++)
+		{
+			auto &run = runs[i];
+			std::string term;
+			if (run.var < 0) {
+				term = const_expr(run.bits);
+			} else {
+				auto &var = vars[run.var];
+				if (inputs != nullptr)
+					inputs->insert(run.var);
+				if (run.repeat)
+					term = stringf("cxxsim::repeat<%d>(%s)", run.width, var.width == 1 ? var.name.c_str() :
+							stringf("%s.slice<1>(%d)", var.name.c_str(), run.offset).c_str());
+				else if (run.offset == 0 && run.width == var.width)
+					term = var.name;
+				else if (run.offset == 0)
+					term = stringf("%s.zext<%d>()", var.name.c_str(), run.width);
+				else
+					term = stringf("%s.slice<%d>(%d)", var.name.c_str(), run.width, run.offset);
+			}
+			s = i ? stringf("cxxsim::concat(%s, %s)", term.c_str(), s.c_str()) : term;
+		}
+		return s;
+	}
+
+	std::string expr(const RTLIL::SigSpec &sig, int width, bool is_signed, pool<int> *inputs)
+	{
+		std::string s = expr(sig, inputs);
+		if (GetSize(sig) == width)
+			return s;
+		return stringf("%s.%s<%d>()", s.c_str(), is_signed ? "sext" : "zext", width);
+	}
+
+	// a boolean expression that is true if the signal has the given level
+	std::string level(RTLIL::SigBit bit, bool polarity, pool<int> *inputs) {
+		return stringf("%s%s.any()", polarity ? "" : "!", expr(bit, inputs).c_str());
+	}
+
+	std::string edge(RTLIL::SigBit bit, bool polarity)
+	{
+		bit = sigmap(bit);
+		if (!clocks.count(bit)) {
+			int idx = GetSize(clocks);
+			clocks[bit] = idx;
+		}
+		return stringf("%s_%d", polarity ? "posedge" : "negedge", clocks.at(bit));
+	}
+
+	void add_node(RTLIL::Cell *cell, std::string code, const pool<int> &inputs, const std::vector<int> &outputs)
+	{
+		int idx = GetSize(nodes);
+		nodes.push_back(node_t{cell, code, inputs});
+		for (int var : outputs)
+			net_nodes[var] = idx;
+	}
+
+	std::string next(int var) {
+		auto &v = vars[var];
+		if (v.array.empty())
+			return v.name + "_next";
+		return v.array + "_next" + v.name.substr(v.array.size());
+	}
+
+	void add_ff(RTLIL::Cell *cell, int q)
+	{
+		int width = vars[q].width;
+
+		std::string type = cell->type.str();
+		std::string code = stringf("\t\t// %s (%s)\n", log_id(cell), log_id(cell->type));
+		std::string q_next = next(q);
+
+		auto param_bool = [&](const char *name) { return cell->getParam(name).as_bool(); };
+		auto sig_d = [&]() { return expr(cell->getPort("\\D"), nullptr); };
+
+		if (type == "$dff" || type == "$dffe" || type == "$adff" || type == "$dffsr")
+		{
+			std::string cond = edge(cell->getPort("\\CLK"), param_bool("\\CLK_POLARITY"));
+			if (type == "$dffe")
+				cond += " && " + level(cell->getPort("\\EN"), param_bool("\\EN_POLARITY"), nullptr);
+			code += stringf("\t\tif (%s)\n\t\t\t%s = %s;\n", cond.c_str(), q_next.c_str(), sig_d().c_str());
+		}
+
+		if (type == "$dlatch" || type == "$dlatchsr") {
+			std::string cond = level(cell->getPort("\\EN"), param_bool("\\EN_POLARITY"), nullptr);
+			code += stringf("\t\tif (%s)\n\t\t\t%s = %s;\n", cond.c_str(), q_next.c_str(), sig_d().c_str());
+		}
+
+		if (type == "$adff") {
+			std::string cond = level(cell->getPort("\\ARST"), param_bool("\\ARST_POLARITY"), nullptr);
+			std::vector<RTLIL::State> value = cell->getParam("\\ARST_VALUE").bits;
+			value.resize(width, RTLIL::S0);
+			code += stringf("\t\tif (%s)\n\t\t\t%s = %s;\n", cond.c_str(), q_next.c_str(), const_expr(value).c_str());
+		}
+
+		if (type == "$dffsr" || type == "$dlatchsr" || type == "$sr") {
+			std::string set = expr(cell->getPort("\\SET"), nullptr);
+			std::string clr = expr(cell->getPort("\\CLR"), nullptr);
+			code += stringf("\t\t%s = (%s | %s%s) & %s%s;\n", q_next.c_str(), q_next.c_str(),
+					param_bool("\\SET_POLARITY") ? "" : "~", set.c_str(), param_bool("\\CLR_POLARITY") ? "~" : "", clr.c_str());
+		}
+
+		// fine-grained cells, the polarities are encoded in the type name
+		if (type.substr(0, 6) == "$_DFF_" || type.substr(0, 7) == "$_DFFE_" || type.substr(0, 8) == "$_DFFSR_") {
+			int pos = type.find('_', 2) + 1;
+			std::string cond = edge(cell->getPort("\\C"), type[pos] == 'P');
+			if (type.substr(0, 7) == "$_DFFE_")
+				cond += " && " + level(cell->getPort("\\E"), type[pos+1] == 'P', nullptr);
+			code += stringf("\t\tif (%s)\n\t\t\t%s = %s;\n", cond.c_str(), q_next.c_str(), sig_d().c_str());
+			if (type.substr(0, 6) == "$_DFF_" && GetSize(type) == 10)
+				code += stringf("\t\tif (%s)\n\t\t\t%s = cxxsim::constant<1>(%c);\n", level(cell->getPort("\\R"), type[pos+1] == 'P',
+						nullptr).c_str(), q_next.c_str(), type[pos+2]);
+		}
+
+		if (type.substr(0, 9) == "$_DLATCH_" || type.substr(0, 11) == "$_DLATCHSR_") {
+			int pos = type.find('_', 2) + 1;
+			std::string cond = level(cell->getPort("\\E"), type[pos] == 'P', nullptr);
+			code += stringf("\t\tif (%s)\n\t\t\t%s = %s;\n", cond.c_str(), q_next.c_str(), sig_d().c_str());
+		}
+
+		if (type.substr(0, 8) == "$_DFFSR_" || type.substr(0, 11) == "$_DLATCHSR_" || type.substr(0, 5) == "$_SR_") {
+			int pos = type.find('_', 2) + 1 + (type.substr(0, 5) == "$_SR_" ? 0 : 1);
+			code += stringf("\t\tif (%s)\n\t\t\t%s = cxxsim::constant<1>(1);\n", level(cell->getPort("\\S"), type[pos] == 'P',
+					nullptr).c_str(), q_next.c_str());
+			code += stringf("\t\tif (%s)\n\t\t\t%s = cxxsim::constant<1>(0);\n", level(cell->getPort("\\R"), type[pos+1] == 'P',
+					nullptr).c_str(), q_next.c_str());
+		}
+
+		ff_code.push_back(code);
+	}
+
+	void add_mem(RTLIL::Cell *cell, const std::vector<int> &rd_vars)
+	{
+		int abits = cell->getParam("\\ABITS").as_int();
+		int width = cell->getParam("\\WIDTH").as_int();
+		int size = cell->getParam("\\SIZE").as_int();
+		int offset = cell->getParam("\\OFFSET").as_int();
+
+		mems.push_back(mem_t{new_name("m_", cell->getParam("\\MEMID").decode_string()), width, size});
+		std::string mem = mems.back().name;
+
+		auto addr = [&](RTLIL::SigSpec sig, pool<int> *inputs) {
+			return stringf("uint64_t addr = %s.amount() - uint64_t(%d);", expr(sig, inputs).c_str(), offset);
+		};
+
+		RTLIL::Const rd_clk_enable = cell->getParam("\\RD_CLK_ENABLE");
+		RTLIL::Const rd_clk_polarity = cell->getParam("\\RD_CLK_POLARITY");
+		RTLIL::Const rd_transparent = cell->getParam("\\RD_TRANSPARENT");
+
+		for (int i = 0; i < cell->getParam("\\RD_PORTS").as_int(); i++)
+		{
+			RTLIL::SigSpec sig_addr = cell->getPort("\\RD_ADDR").extract(i*abits, abits);
+			int var = rd_vars.at(i);
+
+			if (rd_clk_enable[i] != RTLIL::S1) {
+				pool<int> inputs;
+				std::string code = stringf("\t\t{\n\t\t\t%s\n\t\t\t%s = addr < %d ? %s[addr] : %s();\n\t\t}\n",
+						addr(sig_addr, &inputs).c_str(), vars[var].name.c_str(), size, mem.c_str(), value_type(width).c_str());
+				add_node(cell, code, inputs, {var});
+				continue;
+			}
+
+			std::string cond = edge(cell->getPort("\\RD_CLK")[i], rd_clk_polarity[i] == RTLIL::S1);
+			cond += " && " + level(cell->getPort("\\RD_EN")[i], true, nullptr);
+			std::string code = stringf("\t\tif (%s) {\n\t\t\t%s\n\t\t\tif (addr < %d)\n\t\t\t\t%s = %s[addr];\n\t\t}\n",
+					cond.c_str(), addr(sig_addr, nullptr).c_str(), size, next(var).c_str(), mem.c_str());
+			if (rd_transparent[i] == RTLIL::S1)
+				trans_rd_code += code;
+			else
+				rd_code += code;
+		}
+
+		RTLIL::Const wr_clk_enable = cell->getParam("\\WR_CLK_ENABLE");
+		RTLIL::Const wr_clk_polarity = cell->getParam("\\WR_CLK_POLARITY");
+
+		for (int i = 0; i < cell->getParam("\\WR_PORTS").as_int(); i++)
+		{
+			RTLIL::SigSpec sig_en = cell->getPort("\\WR_EN").extract(i*width, width);
+			RTLIL::SigSpec sig_addr = cell->getPort("\\WR_ADDR").extract(i*abits, abits);
+			RTLIL::SigSpec sig_data = cell->getPort("\\WR_DATA").extract(i*width, width);
+
+			std::string cond = "true";
+			if (wr_clk_enable[i] == RTLIL::S1)
+				cond = edge(cell->getPort("\\WR_CLK")[i], wr_clk_polarity[i] == RTLIL::S1);
+
+			wr_code += stringf("\t\tif (%s) {\n\t\t\t%s\n\t\t\tif (addr < %d) {\n", cond.c_str(), addr(sig_addr, nullptr).c_str(), size);
+			wr_code += stringf("\t\t\t\t%s en = %s;\n", value_type(width).c_str(), expr(sig_en, nullptr).c_str());
+			wr_code += stringf("\t\t\t\t%s word = (%s[addr] & ~en) | (%s & en);\n", value_type(width).c_str(), mem.c_str(),
+					expr(sig_data, nullptr).c_str());
+			wr_code += stringf("\t\t\t\tif (word != %s[addr]) {\n\t\t\t\t\t%s[addr] = word;\n\t\t\t\t\tchanged = true;\n\t\t\t\t}\n",
+					mem.c_str(), mem.c_str());
+			wr_code += "\t\t\t}\n\t\t}\n";
+		}
+
+		RTLIL::Const init = cell->getParam("\\INIT");
+		for (int i = 0; i < size && i*width < GetSize(init); i++) {
+			std::vector<RTLIL::State> word(init.bits.begin() + i*width, init.bits.begin() + std::min((i+1)*width, GetSize(init)));
+			word.resize(width, RTLIL::S0);
+			if (RTLIL::Const(word).as_bool())
+				init_code += stringf("\t\t%s[%d] = %s;\n", mem.c_str(), i, const_expr(word).c_str());
+		}
+	}
+
+	// the code for a combinational cell, the outputs are already known
+	std::string comb_code(RTLIL::Cell *cell, pool<int> &inputs, dict<RTLIL::IdString, std::string> &out)
+	{
+		std::string type = cell->type.str();
+
+		auto port = [&](const char *name) { return expr(cell->getPort(name), &inputs); };
+		auto param = [&](const char *name) { return cell->getParam(name).as_int(); };
+		auto param_bool = [&](const char *name) { return cell->hasParam(name) && cell->getParam(name).as_bool(); };
+		auto port_ext = [&](const char *name, int width) {
+			return expr(cell->getPort(name), width, param_bool(name[1] == 'A' ? "\\A_SIGNED" : "\\B_SIGNED"), &inputs);
+		};
+		auto assign = [&](const char *name, std::string value) {
+			return stringf("\t\t%s = %s;\n", out.at(name).c_str(), value.c_str());
+		};
+		auto assign_bool = [&](std::string value) {
+			return assign("\\Y", stringf("cxxsim::constant<%d>(%s)", GetSize(cell->getPort("\\Y")), value.c_str()));
+		};
+
+		if (type.substr(0, 2) == "$_")
+		{
+			if (type == "$_BUF_")
+				return assign("\\Y", port("\\A"));
+			if (type == "$_NOT_")
+				return assign("\\Y", "~" + port("\\A"));
+
+			std::string a = cell->hasPort("\\A") ? port("\\A") : "";
+			std::string b = cell->hasPort("\\B") ? port("\\B") : "";
+			std::string c = cell->hasPort("\\C") ? port("\\C") : "";
+			std::string d = cell->hasPort("\\D") ? port("\\D") : "";
+
+			if (type == "$_AND_")
+				return assign("\\Y", stringf("%s & %s", a.c_str(), b.c_str()));
+			if (type == "$_NAND_")
+				return assign("\\Y", stringf("~(%s & %s)", a.c_str(), b.c_str()));
+			if (type == "$_OR_")
+				return assign("\\Y", stringf("%s | %s", a.c_str(), b.c_str()));
+			if (type == "$_NOR_")
+				return assign("\\Y", stringf("~(%s | %s)", a.c_str(), b.c_str()));
+			if (type == "$_XOR_")
+				return assign("\\Y", stringf("%s ^ %s", a.c_str(), b.c_str()));
+			if (type == "$_XNOR_")
+				return assign("\\Y", stringf("~(%s ^ %s)", a.c_str(), b.c_str()));
+			if (type == "$_AOI3_")
+				return assign("\\Y", stringf("~((%s & %s) | %s)", a.c_str(), b.c_str(), c.c_str()));
+			if (type == "$_OAI3_")
+				return assign("\\Y", stringf("~((%s | %s) & %s)", a.c_str(), b.c_str(), c.c_str()));
+			if (type == "$_AOI4_")
+				return assign("\\Y", stringf("~((%s & %s) | (%s & %s))", a.c_str(), b.c_str(), c.c_str(), d.c_str()));
+			if (type == "$_OAI4_")
+				return assign("\\Y", stringf("~((%s | %s) & (%s | %s))", a.c_str(), b.c_str(), c.c_str(), d.c_str()));
+			if (type == "$_MUX_")
+				return assign("\\Y", stringf("%s.any() ? %s : %s", port("\\S").c_str(), b.c_str(), a.c_str()));
+
+			if (type == "$_MUX4_" || type == "$_MUX8_" || type == "$_MUX16_") {
+				int sel_bits = type == "$_MUX4_" ? 2 : type == "$_MUX8_" ? 3 : 4;
+				std::string code = "\t\t{\n\t\t\tconst cxxsim::value<1> in[] = {";
+				for (int i = 0; i < (1 << sel_bits); i++)
+					code += stringf("%s%s", i ? ", " : "", port(stringf("\\%c", 'A' + i).c_str()).c_str());
+				code += "};\n\t\t\tint sel = 0;\n";
+				for (int i = 0; i < sel_bits; i++)
+					code += stringf("\t\t\tsel |= %s.any() << %d;\n", port(stringf("\\%c", "STUV"[i]).c_str()).c_str(), i);
+				return code + stringf("\t\t\t%s = in[sel];\n\t\t}\n", out.at("\\Y").c_str());
+			}
+		}
+
+		if (type == "$assert" || type == "$assume" || type == "$live" || type == "$fair" || type == "$cover")
+			return "";
+
+		if (type == "$equiv" || type == "$pos")
+			return assign("\\Y", port_ext("\\A", param("\\Y_WIDTH")));
+		if (type == "$not")
+			return assign("\\Y", "~" + port_ext("\\A", param("\\Y_WIDTH")));
+		if (type == "$neg")
+			return assign("\\Y", port_ext("\\A", param("\\Y_WIDTH")) + ".neg()");
+
+		if (type == "$and" || type == "$or" || type == "$xor" || type == "$xnor" || type == "$add" || type == "$sub" || type == "$mul")
+		{
+			int width = param("\\Y_WIDTH");
+			std::string op = type == "$and" ? "&" : type == "$or" ? "|" : type == "$add" ? "+" : type == "$sub" ? "-" : type == "$mul" ? "*" : "^";
+			std::string value = stringf("%s %s %s", port_ext("\\A", width).c_str(), op.c_str(), port_ext("\\B", width).c_str());
+			return assign("\\Y", type == "$xnor" ? "~(" + value + ")" : value);
+		}
+
+		if (type == "$reduce_and")
+			return assign_bool(port("\\A") + ".all()");
+		if (type == "$reduce_or" || type == "$reduce_bool")
+			return assign_bool(port("\\A") + ".any()");
+		if (type == "$reduce_xor")
+			return assign_bool(port("\\A") + ".parity()");
+		if (type == "$reduce_xnor")
+			return assign_bool("!" + port("\\A") + ".parity()");
+		if (type == "$logic_not")
+			return assign_bool("!" + port("\\A") + ".any()");
+		if (type == "$logic_and")
+			return assign_bool(port("\\A") + ".any() && " + port("\\B") + ".any()");
+		if (type == "$logic_or")
+			return assign_bool(port("\\A") + ".any() || " + port("\\B") + ".any()");
+
+		if (type == "$shl" || type == "$sshl")
+			return assign("\\Y", stringf("%s.shl(%s.amount())", port_ext("\\A", param("\\Y_WIDTH")).c_str(), port("\\B").c_str()));
+
+		if (type == "$shr" || type == "$sshr") {
+			int width = std::max(param("\\A_WIDTH"), param("\\Y_WIDTH"));
+			bool is_signed = type == "$sshr" && param_bool("\\A_SIGNED");
+			std::string value = stringf("%s.%s(%s.amount())", port_ext("\\A", width).c_str(), is_signed ? "sshr" : "shr", port("\\B").c_str());
+			if (width != param("\\Y_WIDTH"))
+				value += stringf(".zext<%d>()", param("\\Y_WIDTH"));
+			return assign("\\Y", value);
+		}
+
+		if (type == "$shift" || type == "$shiftx")
+			return assign("\\Y", stringf("cxxsim::shift<%d>(%s, %s, %s)", param("\\Y_WIDTH"), port("\\A").c_str(), port("\\B").c_str(),
+					param_bool("\\B_SIGNED") ? "true" : "false"));
+
+		if (type == "$lt" || type == "$le" || type == "$gt" || type == "$ge") {
+			int width = std::max(param("\\A_WIDTH"), param("\\B_WIDTH")) + 1;
+			std::string a = port_ext("\\A", width), b = port_ext("\\B", width);
+			if (type == "$lt")
+				return assign_bool(stringf("%s.slt(%s)", a.c_str(), b.c_str()));
+			if (type == "$le")
+				return assign_bool(stringf("!%s.slt(%s)", b.c_str(), a.c_str()));
+			if (type == "$gt")
+				return assign_bool(stringf("%s.slt(%s)", b.c_str(), a.c_str()));
+			return assign_bool(stringf("!%s.slt(%s)", a.c_str(), b.c_str()));
+		}
+
+		if (type == "$eq" || type == "$ne" || type == "$eqx" || type == "$nex") {
+			int width = std::max(param("\\A_WIDTH"), param("\\B_WIDTH"));
+			bool is_signed = param_bool("\\A_SIGNED") && param_bool("\\B_SIGNED");
+			std::string a = expr(cell->getPort("\\A"), width, is_signed, &inputs);
+			std::string b = expr(cell->getPort("\\B"), width, is_signed, &inputs);
+			return assign_bool(stringf("%s %s %s", a.c_str(), type == "$eq" || type == "$eqx" ? "==" : "!=", b.c_str()));
+		}
+
+		if (type == "$div" || type == "$mod") {
+			int width = std::max(std::max(param("\\A_WIDTH"), param("\\B_WIDTH")), param("\\Y_WIDTH")) + 1;
+			return assign("\\Y", stringf("cxxsim::%s(%s, %s).zext<%d>()", type == "$div" ? "sdiv" : "smod",
+					port_ext("\\A", width).c_str(), port_ext("\\B", width).c_str(), param("\\Y_WIDTH")));
+		}
+
+		if (type == "$pow")
+			return assign("\\Y", stringf("cxxsim::pow<%d>(%s, %s, %s, %s)", param("\\Y_WIDTH"), port("\\A").c_str(), port("\\B").c_str(),
+					param_bool("\\A_SIGNED") ? "true" : "false", param_bool("\\B_SIGNED") ? "true" : "false"));
+
+		if (type == "$mux")
+			return assign("\\Y", stringf("%s.any() ? %s : %s", port("\\S").c_str(), port("\\B").c_str(), port("\\A").c_str()));
+
+		if (type == "$pmux") {
+			int width = param("\\WIDTH");
+			RTLIL::SigSpec sig_b = cell->getPort("\\B"), sig_s = cell->getPort("\\S");
+			std::string code = stringf("\t\t%s = %s;\n", out.at("\\Y").c_str(), port("\\A").c_str());
+			for (int i = GetSize(sig_s)-1; i >= 0; i--)
+				code += stringf("\t\tif (%s.any())\n\t\t\t%s = %s;\n", expr(sig_s[i], &inputs).c_str(), out.at("\\Y").c_str(),
+						expr(sig_b.extract(i*width, width), &inputs).c_str());
+			return code;
+		}
+
+		if (type == "$slice")
+			return assign("\\Y", stringf("%s.slice<%d>(%d)", port("\\A").c_str(), param("\\Y_WIDTH"), param("\\OFFSET")));
+		if (type == "$concat")
+			return assign("\\Y", stringf("cxxsim::concat(%s, %s)", port("\\B").c_str(), port("\\A").c_str()));
+
+		if (type == "$lut") {
+			std::vector<RTLIL::State> lut = cell->getParam("\\LUT").bits;
+			lut.resize(1 << param("\\WIDTH"), RTLIL::S0);
+			return assign_bool(stringf("%s.bit(%s.get())", const_expr(lut).c_str(), port("\\A").c_str()));
+		}
+
+		if (type == "$sop") {
+			int width = param("\\WIDTH"), depth = param("\\DEPTH");
+			std::vector<RTLIL::State> table = cell->getParam("\\TABLE").bits;
+			table.resize(2*width*depth, RTLIL::S0);
+			std::string a = port("\\A"), terms;
+			for (int i = 0; i < depth; i++) {
+				std::vector<RTLIL::State> neg(width, RTLIL::S0), pos(width, RTLIL::S0);
+				for (int j = 0; j < width; j++) {
+					neg[j] = table[2*width*i + 2*j];
+					pos[j] = table[2*width*i + 2*j + 1];
+				}
+				terms += stringf("%s(!(%s & %s).any() && (%s & %s) == %s)", i ? " || " : "", a.c_str(), const_expr(neg).c_str(),
+						a.c_str(), const_expr(pos).c_str(), const_expr(pos).c_str());
+			}
+			return assign_bool(depth ? terms : "false");
+		}
+
+		if (type == "$fa") {
+			std::string a = port("\\A"), b = port("\\B"), c = port("\\C");
+			return assign("\\Y", stringf("%s ^ %s ^ %s", a.c_str(), b.c_str(), c.c_str())) +
+					assign("\\X", stringf("(%s & %s) | (%s & %s) | (%s & %s)", a.c_str(), b.c_str(), a.c_str(), c.c_str(), b.c_str(), c.c_str()));
+		}
+
+		if (type == "$lcu") {
+			int width = param("\\WIDTH");
+			std::string code = "\t\t{\n";
+			code += stringf("\t\t\t%s p = %s, g = %s, co = %s();\n", value_type(width).c_str(), port("\\P").c_str(), port("\\G").c_str(),
+					value_type(width).c_str());
+			code += stringf("\t\t\tbool carry = %s.any();\n", port("\\CI").c_str());
+			code += stringf("\t\t\tfor (size_t i = 0; i < %d; i++) {\n", width);
+			code += "\t\t\t\tcarry = g.bit(i) || (p.bit(i) && carry);\n";
+			code += "\t\t\t\tif (carry)\n\t\t\t\t\tco.d[i / 64] |= uint64_t(1) << (i % 64);\n\t\t\t}\n";
+			return code + stringf("\t\t\t%s = co;\n\t\t}\n", out.at("\\CO").c_str());
+		}
+
+		if (type == "$alu") {
+			int width = param("\\Y_WIDTH");
+			std::string code = "\t\t{\n";
+			code += stringf("\t\t\t%s a = %s, b = %s;\n", value_type(width).c_str(), port_ext("\\A", width).c_str(), port_ext("\\B", width).c_str());
+			code += stringf("\t\t\tif (%s.any())\n\t\t\t\tb = ~b;\n", port("\\BI").c_str());
+			code += stringf("\t\t\t%s sum = a.zext<%d>() + b.zext<%d>() + cxxsim::constant<%d>(%s.any());\n", value_type(width+1).c_str(),
+					width+1, width+1, width+1, port("\\CI").c_str());
+			code += stringf("\t\t\t%s = a ^ b;\n", out.at("\\X").c_str());
+			code += stringf("\t\t\t%s = sum.zext<%d>();\n", out.at("\\Y").c_str(), width);
+			code += stringf("\t\t\t%s = (a.zext<%d>() ^ b.zext<%d>() ^ sum).slice<%d>(1);\n", out.at("\\CO").c_str(), width+1, width+1, width);
+			return code + "\t\t}\n";
+		}
+
+		log_abort();
+	}
+
+	bool is_comb_type(RTLIL::IdString type)
+	{
+		static pool<RTLIL::IdString> types;
+		if (types.empty()) {
+			CellTypes ct_comb;
+			ct_comb.setup_internals();
+			ct_comb.setup_stdcells();
+			for (auto &it : ct_comb.cell_types)
+				types.insert(it.first);
+			for (auto t : {"$macc", "$tribuf", "$_TBUF_", "$initstate", "$anyconst", "$anyseq"})
+				types.erase(t);
+		}
+		return types.count(type) != 0;
+	}
+
+	bool is_ff_type(RTLIL::IdString type)
+	{
+		std::string t = type.str();
+		if (type.in("$dff", "$dffe", "$adff", "$dffsr", "$dlatch", "$dlatchsr", "$sr"))
+			return true;
+		return t.substr(0, 6) == "$_DFF_" || t.substr(0, 7) == "$_DFFE_" || t.substr(0, 8) == "$_DFFSR_" ||
+				t.substr(0, 9) == "$_DLATCH_" || t.substr(0, 11) == "$_DLATCHSR_" || t.substr(0, 5) == "$_SR_";
+	}
+
+	void run(std::string class_name)
+	{
+		if (module->has_processes())
+			log_error("Module %s contains processes, run 'proc' first.\n", log_id(module));
+
+		for (auto wire : module->wires())
+		{
+			if (!wire->port_id)
+				continue;
+			if (wire->port_input && wire->port_output)
+				log_error("Inout port %s of module %s is not supported.\n", log_id(wire), log_id(module));
+			if (wire->port_input) {
+				int var = add_var("p_", wire);
+				input_vars.push_back(var);
+				port_vars[wire] = var;
+			}
+		}
+
+		if (!clock_port.empty()) {
+			RTLIL::Wire *wire = module->wire(RTLIL::escape_id(clock_port));
+			if (wire == nullptr || !wire->port_input || wire->width != 1)
+				log_error("Module %s has no 1-bit input port %s.\n", log_id(module), clock_port.c_str());
+		}
+
+		// the driver of every signal must be known before any expression is
+		// built, so all variables are created first
+		dict<RTLIL::Cell*, std::vector<int>> cell_vars;
+		dict<RTLIL::Cell*, dict<RTLIL::IdString, int>> comb_outputs;
+		for (auto cell : module->cells())
+		{
+			if (is_ff_type(cell->type)) {
+				int var = add_var("s_", cell->getPort("\\Q"));
+				state_vars.push_back(var);
+				cell_vars[cell].push_back(var);
+				continue;
+			}
+
+			if (cell->type == "$mem") {
+				int width = cell->getParam("\\WIDTH").as_int();
+				RTLIL::Const rd_clk_enable = cell->getParam("\\RD_CLK_ENABLE");
+				for (int i = 0; i < cell->getParam("\\RD_PORTS").as_int(); i++) {
+					bool sync = rd_clk_enable[i] == RTLIL::S1;
+					int var = add_var(sync ? "s_" : "n_", cell->getPort("\\RD_DATA").extract(i*width, width));
+					(sync ? state_vars : net_vars).push_back(var);
+					cell_vars[cell].push_back(var);
+				}
+				continue;
+			}
+
+			if (is_comb_type(cell->type)) {
+				auto &outputs = comb_outputs[cell];
+				for (auto &conn : cell->connections())
+					if (ct.cell_output(cell->type, conn.first)) {
+						int var = add_var("n_", conn.second);
+						net_vars.push_back(var);
+						outputs[conn.first] = var;
+					}
+				continue;
+			}
+
+			if (module->design->module(cell->type) != nullptr)
+				log_error("Cell %s in module %s is an instance of module %s, run 'flatten' first.\n", log_id(cell), log_id(module), log_id(cell->type));
+			if (cell->type == "$macc")
+				log_error("Cell %s (%s) in module %s is not supported, run 'maccmap -unmap' first.\n", log_id(cell), log_id(cell->type), log_id(module));
+			if (cell->type.in("$memrd", "$memwr", "$meminit"))
+				log_error("Cell %s (%s) in module %s is not supported, run 'memory_collect' first.\n", log_id(cell), log_id(cell->type), log_id(module));
+			log_error("Cell %s (%s) in module %s is not supported by the cxxsim backend.\n", log_id(cell), log_id(cell->type), log_id(module));
+		}
+
+		for (auto cell : module->cells())
+		{
+			if (is_ff_type(cell->type)) {
+				add_ff(cell, cell_vars.at(cell).front());
+				continue;
+			}
+
+			if (cell->type == "$mem") {
+				add_mem(cell, cell_vars[cell]);
+				continue;
+			}
+
+			pool<int> inputs;
+			std::vector<int> outputs;
+			dict<RTLIL::IdString, std::string> out;
+			for (auto &it : comb_outputs.at(cell)) {
+				out[it.first] = vars[it.second].name;
+				outputs.push_back(it.second);
+			}
+			add_node(cell, comb_code(cell, inputs, out), inputs, outputs);
+		}
+
+		// the values of the clock signals of the edge detectors
+		std::vector<std::string> clock_exprs(GetSize(clocks));
+		for (auto &it : clocks)
+			clock_exprs[it.second] = expr(it.first, nullptr);
+
+		for (auto wire : module->wires())
+			if (wire->port_output) {
+				int idx = GetSize(vars);
+				vars.push_back(var_t{new_name("p_", wire->name), wire->width});
+				output_vars.push_back(idx);
+				port_vars[wire] = idx;
+			}
+
+		// levelize: the order of the nodes in comb() is a topological order
+		// of the net dependencies
+		dict<int, std::vector<int>> users;
+		std::vector<int> in_degree(GetSize(nodes));
+		for (int i = 0; i < GetSize(nodes); i++)
+			for (int var : nodes[i].inputs)
+				if (net_nodes.count(var)) {
+					users[net_nodes.at(var)].push_back(i);
+					in_degree[i]++;
+				}
+
+		std::vector<int> order;
+		for (int i = 0; i < GetSize(nodes); i++)
+			if (in_degree[i] == 0)
+				order.push_back(i);
+		for (int i = 0; i < GetSize(order); i++)
+			for (int user : users[order[i]])
+				if (--in_degree[user] == 0)
+					order.push_back(user);
+
+		if (GetSize(order) != GetSize(nodes)) {
+			for (int i = 0; i < GetSize(nodes); i++)
+				if (in_degree[i] != 0)
+					log("  cell in logic loop: %s (%s)\n", log_id(nodes[i].cell), log_id(nodes[i].cell->type));
+			log_error("Module %s contains a combinational logic loop.\n", log_id(module));
+		}
+
+		// initial values of state variables
+		dict<int, std::vector<RTLIL::State>> init_values;
+		for (auto wire : module->wires()) {
+			if (!wire->attributes.count("\\init"))
+				continue;
+			RTLIL::Const init = wire->attributes.at("\\init");
+			for (int i = 0; i < GetSize(wire) && i < GetSize(init); i++) {
+				RTLIL::SigBit bit = sigmap(RTLIL::SigBit(wire, i));
+				if (!bit_vars.count(bit) || init[i] != RTLIL::S1)
+					continue;
+				auto &var = bit_vars.at(bit);
+				auto &value = init_values[var.first];
+				value.resize(vars[var.first].width, RTLIL::S0);
+				value[var.second] = RTLIL::S1;
+			}
+		}
+
+		log("Writing class %s: %d nets, %d state variables, %d memories, %d clock signals.\n", class_name.c_str(),
+				GetSize(net_vars), GetSize(state_vars), GetSize(mems), GetSize(clocks));
+
+		f << stringf("// simulator for module %s, generated by write_cxxsim\n", log_id(module));
+		f << stringf("struct %s\n{\n", class_name.c_str());
+
+		f << stringf("\t// ports\n");
+		for (int var : input_vars)
+			f << stringf("\t%s %s = {};\n", value_type(vars[var].width).c_str(), vars[var].name.c_str());
+		for (int var : output_vars)
+			f << stringf("\t%s %s = {};\n", value_type(vars[var].width).c_str(), vars[var].name.c_str());
+
+		// the next state is computed before any state variable is updated
+		f << stringf("\n\t// state\n");
+		for (int var : state_vars)
+			if (vars[var].array.empty())
+				f << stringf("\t%s %s = {}, %s = {};\n", value_type(vars[var].width).c_str(), vars[var].name.c_str(), next(var).c_str());
+		for (auto &it : array_sizes)
+			if (it.first.substr(0, 6) == "state_")
+				f << stringf("\t%s %s[%d] = {}, %s_next[%d] = {};\n", value_type(atoi(it.first.c_str() + 6)).c_str(),
+						it.first.c_str(), it.second, it.first.c_str(), it.second);
+		for (auto &mem : mems)
+			f << stringf("\t%s %s[%d] = {};\n", value_type(mem.width).c_str(), mem.name.c_str(), mem.size);
+		for (int i = 0; i < GetSize(clocks); i++)
+			f << stringf("\tcxxsim::value<1> clock_%d = {};\n\tbool posedge_%d = false, negedge_%d = false;\n", i, i, i);
+
+		f << stringf("\n\t// internal nets\n");
+		for (int var : net_vars)
+			if (vars[var].array.empty())
+				f << stringf("\t%s %s = {};\n", value_type(vars[var].width).c_str(), vars[var].name.c_str());
+		for (auto &it : array_sizes)
+			if (it.first.substr(0, 5) == "nets_")
+				f << stringf("\t%s %s[%d] = {};\n", value_type(atoi(it.first.c_str() + 5)).c_str(), it.first.c_str(), it.second);
+
+		f << stringf("\n\t%s()\n\t{\n", class_name.c_str());
+		for (int var : state_vars)
+			if (init_values.count(var))
+				f << stringf("\t\t%s = %s;\n", vars[var].name.c_str(), const_expr(init_values.at(var)).c_str());
+		f << init_code;
+		f << stringf("\t}\n");
+
+		// compilers do not cope well with huge functions, so large netlists
+		// are evaluated by a sequence of smaller functions
+		int chunks = 0;
+		for (int i = 0; i < GetSize(order); i += chunk_size, chunks++) {
+			f << stringf("\n\tvoid comb_%d()\n\t{\n", chunks);
+			for (int j = i; j < GetSize(order) && j < i + chunk_size; j++)
+				f << nodes[order[j]].code;
+			f << stringf("\t}\n");
+		}
+
+		pool<int> comb_inputs;
+		for (auto &node : nodes)
+			comb_inputs.insert(node.inputs.begin(), node.inputs.end());
+
+		f << stringf("\n\tvoid comb()\n\t{\n");
+		for (int i = 0; i < chunks; i++)
+			f << stringf("\t\tcomb_%d();\n", i);
+		for (auto wire : module->wires())
+			if (wire->port_output)
+				f << stringf("\t\t%s = %s;\n", vars[port_vars.at(wire)].name.c_str(), expr(wire, &comb_inputs).c_str());
+		f << stringf("\t}\n");
+
+		int ff_chunks = 0;
+		for (int i = 0; i < GetSize(ff_code); i += chunk_size, ff_chunks++) {
+			f << stringf("\n\tvoid update_%d()\n\t{\n", ff_chunks);
+			for (int j = i; j < GetSize(ff_code) && j < i + chunk_size; j++)
+				f << ff_code[j];
+			f << stringf("\t}\n");
+		}
+
+		f << stringf("\n\tbool update()\n\t{\n\t\tbool changed = false;\n");
+		for (int i = 0; i < GetSize(clocks); i++) {
+			f << stringf("\t\tcxxsim::value<1> clock_%d_now = %s;\n", i, clock_exprs[i].c_str());
+			f << stringf("\t\tposedge_%d = !clock_%d.any() && clock_%d_now.any();\n", i, i, i);
+			f << stringf("\t\tnegedge_%d = clock_%d.any() && !clock_%d_now.any();\n", i, i, i);
+			f << stringf("\t\tclock_%d = clock_%d_now;\n", i, i);
+		}
+		for (int var : state_vars)
+			if (vars[var].array.empty())
+				f << stringf("\t\t%s = %s;\n", next(var).c_str(), vars[var].name.c_str());
+		for (auto &it : array_sizes)
+			if (it.first.substr(0, 6) == "state_")
+				f << stringf("\t\tfor (int i = 0; i < %d; i++)\n\t\t\t%s_next[i] = %s[i];\n", it.second, it.first.c_str(), it.first.c_str());
+		for (int i = 0; i < ff_chunks; i++)
+			f << stringf("\t\tupdate_%d();\n", i);
+		f << rd_code << wr_code << trans_rd_code;
+		for (int var : state_vars)
+			if (vars[var].array.empty())
+				f << stringf("\t\tif (%s != %s) {\n\t\t\t%s = %s;\n\t\t\tchanged = true;\n\t\t}\n", next(var).c_str(),
+						vars[var].name.c_str(), vars[var].name.c_str(), next(var).c_str());
+		for (auto &it : array_sizes)
+			if (it.first.substr(0, 6) == "state_")
+				f << stringf("\t\tfor (int i = 0; i < %d; i++)\n\t\t\tif (%s_next[i] != %s[i]) {\n\t\t\t\t%s[i] = %s_next[i];\n"
+						"\t\t\t\tchanged = true;\n\t\t\t}\n", it.second, it.first.c_str(), it.first.c_str(), it.first.c_str(), it.first.c_str());
+		f << stringf("\t\treturn changed;\n\t}\n");
+
+		f << stringf("\n\tbool settle()\n\t{\n");
+		f << stringf("\t\tfor (int i = 0; update(); i++) {\n\t\t\tif (i == 1000)\n\t\t\t\treturn false;\n\t\t\tcomb();\n\t\t}\n");
+		f << stringf("\t\treturn true;\n\t}\n");
+
+		f << stringf("\n\tbool eval()\n\t{\n\t\tcomb();\n\t\treturn settle();\n\t}\n");
+
+		// if no combinational logic depends on the clock, the comb() pass after
+		// the rising edge would not change anything
+		if (!clock_port.empty()) {
+			int clk_var = port_vars.at(module->wire(RTLIL::escape_id(clock_port)));
+			std::string clk = vars[clk_var].name;
+			f << stringf("\n\tbool step()\n\t{\n\t\t%s.set(0);\n\t\tbool ok = eval();\n", clk.c_str());
+			f << stringf("\t\t%s.set(1);\n\t\treturn %s && ok;\n\t}\n", clk.c_str(), comb_inputs.count(clk_var) ? "eval()" : "settle()");
+		}
+
+		f << stringf("};\n");
+	}
+};
+
+struct CxxsimBackend : public Backend {
+	CxxsimBackend() : Backend("cxxsim", "write design to C++ cycle-based simulator") { }
+	virtual void help()
+	{
+		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
+		log("\n");
+		log("    write_cxxsim [options] [filename]\n");
+		log("\n");
+		log("Write a compiled simulator for each selected module as a C++ class. The\n");
+		log("combinational cells are sorted topologically and evaluated in a fixed order,\n");
+		log("signals are two-state and packed into 64 bit words. The generated code\n");
+		log("includes backends/cxxsim/cxxsim.h, so it must be compiled with the include\n");
+		log("directory of Yosys in the search path, e.g.:\n");
+		log("\n");
+		log("    c++ -O2 -I$(yosys-config --datdir)/include testbench.cc\n");
+		log("\n");
+		log("The modules must be flat, without processes and without $memrd/$memwr cells\n");
+		log("(e.g. run 'proc; flatten; memory -nomap' or a full synthesis script first).\n");
+		log("$macc cells must be converted with 'maccmap -unmap'. The class for a module\n");
+		log("has the following members:\n");
+		log("\n");
+		log("    p_<port>\n");
+		log("        a cxxsim::value<width> for each input and output port. the values can\n");
+		log("        be accessed with get(), set(), get_word() and set_word().\n");
+		log("\n");
+		log("    n_<wire>, s_<wire>\n");
+		log("        the values of internal nets and registers with public names.\n");
+		log("\n");
+		log("    bool eval()\n");
+		log("        update the outputs and the state after the inputs have been changed.\n");
+		log("        clock edges are detected by comparing with the value of the clock\n");
+		log("        signal in the previous call. returns false if the design did not\n");
+		log("        settle, e.g. because of a loop through latches.\n");
+		log("\n");
+		log("    bool step()\n");
+		log("        only with -clock: set the clock to 0 and call eval(), then set it to\n");
+		log("        1 and call eval() again, i.e. one cycle with a rising edge.\n");
+		log("\n");
+		log("The state is initialized from the 'init' attributes and the initial contents\n");
+		log("of memories, all other state bits are 0 initially. Undefined bits (x and z)\n");
+		log("are simulated as 0.\n");
+		log("\n");
+		log("    -clock <port>\n");
+		log("        generate the step() function for the given clock input.\n");
+		log("\n");
+	}
+	virtual void execute(std::ostream *&f, std::string filename, std::vector<std::string> args, RTLIL::Design *design)
+	{
+		std::string clock_port;
+
+		log_header(design, "Executing CXXSIM backend.\n");
+
+		size_t argidx;
+		for (argidx = 1; argidx < args.size(); argidx++)
+		{
+			if (args[argidx] == "-clock" && argidx+1 < args.size()) {
+				clock_port = args[++argidx];
+				continue;
+			}
+			break;
+		}
+		extra_args(f, filename, args, argidx);
+
+		*f << stringf("// Generated by %s\n", yosys_version_str);
+		*f << stringf("#include <backends/cxxsim/cxxsim.h>\n");
+
+		pool<std::string> class_names;
+		for (auto module : design->selected_modules())
+		{
+			if (module->get_bool_attribute("\\blackbox"))
+				continue;
+
+			std::string class_name;
+			for (auto c : module->name.str().substr(1))
+				class_name += (isalnum(c) ? c : '_');
+			if (class_name.empty() || isdigit(class_name[0]) || class_names.count(class_name))
+				class_name = "m_" + class_name;
+			class_names.insert(class_name);
+
+			log("Writing module %s.\n", log_id(module));
+			*f << stringf("\n");
+			CxxsimWorker worker(module, *f, clock_port);
+			worker.run(class_name);
+		}
+	}
+} CxxsimBackend;
+
+PRIVATE_NAMESPACE_END
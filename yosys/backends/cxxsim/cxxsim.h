@@ -0,0 +1,448 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Clifford Wolf <clifford@clifford.at>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *  ---
+ *
+ *  Runtime for the C++ code generated by 'write_cxxsim'. This file does not
+ *  depend on Yosys, it is installed to share/include/backends/cxxsim/ so that
+ *  generated simulators can be compiled with:
+ *
+ *    c++ -O2 -I$(yosys-config --datdir)/include ...
+ *
+ *  A value<W> is a two-state W bit vector, stored in 64 bit words with the
+ *  least significant word first. Bits above W are always zero. All operations
+ *  are modulo 2^W unless noted otherwise.
+ *
+ */
+
+#ifndef CXXSIM_H
+#define CXXSIM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace cxxsim
+{
+	template<size_t W>
+	struct value
+	{
+		static const size_t bits = W;
+		static const size_t words = W == 0 ? 1 : (W + 63) / 64;
+		static const uint64_t top_mask = W % 64 == 0 ? (W == 0 ? 0 : ~uint64_t(0)) : (uint64_t(1) << (W % 64)) - 1;
+
+		uint64_t d[words];
+
+		// accessors for testbenches
+
+		uint64_t get() const {
+			return d[0];
+		}
+
+		uint64_t get_word(size_t i) const {
+			return d[i];
+		}
+
+		void set(uint64_t v) {
+			d[0] = v;
+			for (size_t i = 1; i < words; i++)
+				d[i] = 0;
+			d[words-1] &= top_mask;
+		}
+
+		void set_word(size_t i, uint64_t v) {
+			d[i] = i == words-1 ? v & top_mask : v;
+		}
+
+		bool bit(size_t i) const {
+			return i < W && ((d[i / 64] >> (i % 64)) & 1) != 0;
+		}
+
+		std::string str() const {
+			std::string s;
+			for (size_t i = W; i > 0; i--)
+				s += bit(i-1) ? '1' : '0';
+			return s;
+		}
+
+		// bitwise operations
+
+		value operator~() const {
+			value r;
+			if (words == 1) {
+				r.d[0] = ~d[0] & top_mask;
+				return r;
+			}
+			for (size_t i = 0; i < words; i++)
+				r.d[i] = ~d[i];
+			r.d[words-1] &= top_mask;
+			return r;
+		}
+
+		value operator&(const value &other) const {
+			value r;
+			if (words == 1) {
+				r.d[0] = d[0] & other.d[0];
+				return r;
+			}
+			for (size_t i = 0; i < words; i++)
+				r.d[i] = d[i] & other.d[i];
+			return r;
+		}
+
+		value operator|(const value &other) const {
+			value r;
+			if (words == 1) {
+				r.d[0] = d[0] | other.d[0];
+				return r;
+			}
+			for (size_t i = 0; i < words; i++)
+				r.d[i] = d[i] | other.d[i];
+			return r;
+		}
+
+		value operator^(const value &other) const {
+			value r;
+			if (words == 1) {
+				r.d[0] = d[0] ^ other.d[0];
+				return r;
+			}
+			for (size_t i = 0; i < words; i++)
+				r.d[i] = d[i] ^ other.d[i];
+			return r;
+		}
+
+		bool operator==(const value &other) const {
+			for (size_t i = 0; i < words; i++)
+				if (d[i] != other.d[i])
+					return false;
+			return true;
+		}
+
+		bool operator!=(const value &other) const {
+			return !(*this == other);
+		}
+
+		// reductions
+
+		bool any() const {
+			if (words == 1)
+				return d[0] != 0;
+			for (size_t i = 0; i < words; i++)
+				if (d[i] != 0)
+					return true;
+			return false;
+		}
+
+		bool all() const {
+			for (size_t i = 0; i+1 < words; i++)
+				if (d[i] != ~uint64_t(0))
+					return false;
+			return d[words-1] == top_mask;
+		}
+
+		bool parity() const {
+			uint64_t x = 0;
+			for (size_t i = 0; i < words; i++)
+				x ^= d[i];
+			x ^= x >> 32;
+			x ^= x >> 16;
+			x ^= x >> 8;
+			x ^= x >> 4;
+			x ^= x >> 2;
+			x ^= x >> 1;
+			return (x & 1) != 0;
+		}
+
+		bool sign() const {
+			return W > 0 && bit(W-1);
+		}
+
+		// width conversion (truncates if R < W)
+
+		template<size_t R>
+		value<R> zext() const {
+			value<R> r;
+			for (size_t i = 0; i < value<R>::words; i++)
+				r.d[i] = i < words ? d[i] : 0;
+			r.d[value<R>::words-1] &= value<R>::top_mask;
+			return r;
+		}
+
+		template<size_t R>
+		value<R> sext() const {
+			value<R> r;
+			if (!sign())
+				return zext<R>();
+			value<W> inv = ~*this;
+			for (size_t i = 0; i < value<R>::words; i++)
+				r.d[i] = ~(i < words ? inv.d[i] : 0);
+			r.d[value<R>::words-1] &= value<R>::top_mask;
+			return r;
+		}
+
+		template<size_t R>
+		value<R> ext(bool is_signed) const {
+			return is_signed ? sext<R>() : zext<R>();
+		}
+
+		// R bits starting at the given offset. bits above W are zero.
+		template<size_t R>
+		value<R> slice(size_t offset) const {
+			value<R> r;
+			size_t wshift = offset / 64, bshift = offset % 64;
+			for (size_t i = 0; i < value<R>::words; i++) {
+				uint64_t w = i + wshift < words ? d[i + wshift] >> bshift : 0;
+				if (bshift != 0 && i + wshift + 1 < words)
+					w |= d[i + wshift + 1] << (64 - bshift);
+				r.d[i] = w;
+			}
+			r.d[value<R>::words-1] &= value<R>::top_mask;
+			return r;
+		}
+
+		// shifts by a number of bits
+
+		value shl(uint64_t n) const {
+			value r;
+			for (size_t i = 0; i < words; i++)
+				r.d[i] = 0;
+			if (n >= W)
+				return r;
+			size_t wshift = n / 64, bshift = n % 64;
+			for (size_t i = words; i-- > wshift; ) {
+				uint64_t w = d[i - wshift] << bshift;
+				if (bshift != 0 && i - wshift > 0)
+					w |= d[i - wshift - 1] >> (64 - bshift);
+				r.d[i] = w;
+			}
+			r.d[words-1] &= top_mask;
+			return r;
+		}
+
+		value shr(uint64_t n) const {
+			value r;
+			for (size_t i = 0; i < words; i++)
+				r.d[i] = 0;
+			if (n >= W)
+				return r;
+			size_t wshift = n / 64, bshift = n % 64;
+			for (size_t i = 0; i + wshift < words; i++) {
+				uint64_t w = d[i + wshift] >> bshift;
+				if (bshift != 0 && i + wshift + 1 < words)
+					w |= d[i + wshift + 1] << (64 - bshift);
+				r.d[i] = w;
+			}
+			return r;
+		}
+
+		value sshr(uint64_t n) const {
+			if (!sign())
+				return shr(n);
+			return ~((~*this).shr(n));
+		}
+
+		// the value as a shift amount. amounts that do not fit into 63 bits
+		// saturate, they shift out all bits anyway.
+		uint64_t amount() const {
+			for (size_t i = 1; i < words; i++)
+				if (d[i] != 0)
+					return uint64_t(1) << 63;
+			return d[0] >> 63 ? uint64_t(1) << 63 : d[0];
+		}
+
+		// arithmetic
+
+		value operator+(const value &other) const {
+			value r;
+			uint64_t carry = 0;
+			for (size_t i = 0; i < words; i++) {
+				uint64_t s = d[i] + other.d[i];
+				uint64_t c = s < d[i];
+				r.d[i] = s + carry;
+				carry = c | (r.d[i] < s);
+			}
+			r.d[words-1] &= top_mask;
+			return r;
+		}
+
+		value operator-(const value &other) const {
+			value r;
+			uint64_t borrow = 0;
+			for (size_t i = 0; i < words; i++) {
+				uint64_t s = d[i] - other.d[i];
+				uint64_t b = s > d[i];
+				r.d[i] = s - borrow;
+				borrow = b | (r.d[i] > s);
+			}
+			r.d[words-1] &= top_mask;
+			return r;
+		}
+
+		value neg() const {
+			return value() - *this;
+		}
+
+		value operator*(const value &other) const {
+			value r;
+			if (words == 1) {
+				r.d[0] = (d[0] * other.d[0]) & top_mask;
+				return r;
+			}
+			for (size_t i = 0; i < words; i++)
+				r.d[i] = 0;
+			for (size_t i = 0; i < words; i++) {
+				uint64_t carry = 0;
+				for (size_t j = 0; i + j < words; j++) {
+					uint64_t lo, hi;
+					mul64(d[i], other.d[j], lo, hi);
+					uint64_t s = r.d[i+j] + lo;
+					hi += s < lo;
+					r.d[i+j] = s + carry;
+					hi += r.d[i+j] < s;
+					carry = hi;
+				}
+			}
+			r.d[words-1] &= top_mask;
+			return r;
+		}
+
+		static void mul64(uint64_t a, uint64_t b, uint64_t &lo, uint64_t &hi) {
+#ifdef __SIZEOF_INT128__
+			unsigned __int128 p = (unsigned __int128)a * b;
+			lo = uint64_t(p);
+			hi = uint64_t(p >> 64);
+#else
+			uint64_t a0 = a & 0xffffffff, a1 = a >> 32, b0 = b & 0xffffffff, b1 = b >> 32;
+			uint64_t p00 = a0 * b0, p01 = a0 * b1, p10 = a1 * b0, p11 = a1 * b1;
+			uint64_t mid = (p00 >> 32) + (p01 & 0xffffffff) + (p10 & 0xffffffff);
+			lo = (p00 & 0xffffffff) | (mid << 32);
+			hi = p11 + (p01 >> 32) + (p10 >> 32) + (mid >> 32);
+#endif
+		}
+
+		// unsigned division, x / 0 and x % 0 are 0
+		void udivmod(const value &other, value &quotient, value &remainder) const {
+			quotient = value();
+			remainder = value();
+			if (!other.any())
+				return;
+			if (words == 1) {
+				quotient.d[0] = d[0] / other.d[0];
+				remainder.d[0] = d[0] % other.d[0];
+				return;
+			}
+			for (size_t i = W; i-- > 0; ) {
+				// the remainder can be larger than 2^(W-1) before the shift
+				bool overflow = remainder.sign();
+				remainder = remainder.shl(1);
+				remainder.d[0] |= bit(i);
+				if (overflow || !remainder.ult(other)) {
+					remainder = remainder - other;
+					quotient.d[i / 64] |= uint64_t(1) << (i % 64);
+				}
+			}
+		}
+
+		bool ult(const value &other) const {
+			for (size_t i = words; i-- > 0; )
+				if (d[i] != other.d[i])
+					return d[i] < other.d[i];
+			return false;
+		}
+
+		bool slt(const value &other) const {
+			if (sign() != other.sign())
+				return sign();
+			return ult(other);
+		}
+	};
+
+	template<size_t W>
+	value<W> constant(uint64_t v) {
+		value<W> r = value<W>();
+		r.set(v);
+		return r;
+	}
+
+	template<size_t A, size_t B>
+	value<A+B> concat(const value<A> &hi, const value<B> &lo) {
+		value<A+B> r = lo.template zext<A+B>();
+		size_t wshift = B / 64, bshift = B % 64;
+		for (size_t i = 0; i < value<A>::words && i + wshift < value<A+B>::words; i++) {
+			r.d[i + wshift] |= hi.d[i] << bshift;
+			if (bshift != 0 && i + wshift + 1 < value<A+B>::words)
+				r.d[i + wshift + 1] |= hi.d[i] >> (64 - bshift);
+		}
+		return r;
+	}
+
+	template<size_t N>
+	value<N> repeat(const value<1> &bit) {
+		return bit.any() ? ~value<N>() : value<N>();
+	}
+
+	// signed division and modulo of W bit values, rounding towards zero (the
+	// operands must not be the most negative value)
+	template<size_t W>
+	value<W> sdiv(const value<W> &a, const value<W> &b) {
+		value<W> q, r;
+		(a.sign() ? a.neg() : a).udivmod(b.sign() ? b.neg() : b, q, r);
+		return a.sign() != b.sign() ? q.neg() : q;
+	}
+
+	template<size_t W>
+	value<W> smod(const value<W> &a, const value<W> &b) {
+		value<W> q, r;
+		(a.sign() ? a.neg() : a).udivmod(b.sign() ? b.neg() : b, q, r);
+		return a.sign() ? r.neg() : r;
+	}
+
+	// $shift and $shiftx: shift right by a signed or unsigned amount, bits
+	// shifted in from outside of a are zero
+	template<size_t Y, size_t A, size_t B>
+	value<Y> shift(const value<A> &a, const value<B> &b, bool b_signed) {
+		if (b_signed && b.sign()) {
+			uint64_t n = b.neg().amount();
+			if (B > 0 && !b.neg().sign())
+				return a.template zext<Y>().shl(n);
+			return value<Y>();
+		}
+		return a.template zext<(A > Y ? A : Y)>().shr(b.amount()).template zext<Y>();
+	}
+
+	// $pow, with the semantics of RTLIL::const_pow()
+	template<size_t Y, size_t A, size_t B>
+	value<Y> pow(const value<A> &a, const value<B> &b, bool a_signed, bool b_signed) {
+		if (b_signed && b.sign()) {
+			if (a == constant<A>(1))
+				return constant<Y>(1);
+			if (a_signed && a.all())
+				return b.bit(0) ? ~value<Y>() : constant<Y>(1);
+			return value<Y>();
+		}
+		value<Y> y = constant<Y>(1), x = a.template ext<Y>(a_signed);
+		for (size_t i = 0; i < B; i++) {
+			if (b.bit(i))
+				y = y * x;
+			x = x * x;
+		}
+		return y;
+	}
+}
+
+#endif
@@ -0,0 +1,328 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Clifford Wolf <clifford@clifford.at>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *  ---
+ *
+ *  A binary representation of RTLIL for fast checkpoints (see the format
+ *  description in rtlil_bin_backend.h).
+ *
+ */
+
+#include "rtlil_bin_backend.h"
+#include "kernel/yosys.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+const char RTLIL_BIN_BACKEND::magic[] = "YRTLB";
+const int RTLIL_BIN_BACKEND::version = 1;
+
+namespace {
+	// names and string constants share one table. an IdString and a string
+	// constant with the same text simply get two entries.
+	struct RtlilBinStrings
+	{
+		dict<RTLIL::IdString, int> ids;
+		dict<std::string, int> strs;
+		std::vector<std::string> list;
+
+		int lookup(RTLIL::IdString id) {
+			auto it = ids.find(id);
+			if (it != ids.end())
+				return it->second;
+			int idx = GetSize(list);
+			list.push_back(id.str());
+			ids[id] = idx;
+			return idx;
+		}
+
+		int lookup(const std::string &str) {
+			auto it = strs.find(str);
+			if (it != strs.end())
+				return it->second;
+			int idx = GetSize(list);
+			list.push_back(str);
+			strs[str] = idx;
+			return idx;
+		}
+	};
+
+	struct RtlilBinWriter
+	{
+		std::string buf;
+		RtlilBinStrings &strings;
+		dict<RTLIL::Wire*, int> wire_index;
+
+		RtlilBinWriter(RtlilBinStrings &strings) : strings(strings) { }
+
+		void write_uint(uint64_t v) {
+			while (v >= 0x80) {
+				buf += char(v | 0x80);
+				v >>= 7;
+			}
+			buf += char(v);
+		}
+
+		void write_int(int64_t v) {
+			write_uint((uint64_t(v) << 1) ^ uint64_t(v >> 63));
+		}
+
+		void write_id(RTLIL::IdString id) {
+			write_uint(strings.lookup(id));
+		}
+
+		// the low two bits of the header select the encoding: two states per
+		// byte, eight 0/1 bits per byte or a reference to the string table
+		void write_bits(const std::vector<RTLIL::State> &bits, int offset, int width, bool is_string = false)
+		{
+			bool fully_def = true;
+			for (int i = 0; i < width && fully_def; i++)
+				if (bits[offset+i] != RTLIL::S0 && bits[offset+i] != RTLIL::S1)
+					fully_def = false;
+
+			if (!fully_def) {
+				write_uint(uint64_t(width) << 2);
+				for (int i = 0; i < width; i += 2)
+					buf += char(bits[offset+i] | (i+1 < width ? bits[offset+i+1] << 4 : 0));
+				return;
+			}
+
+			std::string packed((width + 7) / 8, 0);
+			for (int i = 0; i < width; i++)
+				if (bits[offset+i] == RTLIL::S1)
+					packed[i / 8] |= 1 << (i % 8);
+
+			if (is_string && width % 8 == 0) {
+				write_uint(uint64_t(width) << 2 | 2);
+				write_uint(strings.lookup(packed));
+			} else {
+				write_uint(uint64_t(width) << 2 | 1);
+				buf += packed;
+			}
+		}
+
+		void write_const(const RTLIL::Const &value) {
+			write_uint(value.flags);
+			write_bits(value.bits, 0, GetSize(value.bits), (value.flags & RTLIL::CONST_FLAG_STRING) != 0);
+		}
+
+		// a chunk is a constant (0), a whole wire (2*index+1) or a part of a wire (2*index+2)
+		void write_sig(const RTLIL::SigSpec &sig) {
+			write_uint(GetSize(sig.chunks()));
+			for (auto &chunk : sig.chunks()) {
+				if (chunk.wire == nullptr) {
+					write_uint(0);
+					write_bits(chunk.data, 0, chunk.width);
+				} else if (chunk.offset == 0 && chunk.width == chunk.wire->width) {
+					write_uint(2*wire_index.at(chunk.wire) + 1);
+				} else {
+					write_uint(2*wire_index.at(chunk.wire) + 2);
+					write_uint(chunk.offset);
+					write_uint(chunk.width);
+				}
+			}
+		}
+
+		void write_attributes(const dict<RTLIL::IdString, RTLIL::Const> &attributes) {
+			write_uint(GetSize(attributes));
+			for (auto &it : attributes) {
+				write_id(it.first);
+				write_const(it.second);
+			}
+		}
+
+		void write_actions(const std::vector<RTLIL::SigSig> &actions) {
+			write_uint(GetSize(actions));
+			for (auto &it : actions) {
+				write_sig(it.first);
+				write_sig(it.second);
+			}
+		}
+
+		void write_case(const RTLIL::CaseRule *cs) {
+			write_uint(GetSize(cs->compare));
+			for (auto &it : cs->compare)
+				write_sig(it);
+			write_actions(cs->actions);
+			write_uint(GetSize(cs->switches));
+			for (auto sw : cs->switches) {
+				write_attributes(sw->attributes);
+				write_sig(sw->signal);
+				write_uint(GetSize(sw->cases));
+				for (auto it : sw->cases)
+					write_case(it);
+			}
+		}
+
+		void write_module(RTLIL::Module *module)
+		{
+			write_attributes(module->attributes);
+
+			write_uint(GetSize(module->avail_parameters));
+			for (auto &it : module->avail_parameters)
+				write_id(it);
+
+			write_uint(GetSize(module->wires_));
+			for (auto wire : module->wires()) {
+				int idx = GetSize(wire_index);
+				wire_index[wire] = idx;
+				write_id(wire->name);
+				write_uint(wire->width);
+				write_int(wire->start_offset);
+				write_uint(wire->port_id);
+				write_uint(wire->port_input | wire->port_output << 1 | wire->upto << 2);
+				write_attributes(wire->attributes);
+			}
+
+			write_uint(GetSize(module->memories));
+			for (auto &it : module->memories) {
+				write_id(it.second->name);
+				write_uint(it.second->width);
+				write_int(it.second->start_offset);
+				write_uint(it.second->size);
+				write_attributes(it.second->attributes);
+			}
+
+			write_uint(GetSize(module->cells_));
+			for (auto cell : module->cells()) {
+				write_id(cell->name);
+				write_id(cell->type);
+				write_attributes(cell->attributes);
+				write_uint(GetSize(cell->parameters));
+				for (auto &it : cell->parameters) {
+					write_id(it.first);
+					write_const(it.second);
+				}
+				write_uint(GetSize(cell->connections()));
+				for (auto &it : cell->connections()) {
+					write_id(it.first);
+					write_sig(it.second);
+				}
+			}
+
+			write_uint(GetSize(module->processes));
+			for (auto &it : module->processes) {
+				RTLIL::Process *proc = it.second;
+				write_id(proc->name);
+				write_attributes(proc->attributes);
+				write_case(&proc->root_case);
+				write_uint(GetSize(proc->syncs));
+				for (auto sync : proc->syncs) {
+					write_uint(sync->type);
+					write_sig(sync->signal);
+					write_actions(sync->actions);
+				}
+			}
+
+			write_actions(module->connections());
+		}
+	};
+}
+
+std::string RTLIL_BIN_BACKEND::dump_design(RTLIL::Design *design, bool only_selected)
+{
+	RtlilBinStrings strings;
+	std::vector<std::pair<RTLIL::IdString, std::string>> sections;
+
+	for (auto module : design->modules()) {
+		if (only_selected && !design->selected_whole_module(module->name))
+			continue;
+		RtlilBinWriter writer(strings);
+		writer.write_module(module);
+		sections.push_back(std::make_pair(module->name, std::move(writer.buf)));
+	}
+
+	// the module names are used by the index, which comes after the string table
+	for (auto &it : sections)
+		strings.lookup(it.first);
+
+	RtlilBinWriter header(strings);
+	header.buf = magic;
+	header.write_uint(version);
+	header.write_uint(autoidx);
+
+	header.write_uint(GetSize(strings.list));
+	for (auto &it : strings.list) {
+		header.write_uint(it.size());
+		header.buf += it;
+	}
+
+	size_t offset = 0;
+	header.write_uint(GetSize(sections));
+	for (auto &it : sections) {
+		header.write_id(it.first);
+		header.write_uint(offset);
+		header.write_uint(it.second.size());
+		offset += it.second.size();
+	}
+
+	std::string buf = std::move(header.buf);
+	buf.reserve(buf.size() + offset);
+	for (auto &it : sections)
+		buf += it.second;
+	return buf;
+}
+
+YOSYS_NAMESPACE_END
+USING_YOSYS_NAMESPACE
+PRIVATE_NAMESPACE_BEGIN
+
+struct RtlilBinBackend : public Backend {
+	RtlilBinBackend() : Backend("rtlil_bin", "write design to binary RTLIL file") { }
+	virtual void help()
+	{
+		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
+		log("\n");
+		log("    write_rtlil_bin [options] [filename]\n");
+		log("\n");
+		log("Write the current design to a binary RTLIL file, that can be read back with\n");
+		log("the 'read_rtlil_bin' command. The file contains the same information as an\n");
+		log("ilang file, but it is smaller and much faster to write and to read. It also\n");
+		log("has an index, so that single modules can be loaded without decoding the\n");
+		log("others. The format is meant for checkpoints; it is not a stable interchange\n");
+		log("format between Yosys versions.\n");
+		log("\n");
+		log("    -selected\n");
+		log("        only write the modules that are selected as a whole.\n");
+		log("\n");
+	}
+	virtual void execute(std::ostream *&f, std::string filename, std::vector<std::string> args, RTLIL::Design *design)
+	{
+		bool selected = false;
+
+		log_header(design, "Executing RTLIL_BIN backend.\n");
+
+		size_t argidx;
+		for (argidx = 1; argidx < args.size(); argidx++) {
+			std::string arg = args[argidx];
+			if (arg == "-selected") {
+				selected = true;
+				continue;
+			}
+			break;
+		}
+		extra_args(f, filename, args, argidx);
+
+		// same order as with write_ilang, so that read_rtlil_bin creates the same design as read_ilang
+		design->sort();
+
+		log("Output filename: %s\n", filename.c_str());
+		std::string buf = RTLIL_BIN_BACKEND::dump_design(design, selected);
+		f->write(buf.data(), buf.size());
+	}
+} RtlilBinBackend;
+
+PRIVATE_NAMESPACE_END
@@ -0,0 +1,53 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Clifford Wolf <clifford@clifford.at>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *  ---
+ *
+ *  A binary representation of RTLIL for fast checkpoints (as understood by
+ *  the 'rtlil_bin' frontend). All integers are LEB128 varints, signed values
+ *  are zigzag encoded and all names and string constants (e.g. the "src"
+ *  attributes) are stored once in a string table:
+ *
+ *    file    := magic version autoidx strings index module*
+ *    strings := count { size bytes }
+ *    index   := count { name offset size }
+ *
+ *  The offsets in the index are relative to the end of the index, so that a
+ *  reader can load single modules without decoding the others. Within a
+ *  module, wires are referenced by their position in the module section.
+ *  Constants store eight bits per byte if they only contain 0 and 1, and two
+ *  states per byte otherwise.
+ *
+ */
+
+#ifndef RTLIL_BIN_BACKEND_H
+#define RTLIL_BIN_BACKEND_H
+
+#include "kernel/yosys.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+namespace RTLIL_BIN_BACKEND {
+	extern const char magic[];
+	extern const int version;
+
+	std::string dump_design(RTLIL::Design *design, bool only_selected);
+}
+
+YOSYS_NAMESPACE_END
+
+#endif
@@ -37,7 +37,7 @@ using namespace AST_INTERNAL;
 
 // instanciate global variables (public API)
 namespace AST {
-	std::string current_filename;
+	thread_local std::string current_filename;
 	void (*set_line_num)(int) = NULL;
 	int (*get_line_num)() = NULL;
 }
@@ -177,13 +177,20 @@ bool AstNode::get_bool_attribute(RTLIL::IdString id)
 	return attr->integer != 0;
 }
 
+// every thread uses its own sequence of hash indices (see renumber_hashidx())
+static thread_local unsigned int hashidx_count = 123456789;
+
+static unsigned int next_hashidx()
+{
+	hashidx_count = mkhash_xorshift(hashidx_count);
+	return hashidx_count;
+}
+
 // create new node (AstNode constructor)
 // (the optional child arguments make it easier to create AST trees)
 AstNode::AstNode(AstNodeType type, AstNode *child1, AstNode *child2, AstNode *child3)
 {
-	static unsigned int hashidx_count = 123456789;
-	hashidx_count = mkhash_xorshift(hashidx_count);
-	hashidx_ = hashidx_count;
+	hashidx_ = next_hashidx();
 
 	this->type = type;
 	filename = current_filename;
@@ -1170,6 +1177,240 @@ RTLIL::Module *AstModule::clone() const
 	return new_mod;
 }
 
+// binary AST serialization (integers are stored as LEB128 varints, filenames
+// are stored once and then referenced by index)
+namespace {
+	const char ast_serialize_magic[] = "YAST1";
+
+	struct AstWriter
+	{
+		std::string &buf;
+		dict<std::string, int> filenames;
+
+		AstWriter(std::string &buf) : buf(buf) { }
+
+		void write_uint(uint64_t v) {
+			while (v >= 0x80) {
+				buf += char(v | 0x80);
+				v >>= 7;
+			}
+			buf += char(v);
+		}
+
+		void write_int(int64_t v) {
+			write_uint((uint64_t(v) << 1) ^ uint64_t(v >> 63));
+		}
+
+		void write_str(const std::string &str) {
+			write_uint(str.size());
+			buf += str;
+		}
+
+		void write_node(AstNode *node)
+		{
+			write_uint(node->type);
+			write_str(node->str);
+
+			// two states per byte
+			write_uint(node->bits.size());
+			for (size_t i = 0; i < node->bits.size(); i += 2)
+				buf += char(node->bits[i] | (i+1 < node->bits.size() ? node->bits[i+1] << 4 : 0));
+
+			write_uint(node->is_input | node->is_output << 1 | node->is_reg << 2 | node->is_signed << 3 |
+					node->is_string << 4 | node->range_valid << 5 | node->range_swapped << 6 | node->basic_prep << 7);
+			write_int(node->port_id);
+			write_int(node->range_left);
+			write_int(node->range_right);
+			write_uint(node->integer);
+
+			uint64_t realbits;
+			memcpy(&realbits, &node->realvalue, sizeof(realbits));
+			write_uint(realbits);
+
+			write_uint(node->multirange_dimensions.size());
+			for (int dim : node->multirange_dimensions)
+				write_int(dim);
+
+			if (filenames.count(node->filename) == 0) {
+				int idx = GetSize(filenames);
+				filenames[node->filename] = idx;
+				write_uint(idx);
+				write_str(node->filename);
+			} else
+				write_uint(filenames.at(node->filename));
+			write_int(node->linenum);
+
+			write_uint(node->attributes.size());
+			for (auto &it : node->attributes) {
+				write_str(it.first.str());
+				write_node(it.second);
+			}
+
+			write_uint(node->children.size());
+			for (auto child : node->children)
+				write_node(child);
+		}
+	};
+
+	struct AstReader
+	{
+		const std::string &buf;
+		size_t pos;
+		std::vector<std::string> filenames;
+
+		AstReader(const std::string &buf) : buf(buf), pos(0) { }
+
+		// all read functions throw a std::runtime_error on malformed input
+		void fail() {
+			throw std::runtime_error("malformed AST data");
+		}
+
+		uint64_t read_uint() {
+			uint64_t v = 0;
+			for (int shift = 0; shift < 64; shift += 7) {
+				if (pos >= buf.size())
+					fail();
+				unsigned char ch = buf[pos++];
+				v |= uint64_t(ch & 0x7f) << shift;
+				if ((ch & 0x80) == 0)
+					return v;
+			}
+			fail();
+			return 0;
+		}
+
+		int64_t read_int() {
+			uint64_t v = read_uint();
+			return int64_t(v >> 1) ^ -int64_t(v & 1);
+		}
+
+		size_t read_size() {
+			uint64_t size = read_uint();
+			if (size > buf.size() - pos)
+				fail();
+			return size;
+		}
+
+		std::string read_str() {
+			size_t size = read_size();
+			pos += size;
+			return buf.substr(pos - size, size);
+		}
+
+		AstNode *read_node()
+		{
+			AstNode *node = new AstNode;
+			try
+			{
+				uint64_t type = read_uint();
+				if (type > AST_PACKAGE)
+					fail();
+				node->type = AstNodeType(type);
+				node->str = read_str();
+
+				size_t bits_size = read_uint();
+				if ((bits_size+1) / 2 > buf.size() - pos)
+					fail();
+				node->bits.resize(bits_size);
+				for (size_t i = 0; i < bits_size; i++) {
+					int state = (buf[pos + i/2] >> (i % 2 ? 4 : 0)) & 15;
+					if (state > RTLIL::Sm)
+						fail();
+					node->bits[i] = RTLIL::State(state);
+				}
+				pos += (bits_size+1) / 2;
+
+				uint64_t flags = read_uint();
+				node->is_input = (flags & 1) != 0;
+				node->is_output = (flags & 2) != 0;
+				node->is_reg = (flags & 4) != 0;
+				node->is_signed = (flags & 8) != 0;
+				node->is_string = (flags & 16) != 0;
+				node->range_valid = (flags & 32) != 0;
+				node->range_swapped = (flags & 64) != 0;
+				node->basic_prep = (flags & 128) != 0;
+				node->port_id = read_int();
+				node->range_left = read_int();
+				node->range_right = read_int();
+				node->integer = read_uint();
+
+				uint64_t realbits = read_uint();
+				memcpy(&node->realvalue, &realbits, sizeof(realbits));
+
+				node->multirange_dimensions.resize(read_size());
+				for (auto &dim : node->multirange_dimensions)
+					dim = read_int();
+
+				size_t filename_idx = read_uint();
+				if (filename_idx == filenames.size())
+					filenames.push_back(read_str());
+				if (filename_idx >= filenames.size())
+					fail();
+				node->filename = filenames[filename_idx];
+				node->linenum = read_int();
+
+				for (size_t i = read_size(); i > 0; i--) {
+					RTLIL::IdString id = read_str();
+					AstNode *attr = read_node();
+					if (node->attributes.count(id))
+						delete node->attributes.at(id);
+					node->attributes[id] = attr;
+				}
+
+				size_t children_size = read_size();
+				node->children.reserve(children_size);
+				for (size_t i = 0; i < children_size; i++)
+					node->children.push_back(read_node());
+			}
+			catch (...)
+			{
+				delete node;
+				throw;
+			}
+			return node;
+		}
+	};
+}
+
+void AST::renumber_hashidx(AstNode *ast)
+{
+	ast->hashidx_ = next_hashidx();
+	for (auto &it : ast->attributes)
+		renumber_hashidx(it.second);
+	for (auto child : ast->children)
+		renumber_hashidx(child);
+}
+
+std::string AST::serialize(AstNode *ast)
+{
+	std::string buf = ast_serialize_magic;
+	AstWriter writer(buf);
+	writer.write_node(ast);
+	return buf;
+}
+
+AstNode *AST::deserialize(const std::string &data)
+{
+	if (data.compare(0, strlen(ast_serialize_magic), ast_serialize_magic) != 0)
+		return NULL;
+
+	AstReader reader(data);
+	reader.pos = strlen(ast_serialize_magic);
+
+	AstNode *ast = NULL;
+	try {
+		ast = reader.read_node();
+	} catch (std::runtime_error &) {
+		return NULL;
+	}
+
+	if (reader.pos != data.size()) {
+		delete ast;
+		return NULL;
+	}
+	return ast;
+}
+
 // internal dummy line number callbacks
 namespace {
 	int internal_line_num;
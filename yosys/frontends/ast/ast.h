@@ -277,6 +277,17 @@ namespace AST
 	void process(RTLIL::Design *design, AstNode *ast, bool dump_ast1, bool dump_ast2, bool dump_vlog, bool dump_rtlil, bool nolatches, bool nomeminit,
 			bool nomem2reg, bool mem2reg, bool lib, bool noopt, bool icells, bool ignore_redef, bool defer, bool autowire);
 
+	// convert an AST tree as generated by a frontend parser (before simplification) to a
+	// compact binary representation and back, e.g. for caching parsed source files.
+	// deserialize() returns NULL if the data is not a valid serialized AST.
+	std::string serialize(AstNode *ast);
+	AstNode *deserialize(const std::string &data);
+
+	// assign new hash indices to all nodes of an AST tree from the sequence of the calling thread,
+	// e.g. so that the hash indices of trees created by parallel parser threads do not depend on
+	// the thread schedule
+	void renumber_hashidx(AstNode *ast);
+
 	// parametric modules are supported directly by the AST library
 	// therefore we need our own derivate of RTLIL::Module with overloaded virtual functions
 	struct AstModule : RTLIL::Module {
@@ -290,7 +301,8 @@ namespace AST
 	// this must be set by the language frontend before parsing the sources
 	// the AstNode constructor then uses current_filename and get_line_num()
 	// to initialize the filename and linenum properties of new nodes
-	extern std::string current_filename;
+	// (current_filename is thread local, so that frontends can parse files in parallel)
+	extern thread_local std::string current_filename;
 	extern void (*set_line_num)(int);
 	extern int (*get_line_num)();
 
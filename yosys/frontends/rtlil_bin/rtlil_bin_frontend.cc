@@ -0,0 +1,503 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Clifford Wolf <clifford@clifford.at>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *  ---
+ *
+ *  A frontend for the binary RTLIL representation (as generated by the
+ *  'rtlil_bin' backend).
+ *
+ */
+
+#include "rtlil_bin_frontend.h"
+#include "backends/rtlil_bin/rtlil_bin_backend.h"
+#include "kernel/register.h"
+#include "kernel/log.h"
+#include <stdexcept>
+#include <errno.h>
+
+#ifndef _WIN32
+#  include <sys/types.h>
+#  include <sys/stat.h>
+#  include <sys/mman.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
+YOSYS_NAMESPACE_BEGIN
+
+using namespace RTLIL_BIN_FRONTEND;
+
+namespace {
+	struct RtlilBinReader
+	{
+		RtlilBinFile &file;
+		const char *data;
+		size_t pos, end;
+		std::vector<RTLIL::Wire*> wires;
+
+		RtlilBinReader(RtlilBinFile &file, size_t pos, size_t end) : file(file), data(file.data), pos(pos), end(end) { }
+
+		// all read functions throw a std::runtime_error on malformed input
+		void fail() {
+			throw std::runtime_error("malformed data");
+		}
+
+		uint64_t read_uint() {
+			uint64_t v = 0;
+			for (int shift = 0; shift < 64; shift += 7) {
+				if (pos >= end)
+					fail();
+				unsigned char ch = data[pos++];
+				v |= uint64_t(ch & 0x7f) << shift;
+				if ((ch & 0x80) == 0)
+					return v;
+			}
+			fail();
+			return 0;
+		}
+
+		int64_t read_int() {
+			uint64_t v = read_uint();
+			return int64_t(v >> 1) ^ -int64_t(v & 1);
+		}
+
+		// a count of items that take at least one byte each
+		size_t read_size() {
+			uint64_t size = read_uint();
+			if (size > end - pos)
+				fail();
+			return size;
+		}
+
+		int read_width() {
+			uint64_t width = read_uint();
+			if (width > INT_MAX)
+				fail();
+			return width;
+		}
+
+		RTLIL::IdString read_id() {
+			uint64_t idx = read_uint();
+			if (idx >= file.strings.size())
+				fail();
+			RTLIL::IdString &id = file.strings[idx];
+			if (id.empty()) {
+				auto &entry = file.string_table[idx];
+				id = std::string(data + entry.first, entry.second);
+			}
+			return id;
+		}
+
+		void read_bits(std::vector<RTLIL::State> &bits)
+		{
+			uint64_t header = read_uint();
+			if ((header >> 2) > INT_MAX)
+				fail();
+			size_t width = header >> 2;
+			bits.resize(width);
+
+			switch (header & 3)
+			{
+			case 0:
+				if ((width+1) / 2 > end - pos)
+					fail();
+				for (size_t i = 0; i < width; i++) {
+					int state = (data[pos + i/2] >> (i % 2 ? 4 : 0)) & 15;
+					if (state > RTLIL::Sm)
+						fail();
+					bits[i] = RTLIL::State(state);
+				}
+				pos += (width+1) / 2;
+				break;
+
+			case 1:
+				if ((width+7) / 8 > end - pos)
+					fail();
+				for (size_t i = 0; i < width; i++)
+					bits[i] = (data[pos + i/8] >> (i % 8)) & 1 ? RTLIL::S1 : RTLIL::S0;
+				pos += (width+7) / 8;
+				break;
+
+			case 2: {
+				uint64_t idx = read_uint();
+				if (idx >= file.string_table.size() || file.string_table[idx].second * 8 != width)
+					fail();
+				const char *p = file.data + file.string_table[idx].first;
+				for (size_t i = 0; i < width; i++)
+					bits[i] = (p[i/8] >> (i % 8)) & 1 ? RTLIL::S1 : RTLIL::S0;
+				break;
+			}
+
+			default:
+				fail();
+			}
+		}
+
+		RTLIL::Const read_const() {
+			RTLIL::Const value;
+			value.flags = read_uint();
+			read_bits(value.bits);
+			return value;
+		}
+
+		RTLIL::SigSpec read_sig() {
+			RTLIL::SigSpec sig;
+			for (size_t i = read_size(); i > 0; i--) {
+				uint64_t tag = read_uint();
+				if (tag == 0) {
+					RTLIL::SigChunk chunk;
+					read_bits(chunk.data);
+					chunk.width = GetSize(chunk.data);
+					sig.append(chunk);
+					continue;
+				}
+				uint64_t idx = (tag-1) / 2;
+				if (idx >= wires.size())
+					fail();
+				RTLIL::Wire *wire = wires[idx];
+				if (tag % 2 == 1) {
+					sig.append(wire);
+				} else {
+					int offset = read_width();
+					int width = read_width();
+					if (offset + int64_t(width) > wire->width)
+						fail();
+					sig.append(RTLIL::SigSpec(wire, offset, width));
+				}
+			}
+			return sig;
+		}
+
+		void read_attributes(dict<RTLIL::IdString, RTLIL::Const> &attributes) {
+			for (size_t i = read_size(); i > 0; i--) {
+				RTLIL::IdString id = read_id();
+				attributes[id] = read_const();
+			}
+		}
+
+		void read_actions(std::vector<RTLIL::SigSig> &actions) {
+			for (size_t i = read_size(); i > 0; i--) {
+				RTLIL::SigSpec lhs = read_sig();
+				RTLIL::SigSpec rhs = read_sig();
+				if (GetSize(lhs) != GetSize(rhs))
+					fail();
+				actions.push_back(RTLIL::SigSig(lhs, rhs));
+			}
+		}
+
+		void read_case(RTLIL::CaseRule *cs) {
+			for (size_t i = read_size(); i > 0; i--)
+				cs->compare.push_back(read_sig());
+			read_actions(cs->actions);
+			for (size_t i = read_size(); i > 0; i--) {
+				RTLIL::SwitchRule *sw = new RTLIL::SwitchRule;
+				cs->switches.push_back(sw);
+				read_attributes(sw->attributes);
+				sw->signal = read_sig();
+				for (size_t j = read_size(); j > 0; j--) {
+					RTLIL::CaseRule *child = new RTLIL::CaseRule;
+					sw->cases.push_back(child);
+					read_case(child);
+				}
+			}
+		}
+
+		void read_module(RTLIL::Module *module)
+		{
+			read_attributes(module->attributes);
+
+			for (size_t i = read_size(); i > 0; i--)
+				module->avail_parameters.insert(read_id());
+
+			for (size_t i = read_size(); i > 0; i--) {
+				RTLIL::IdString name = read_id();
+				if (module->count_id(name))
+					fail();
+				RTLIL::Wire *wire = module->addWire(name, read_width());
+				wire->start_offset = read_int();
+				wire->port_id = read_width();
+				uint64_t flags = read_uint();
+				wire->port_input = (flags & 1) != 0;
+				wire->port_output = (flags & 2) != 0;
+				wire->upto = (flags & 4) != 0;
+				read_attributes(wire->attributes);
+				wires.push_back(wire);
+			}
+
+			for (size_t i = read_size(); i > 0; i--) {
+				RTLIL::Memory *memory = new RTLIL::Memory;
+				memory->name = read_id();
+				if (module->count_id(memory->name)) {
+					delete memory;
+					fail();
+				}
+				module->memories[memory->name] = memory;
+				memory->width = read_width();
+				memory->start_offset = read_int();
+				memory->size = read_width();
+				read_attributes(memory->attributes);
+			}
+
+			for (size_t i = read_size(); i > 0; i--) {
+				RTLIL::IdString name = read_id();
+				if (module->count_id(name))
+					fail();
+				RTLIL::Cell *cell = module->addCell(name, read_id());
+				read_attributes(cell->attributes);
+				for (size_t j = read_size(); j > 0; j--) {
+					RTLIL::IdString id = read_id();
+					cell->parameters[id] = read_const();
+				}
+				for (size_t j = read_size(); j > 0; j--) {
+					RTLIL::IdString id = read_id();
+					cell->setPort(id, read_sig());
+				}
+			}
+
+			for (size_t i = read_size(); i > 0; i--) {
+				RTLIL::Process *proc = new RTLIL::Process;
+				proc->name = read_id();
+				if (module->processes.count(proc->name)) {
+					delete proc;
+					fail();
+				}
+				module->processes[proc->name] = proc;
+				read_attributes(proc->attributes);
+				read_case(&proc->root_case);
+				for (size_t j = read_size(); j > 0; j--) {
+					RTLIL::SyncRule *sync = new RTLIL::SyncRule;
+					proc->syncs.push_back(sync);
+					uint64_t type = read_uint();
+					if (type > RTLIL::STi)
+						fail();
+					sync->type = RTLIL::SyncType(type);
+					sync->signal = read_sig();
+					read_actions(sync->actions);
+				}
+			}
+
+			std::vector<RTLIL::SigSig> connections;
+			read_actions(connections);
+			for (auto &it : connections)
+				module->connect(it);
+
+			if (pos != end)
+				fail();
+		}
+	};
+}
+
+RtlilBinFile::~RtlilBinFile()
+{
+#ifndef _WIN32
+	if (mapped_data != nullptr)
+		munmap(mapped_data, size);
+#endif
+}
+
+void RtlilBinFile::open_file(std::string filename)
+{
+#ifndef _WIN32
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if (fd < 0)
+		log_error("Can't open input file `%s' for reading: %s\n", filename.c_str(), strerror(errno));
+
+	struct stat st;
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+		void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (p != MAP_FAILED) {
+			close(fd);
+			mapped_data = p;
+			open((const char*)p, st.st_size, filename);
+			return;
+		}
+	}
+	close(fd);
+#endif
+
+	std::ifstream f(filename.c_str(), std::ifstream::binary);
+	if (f.fail())
+		log_error("Can't open input file `%s' for reading: %s\n", filename.c_str(), strerror(errno));
+	buffer.assign((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+	open(buffer.data(), buffer.size(), filename);
+}
+
+bool RtlilBinFile::check_magic(const char *data, size_t size)
+{
+	size_t len = strlen(RTLIL_BIN_BACKEND::magic);
+	return size >= len && memcmp(data, RTLIL_BIN_BACKEND::magic, len) == 0;
+}
+
+void RtlilBinFile::open(const char *data, size_t size, std::string filename)
+{
+	this->data = data;
+	this->size = size;
+	this->filename = filename;
+
+	if (!check_magic(data, size))
+		log_error("File `%s' is not a binary RTLIL file.\n", filename.c_str());
+
+	RtlilBinReader reader(*this, strlen(RTLIL_BIN_BACKEND::magic), size);
+
+	try
+	{
+		if (reader.read_uint() != uint64_t(RTLIL_BIN_BACKEND::version))
+			log_error("File `%s' was written by an incompatible version of the rtlil_bin backend.\n", filename.c_str());
+
+		autoidx = reader.read_width();
+
+		size_t num_strings = reader.read_size();
+		string_table.clear();
+		string_table.reserve(num_strings);
+		for (size_t i = 0; i < num_strings; i++) {
+			size_t len = reader.read_size();
+			string_table.push_back(std::make_pair(reader.pos, len));
+			reader.pos += len;
+		}
+		strings.clear();
+		strings.resize(num_strings);
+
+		size_t num_modules = reader.read_size();
+		std::vector<std::pair<size_t, size_t>> sections;
+		module_names.clear();
+		module_index.clear();
+		for (size_t i = 0; i < num_modules; i++) {
+			RTLIL::IdString name = reader.read_id();
+			size_t offset = reader.read_uint();
+			size_t length = reader.read_uint();
+			if (module_index.count(name))
+				reader.fail();
+			module_index[name] = GetSize(module_names);
+			module_names.push_back(name);
+			sections.push_back(std::make_pair(offset, length));
+		}
+
+		module_sections.clear();
+		for (auto &it : sections) {
+			if (it.first > size - reader.pos || it.second > size - reader.pos - it.first)
+				reader.fail();
+			module_sections.push_back(std::make_pair(reader.pos + it.first, reader.pos + it.first + it.second));
+		}
+	}
+	catch (std::runtime_error &)
+	{
+		log_error("Malformed header in binary RTLIL file `%s'.\n", filename.c_str());
+	}
+}
+
+RTLIL::Module *RtlilBinFile::load_module(int idx)
+{
+	RTLIL::Module *module = new RTLIL::Module;
+	module->name = module_names.at(idx);
+
+	try {
+		RtlilBinReader reader(*this, module_sections.at(idx).first, module_sections.at(idx).second);
+		reader.read_module(module);
+	} catch (std::runtime_error &) {
+		delete module;
+		log_error("Malformed data for module `%s' in binary RTLIL file `%s'.\n", log_id(module_names.at(idx)), filename.c_str());
+	}
+
+	module->fixup_ports();
+	return module;
+}
+
+struct RtlilBinFrontend : public Frontend {
+	RtlilBinFrontend() : Frontend("rtlil_bin", "read modules from binary RTLIL file") {
+		handles_lazy_modules = true;
+	}
+	virtual void help()
+	{
+		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
+		log("\n");
+		log("    read_rtlil_bin [options] [filename]\n");
+		log("\n");
+		log("Load modules from a binary RTLIL file (as written by 'write_rtlil_bin') to the\n");
+		log("current design. The file is mapped into memory, not read.\n");
+		log("\n");
+		log("    -module <name>\n");
+		log("        only load the module with the given name. the other modules in the\n");
+		log("        file are not decoded. this option can be used multiple times.\n");
+		log("\n");
+		log("    -lazy\n");
+		log("        only add placeholders for the modules to the design. A module is\n");
+		log("        decoded when a command first uses it. Commands that are not aware of\n");
+		log("        such lazy modules (most of them) materialize all modules of the\n");
+		log("        design before they run, but the placeholders can be saved and loaded\n");
+		log("        with the 'design' command without decoding them, and the module\n");
+		log("        lookup in passes that are aware of them (e.g. 'incremental') only\n");
+		log("        decodes the modules that are actually used. The file must not be\n");
+		log("        changed as long as the design contains modules from it.\n");
+		log("\n");
+	}
+	virtual void execute(std::istream *&f, std::string filename, std::vector<std::string> args, RTLIL::Design *design)
+	{
+		std::vector<RTLIL::IdString> selected_modules;
+		bool lazy = false;
+
+		log_header(design, "Executing RTLIL_BIN frontend.\n");
+
+		size_t argidx;
+		for (argidx = 1; argidx < args.size(); argidx++) {
+			std::string arg = args[argidx];
+			if (arg == "-module" && argidx+1 < args.size()) {
+				selected_modules.push_back(RTLIL::escape_id(args[++argidx]));
+				continue;
+			}
+			if (arg == "-lazy") {
+				lazy = true;
+				continue;
+			}
+			break;
+		}
+		extra_args(f, filename, args, argidx);
+		log("Input filename: %s\n", filename.c_str());
+
+		std::shared_ptr<RtlilBinFile> file = std::make_shared<RtlilBinFile>();
+		if (dynamic_cast<std::ifstream*>(f) != nullptr) {
+			file->open_file(filename);
+		} else {
+			file->buffer.assign((std::istreambuf_iterator<char>(*f)), std::istreambuf_iterator<char>());
+			file->open(file->buffer.data(), file->buffer.size(), filename);
+		}
+
+		std::vector<int> module_list;
+		if (selected_modules.empty()) {
+			for (int i = 0; i < GetSize(file->module_names); i++)
+				module_list.push_back(i);
+		} else {
+			for (auto name : selected_modules) {
+				if (file->module_index.count(name) == 0)
+					log_error("Module `%s' not found in `%s'.\n", log_id(name), filename.c_str());
+				module_list.push_back(file->module_index.at(name));
+			}
+		}
+
+		for (int idx : module_list) {
+			if (design->has(file->module_names[idx]))
+				log_error("Redefinition of module %s.\n", log_id(file->module_names[idx]));
+			if (lazy)
+				design->add_lazy(file->module_names[idx], std::make_shared<RtlilBinLazyModule>(file, idx));
+			else
+				design->add(file->load_module(idx));
+		}
+
+		autoidx = max(autoidx, file->autoidx);
+	}
+} RtlilBinFrontend;
+
+YOSYS_NAMESPACE_END
@@ -0,0 +1,90 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Clifford Wolf <clifford@clifford.at>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *  ---
+ *
+ *  A frontend for the binary RTLIL representation (as generated by the
+ *  'rtlil_bin' backend).
+ *
+ */
+
+#ifndef RTLIL_BIN_FRONTEND_H
+#define RTLIL_BIN_FRONTEND_H
+
+#include "kernel/yosys.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+namespace RTLIL_BIN_FRONTEND
+{
+	// the index of a binary RTLIL file. the data is not copied and must stay
+	// valid as long as modules are loaded from it, unless it is owned by the
+	// object (see open_file()).
+	struct RtlilBinFile
+	{
+		const char *data;
+		size_t size;
+		std::string filename;
+
+		// set by open_file()
+		void *mapped_data;
+		std::string buffer;
+
+		int autoidx;
+		std::vector<RTLIL::IdString> module_names;
+		std::vector<std::pair<size_t, size_t>> module_sections;
+		dict<RTLIL::IdString, int> module_index;
+
+		std::vector<std::pair<size_t, size_t>> string_table;
+		std::vector<RTLIL::IdString> strings;
+
+		RtlilBinFile() : data(nullptr), size(0), mapped_data(nullptr), autoidx(0) { }
+		RtlilBinFile(const RtlilBinFile&) = delete;
+		RtlilBinFile &operator=(const RtlilBinFile&) = delete;
+		~RtlilBinFile();
+
+		static bool check_magic(const char *data, size_t size);
+
+		// calls log_error() if the data is malformed
+		void open(const char *data, size_t size, std::string filename);
+
+		// maps the file into memory (or reads it, where mmap() is not
+		// available) and opens it
+		void open_file(std::string filename);
+
+		// creates the module with the given index of module_names. the module
+		// is not added to a design.
+		RTLIL::Module *load_module(int idx);
+	};
+
+	// a module of a shared binary RTLIL file that is loaded on first use
+	struct RtlilBinLazyModule : RTLIL::LazyModule
+	{
+		std::shared_ptr<RtlilBinFile> file;
+		int idx;
+
+		RtlilBinLazyModule(std::shared_ptr<RtlilBinFile> file, int idx) : file(file), idx(idx) { }
+
+		virtual RTLIL::Module *load() {
+			return file->load_module(idx);
+		}
+	};
+}
+
+YOSYS_NAMESPACE_END
+
+#endif
@@ -41,56 +41,63 @@
 YOSYS_NAMESPACE_BEGIN
 using namespace VERILOG_FRONTEND;
 
-static std::list<std::string> output_code;
-static std::list<std::string> input_buffer;
-static size_t input_buffer_charp;
+// The remaining input is kept in a single buffer in reverse order, so that
+// putting text back in front of it (look-ahead characters, macro expansions
+// and included files) is just an append at the end of the buffer.
+static std::string input_buffer;
+static std::string output_code;
+
+static bool is_ident_char[256];
 
 static void return_char(char ch)
 {
-	if (input_buffer_charp == 0)
-		input_buffer.push_front(std::string() + ch);
-	else
-		input_buffer.front()[--input_buffer_charp] = ch;
+	input_buffer.push_back(ch);
 }
 
-static void insert_input(std::string str)
+static void insert_input(const std::string &str)
 {
-	if (input_buffer_charp != 0) {
-		input_buffer.front() = input_buffer.front().substr(input_buffer_charp);
-		input_buffer_charp = 0;
-	}
-	input_buffer.push_front(str);
+	input_buffer.append(str.rbegin(), str.rend());
 }
 
 static char next_char()
 {
-	if (input_buffer.empty())
-		return 0;
-
-	log_assert(input_buffer_charp <= input_buffer.front().size());
-	if (input_buffer_charp == input_buffer.front().size()) {
-		input_buffer_charp = 0;
-		input_buffer.pop_front();
-		return next_char();
+	while (!input_buffer.empty()) {
+		char ch = input_buffer.back();
+		input_buffer.pop_back();
+		if (ch != '\r')
+			return ch;
 	}
+	return 0;
+}
+
+// append the longest run of characters for which accept() is true from the
+// front of the input to str, skipping '\r' like next_char()
+template<typename F>
+static void scan_chars(std::string &str, F accept)
+{
+	size_t i = input_buffer.size();
+	while (i > 0 && (input_buffer[i-1] == '\r' || accept(input_buffer[i-1])))
+		i--;
+	for (size_t k = input_buffer.size(); k > i; k--)
+		if (input_buffer[k-1] != '\r')
+			str += input_buffer[k-1];
+	input_buffer.resize(i);
+}
 
-	char ch = input_buffer.front()[input_buffer_charp++];
-	return ch == '\r' ? next_char() : ch;
+static bool is_space_char(char ch)
+{
+	return ch == ' ' || ch == '\t';
+}
+
+static bool is_ident(char ch)
+{
+	return is_ident_char[(unsigned char)ch];
 }
 
 static std::string skip_spaces()
 {
 	std::string spaces;
-	while (1) {
-		char ch = next_char();
-		if (ch == 0)
-			break;
-		if (ch != ' ' && ch != '\t') {
-			return_char(ch);
-			break;
-		}
-		spaces += ch;
-	}
+	scan_chars(spaces, is_space_char);
 	return spaces;
 }
 
@@ -105,7 +112,7 @@ static std::string next_token(bool pass_newline = false)
 	token += ch;
 	if (ch == '\n') {
 		if (pass_newline) {
-			output_code.push_back(token);
+			output_code += token;
 			return "";
 		}
 		return token;
@@ -113,13 +120,7 @@ static std::string next_token(bool pass_newline = false)
 
 	if (ch == ' ' || ch == '\t')
 	{
-		while ((ch = next_char()) != 0) {
-			if (ch != ' ' && ch != '\t') {
-				return_char(ch);
-				break;
-			}
-			token += ch;
-		}
+		scan_chars(token, is_space_char);
 	}
 	else if (ch == '"')
 	{
@@ -180,15 +181,8 @@ static std::string next_token(bool pass_newline = false)
 	}
 	else
 	{
-		const char *ok = "abcdefghijklmnopqrstuvwxyz_ABCDEFGHIJKLMNOPQRSTUVWXYZ$0123456789";
-		if (ch == '`' || strchr(ok, ch) != NULL)
-			while ((ch = next_char()) != 0) {
-				if (strchr(ok, ch) == NULL) {
-					return_char(ch);
-					break;
-				}
-				token += ch;
-			}
+		if (ch == '`' || is_ident(ch))
+			scan_chars(token, is_ident);
 	}
 
 	return token;
@@ -199,15 +193,14 @@ static void input_file(std::istream &f, std::string filename)
 	char buffer[513];
 	int rc;
 
-	insert_input("");
-	auto it = input_buffer.begin();
-
-	input_buffer.insert(it, "`file_push \"" + filename + "\"\n");
+	std::string text = "`file_push \"" + filename + "\"\n";
 	while ((rc = readsome(f, buffer, sizeof(buffer)-1)) > 0) {
 		buffer[rc] = 0;
-		input_buffer.insert(it, buffer);
+		text += buffer;
 	}
-	input_buffer.insert(it, "\n`file_pop\n");
+	text += "\n`file_pop\n";
+
+	insert_input(text);
 }
 
 std::string frontend_verilog_preproc(std::istream &f, std::string filename, const std::map<std::string, std::string> &pre_defines_map,
@@ -220,7 +213,9 @@ std::string frontend_verilog_preproc(std::istream &f, std::string filename, cons
 
 	output_code.clear();
 	input_buffer.clear();
-	input_buffer_charp = 0;
+
+	for (const char *p = "abcdefghijklmnopqrstuvwxyz_ABCDEFGHIJKLMNOPQRSTUVWXYZ$0123456789"; *p; p++)
+		is_ident_char[(unsigned char)*p] = true;
 
 	input_file(f, filename);
 
@@ -285,7 +280,7 @@ std::string frontend_verilog_preproc(std::istream &f, std::string filename, cons
 
 		if (ifdef_fail_level > 0) {
 			if (tok == "\n")
-				output_code.push_back(tok);
+				output_code += tok;
 			continue;
 		}
 
@@ -322,7 +317,7 @@ std::string frontend_verilog_preproc(std::istream &f, std::string filename, cons
 				}
 			}
 			if (ff.fail())
-				output_code.push_back("`file_notfound " + fn);
+				output_code += "`file_notfound " + fn;
 			else
 				input_file(ff, fn);
 			continue;
@@ -449,16 +444,12 @@ std::string frontend_verilog_preproc(std::istream &f, std::string filename, cons
 			continue;
 		}
 
-		output_code.push_back(tok);
+		output_code += tok;
 	}
 
 	std::string output;
-	for (auto &str : output_code)
-		output += str;
-
-	output_code.clear();
+	output.swap(output_code);
 	input_buffer.clear();
-	input_buffer_charp = 0;
 
 	return output;
 }
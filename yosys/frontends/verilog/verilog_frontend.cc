@@ -31,6 +31,11 @@
 #include "libs/sha1/sha1.h"
 #include <stdarg.h>
 
+#ifndef _WIN32
+#  include <sys/types.h>
+#  include <sys/stat.h>
+#endif
+
 YOSYS_NAMESPACE_BEGIN
 using namespace VERILOG_FRONTEND;
 
@@ -39,6 +44,11 @@ using namespace VERILOG_FRONTEND;
 static std::vector<std::string> verilog_defaults;
 static std::list<std::vector<std::string>> verilog_defaults_stack;
 
+const std::vector<std::string> &frontend_verilog_defaults()
+{
+	return verilog_defaults;
+}
+
 static void error_on_dpi_function(AST::AstNode *node)
 {
 	if (node->type == AST::AST_DPI_FUNCTION)
@@ -47,6 +57,108 @@ static void error_on_dpi_function(AST::AstNode *node)
 		error_on_dpi_function(child);
 }
 
+// an input file of read_verilog, with the state of the lexer after parsing it that is
+// still used by AST::process()
+struct VerilogInput
+{
+	std::string filename;
+	std::string code;
+	std::string cache_filename;
+	AST::AstNode *ast = NULL;
+	bool cached = false;
+	bool nettype_wire = true;
+	int lineno = 1;
+};
+
+// A parse cache entry holds the state of the lexer after parsing in a text line,
+// followed by the serialized AST.
+static bool load_cache_entry(VerilogInput &input)
+{
+	std::ifstream f(input.cache_filename.c_str(), std::ios::binary);
+	if (f.fail())
+		return false;
+
+	std::stringstream buf;
+	buf << f.rdbuf();
+	std::string data = buf.str();
+
+	int nettype_wire = 0, lineno = 0, n = 0;
+	if (sscanf(data.c_str(), "%d %d\n%n", &nettype_wire, &lineno, &n) != 2 || n == 0) {
+		log_warning("Ignoring invalid cache entry `%s'.\n", input.cache_filename.c_str());
+		return false;
+	}
+
+	AST::AstNode *ast = AST::deserialize(data.substr(n));
+	if (ast == NULL || ast->type != AST::AST_DESIGN) {
+		log_warning("Ignoring invalid cache entry `%s'.\n", input.cache_filename.c_str());
+		delete ast;
+		return false;
+	}
+
+	log("Using cached AST from `%s'.\n", input.cache_filename.c_str());
+	input.ast = ast;
+	input.cached = true;
+	input.nettype_wire = nettype_wire != 0;
+	input.lineno = lineno;
+	return true;
+}
+
+static void store_cache_entry(std::string cache_dir, const VerilogInput &input)
+{
+#ifdef _WIN32
+	mkdir(cache_dir.c_str());
+#else
+	mkdir(cache_dir.c_str(), 0777);
+#endif
+
+	// write to a temporary file first, so that concurrent runs sharing the cache
+	// never see partial entries
+	std::string tmp_filename = make_temp_file(cache_dir + "/.read_verilog_XXXXXX");
+	std::ofstream f(tmp_filename.c_str(), std::ios::binary);
+	if (f.fail())
+		log_cmd_error("Can't open cache file `%s' for writing: %s\n", tmp_filename.c_str(), strerror(errno));
+
+	f << (input.nettype_wire ? 1 : 0) << " " << input.lineno << "\n";
+	f << AST::serialize(input.ast);
+
+	f.close();
+	if (f.fail() || rename(tmp_filename.c_str(), input.cache_filename.c_str()) != 0) {
+		remove(tmp_filename.c_str());
+		log_cmd_error("Can't write cache entry `%s'.\n", input.cache_filename.c_str());
+	}
+}
+
+// parse the (pre-processed) code of an input file, using the lexer and parser state
+// of the calling thread
+static void parse_input(VerilogInput &input, bool nettype_wire)
+{
+	std::istringstream code_stream(input.code);
+
+	AST::current_filename = input.filename;
+	default_nettype_wire = nettype_wire;
+	lexin = &code_stream;
+	current_ast = new AST::AstNode(AST::AST_DESIGN);
+
+	try {
+		frontend_verilog_yyset_lineno(1);
+		frontend_verilog_yyrestart(NULL);
+		frontend_verilog_yyparse();
+		frontend_verilog_yylex_destroy();
+	} catch (...) {
+		frontend_verilog_yylex_destroy();
+		delete current_ast;
+		current_ast = NULL;
+		lexin = NULL;
+		throw;
+	}
+
+	input.ast = current_ast;
+	input.nettype_wire = default_nettype_wire;
+	input.lineno = frontend_verilog_yyget_lineno();
+	current_ast = NULL;
+	lexin = NULL;
+}
+
 struct VerilogFrontend : public Frontend {
 	VerilogFrontend() : Frontend("verilog", "read modules from Verilog file") { }
 	virtual void help()
@@ -124,6 +236,20 @@ struct VerilogFrontend : public Frontend {
 		log("    -nopp\n");
 		log("        do not run the pre-processor\n");
 		log("\n");
+		log("    -j <N>\n");
+		log("        when multiple files are given, parse them in parallel using N\n");
+		log("        threads. The files are still pre-processed and imported into the\n");
+		log("        design one after the other in the given order, so the result does\n");
+		log("        not depend on N.\n");
+		log("\n");
+		log("    -cache <dir>\n");
+		log("        cache the output of the parser in the specified directory, which\n");
+		log("        is created if necessary. The key of a cache entry is the SHA1 hash\n");
+		log("        of the pre-processed code (thus including all include files and\n");
+		log("        defines), the filename, the options and the Yosys version. When\n");
+		log("        an entry is found, the AST is loaded from the cache instead of\n");
+		log("        parsing the code again. This option has no effect with -nopp.\n");
+		log("\n");
 		log("    -nodpi\n");
 		log("        disable DPI-C support\n");
 		log("\n");
@@ -189,6 +315,8 @@ struct VerilogFrontend : public Frontend {
 		bool flag_icells = false;
 		bool flag_ignore_redef = false;
 		bool flag_defer = false;
+		std::string cache_dir;
+		int num_threads = 0;
 		std::map<std::string, std::string> defines_map;
 		std::list<std::string> include_dirs;
 		std::list<std::string> attributes;
@@ -268,6 +396,14 @@ struct VerilogFrontend : public Frontend {
 				flag_nopp = true;
 				continue;
 			}
+			if (arg == "-j" && argidx+1 < args.size()) {
+				num_threads = std::max(atoi(args[++argidx].c_str()), 1);
+				continue;
+			}
+			if (arg == "-cache" && argidx+1 < args.size()) {
+				cache_dir = args[++argidx];
+				continue;
+			}
 			if (arg == "-nodpi") {
 				flag_nodpi = true;
 				continue;
@@ -332,47 +468,154 @@ struct VerilogFrontend : public Frontend {
 		}
 		extra_args(f, filename, args, argidx);
 
-		log("Parsing %s%s input from `%s' to AST representation.\n",
-				formal_mode ? "formal " : "", sv_mode ? "SystemVerilog" : "Verilog", filename.c_str());
-
-		AST::current_filename = filename;
 		AST::set_line_num = &frontend_verilog_yyset_lineno;
 		AST::get_line_num = &frontend_verilog_yyget_lineno;
 
-		current_ast = new AST::AstNode(AST::AST_DESIGN);
+		bool initial_nettype_wire = default_nettype_wire;
+		std::vector<VerilogInput> inputs;
+
+		auto read_input = [&](std::istream *in, std::string in_filename)
+		{
+			inputs.push_back(VerilogInput());
+			VerilogInput &input = inputs.back();
+			input.filename = in_filename;
 
-		lexin = f;
-		std::string code_after_preproc;
+			log("Parsing %s%s input from `%s' to AST representation.\n",
+					formal_mode ? "formal " : "", sv_mode ? "SystemVerilog" : "Verilog", input.filename.c_str());
+
+			if (flag_nopp) {
+				std::stringstream buf;
+				buf << in->rdbuf();
+				input.code = buf.str();
+				return;
+			}
 
-		if (!flag_nopp) {
-			code_after_preproc = frontend_verilog_preproc(*f, filename, defines_map, design->verilog_defines, include_dirs);
+			input.code = frontend_verilog_preproc(*in, input.filename, defines_map, design->verilog_defines, include_dirs);
 			if (flag_ppdump)
-				log("-- Verilog code after preprocessor --\n%s-- END OF DUMP --\n", code_after_preproc.c_str());
-			lexin = new std::istringstream(code_after_preproc);
+				log("-- Verilog code after preprocessor --\n%s-- END OF DUMP --\n", input.code.c_str());
+
+			if (!cache_dir.empty()) {
+				std::string key = stringf("%s\n%s\n", yosys_version_str, input.filename.c_str());
+				for (size_t i = 1; i < argidx; i++) {
+					if ((args[i] == "-j" || args[i] == "-cache") && i+1 < argidx) {
+						i++;
+						continue;
+					}
+					key += args[i] + "\n";
+				}
+				input.cache_filename = cache_dir + "/" + sha1(key + input.code) + ".ast";
+				load_cache_entry(input);
+			}
+		};
+
+		read_input(f, filename);
+
+		// with -j this call reads all remaining files (instead of the next call of execute())
+		while (num_threads > 0 && !next_args.empty()) {
+			std::istream *next_f = NULL;
+			std::string next_filename;
+			extra_args(next_f, next_filename, next_args, argidx);
+			read_input(next_f, next_filename);
+			delete next_f;
 		}
 
-		frontend_verilog_yyset_lineno(1);
-		frontend_verilog_yyrestart(NULL);
-		frontend_verilog_yyparse();
-		frontend_verilog_yylex_destroy();
+		std::vector<int> parse_jobs;
+		for (int i = 0; i < GetSize(inputs); i++)
+			if (inputs[i].ast == NULL)
+				parse_jobs.push_back(i);
+
+		int num_jobs = GetSize(parse_jobs);
+		std::vector<std::string> job_logs(GetSize(inputs));
+		std::vector<log_thread_error_exception> job_errors(GetSize(inputs));
+		std::vector<char> job_failed(GetSize(inputs));
+
+		if (num_threads > 0 && num_jobs > 0)
+		{
+			// like parallel_for_modules(): the log output and the errors of each job are
+			// collected and reported in the order of the input files
+			auto job = [&](int k) {
+				int i = parse_jobs[k];
+				log_thread_buffer = &job_logs[i];
+				RTLIL::IdString::set_thread_job(k);
+				try {
+					parse_input(inputs[i], initial_nettype_wire);
+				} catch (log_thread_error_exception &e) {
+					job_errors[i] = e;
+					job_failed[i] = true;
+				} catch (...) {
+					log_id_cache_clear();
+					RTLIL::IdString::set_thread_job(-1);
+					log_thread_buffer = nullptr;
+					throw;
+				}
+				log_id_cache_clear();
+				RTLIL::IdString::set_thread_job(-1);
+				log_thread_buffer = nullptr;
+			};
+
+			// the attributes that are created by the parser itself are kept in the id cache, so
+			// that their index does not depend on the job that creates them first
+			static std::vector<RTLIL::IdString> parser_ids = { "\\full_case", "\\parallel_case" };
+
+			log_id_cache_clear();
+			RTLIL::IdString::begin_threaded(num_jobs);
+
+			try {
+				parallel_for(num_jobs, num_threads, job);
+			} catch (...) {
+				RTLIL::IdString::end_threaded();
+				for (auto &input : inputs)
+					delete input.ast;
+				throw;
+			}
 
-		for (auto &child : current_ast->children) {
-			if (child->type == AST::AST_MODULE)
-				for (auto &attr : attributes)
-					if (child->attributes.count(attr) == 0)
-						child->attributes[attr] = AST::AstNode::mkconst_int(1, false);
+			RTLIL::IdString::end_threaded();
+		}
+		else
+		{
+			for (int i : parse_jobs)
+				parse_input(inputs[i], initial_nettype_wire);
 		}
 
-		if (flag_nodpi)
-			error_on_dpi_function(current_ast);
+		for (int i = 0; i < GetSize(inputs); i++)
+		{
+			VerilogInput &input = inputs[i];
 
-		AST::process(design, current_ast, flag_dump_ast1, flag_dump_ast2, flag_dump_vlog, flag_dump_rtlil, flag_nolatches, flag_nomeminit, flag_nomem2reg, flag_mem2reg, lib_mode, flag_noopt, flag_icells, flag_ignore_redef, flag_defer, default_nettype_wire);
+			log("%s", job_logs[i].c_str());
+			if (job_failed[i]) {
+				for (auto &it : inputs)
+					delete it.ast;
+				if (job_errors[i].cmd_error)
+					log_cmd_error("%s", job_errors[i].message.c_str());
+				log_error("%s", job_errors[i].message.c_str());
+			}
 
-		if (!flag_nopp)
-			delete lexin;
+			// hash indices in the order of the input files, independent of the thread schedule
+			if (num_threads > 0)
+				AST::renumber_hashidx(input.ast);
 
-		delete current_ast;
-		current_ast = NULL;
+			if (!input.cache_filename.empty() && !input.cached)
+				store_cache_entry(cache_dir, input);
+
+			for (auto &child : input.ast->children) {
+				if (child->type == AST::AST_MODULE)
+					for (auto &attr : attributes)
+						if (child->attributes.count(attr) == 0)
+							child->attributes[attr] = AST::AstNode::mkconst_int(1, false);
+			}
+
+			if (flag_nodpi)
+				error_on_dpi_function(input.ast);
+
+			AST::current_filename = input.filename;
+			default_nettype_wire = input.nettype_wire;
+			frontend_verilog_yyset_lineno(input.lineno);
+
+			AST::process(design, input.ast, flag_dump_ast1, flag_dump_ast2, flag_dump_vlog, flag_dump_rtlil, flag_nolatches, flag_nomeminit, flag_nomem2reg, flag_mem2reg, lib_mode, flag_noopt, flag_icells, flag_ignore_redef, flag_defer, default_nettype_wire);
+
+			delete input.ast;
+			input.ast = NULL;
+		}
 
 		log("Successfully finished Verilog frontend.\n");
 	}
@@ -40,13 +40,14 @@ YOSYS_NAMESPACE_BEGIN
 namespace VERILOG_FRONTEND
 {
 	// this variable is set to a new AST_DESIGN node and then filled with the AST by the bison parser
-	extern struct AST::AstNode *current_ast;
+	// (like all state of the lexer and parser it is local to the thread that runs the parser)
+	extern thread_local struct AST::AstNode *current_ast;
 
 	// this function converts a Verilog constant to an AST_CONSTANT node
 	AST::AstNode *const2ast(std::string code, char case_type = 0, bool warn_z = false);
 
 	// state of `default_nettype
-	extern bool default_nettype_wire;
+	extern thread_local bool default_nettype_wire;
 
 	// running in SystemVerilog mode
 	extern bool sv_mode;
@@ -64,18 +65,22 @@ namespace VERILOG_FRONTEND
 	extern bool lib_mode;
 
 	// lexer input stream
-	extern std::istream *lexin;
+	extern thread_local std::istream *lexin;
 }
 
 // the pre-processor
 std::string frontend_verilog_preproc(std::istream &f, std::string filename, const std::map<std::string, std::string> &pre_defines_map,
 		dict<std::string, std::pair<std::string, bool>> &global_defines_cache, const std::list<std::string> &include_dirs);
 
+// the options registered with the verilog_defaults command
+const std::vector<std::string> &frontend_verilog_defaults();
+
 YOSYS_NAMESPACE_END
 
-// the usual bison/flex stuff
+// the usual bison/flex stuff (for the reentrant scanner of the calling thread)
+union YYSTYPE;
 extern int frontend_verilog_yydebug;
-int frontend_verilog_yylex(void);
+int frontend_verilog_yylex(YYSTYPE *lval);
 void frontend_verilog_yyerror(char const *fmt, ...);
 void frontend_verilog_yyrestart(FILE *f);
 int frontend_verilog_yyparse(void);
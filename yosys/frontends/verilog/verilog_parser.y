@@ -45,22 +45,23 @@ using namespace VERILOG_FRONTEND;
 
 YOSYS_NAMESPACE_BEGIN
 namespace VERILOG_FRONTEND {
-	int port_counter;
-	std::map<std::string, int> port_stubs;
-	std::map<std::string, AstNode*> attr_list, default_attr_list;
-	std::map<std::string, AstNode*> *albuf;
-	std::vector<AstNode*> ast_stack;
-	struct AstNode *astbuf1, *astbuf2, *astbuf3;
-	struct AstNode *current_function_or_task;
-	struct AstNode *current_ast, *current_ast_mod;
-	int current_function_or_task_port_id;
-	std::vector<char> case_type_stack;
-	bool do_not_require_port_stubs;
-	bool default_nettype_wire;
+	// the parser state is thread local, so that multiple files can be parsed in parallel
+	thread_local int port_counter;
+	thread_local std::map<std::string, int> port_stubs;
+	thread_local std::map<std::string, AstNode*> attr_list, default_attr_list;
+	thread_local std::map<std::string, AstNode*> *albuf;
+	thread_local std::vector<AstNode*> ast_stack;
+	thread_local struct AstNode *astbuf1, *astbuf2, *astbuf3;
+	thread_local struct AstNode *current_function_or_task;
+	thread_local struct AstNode *current_ast, *current_ast_mod;
+	thread_local int current_function_or_task_port_id;
+	thread_local std::vector<char> case_type_stack;
+	thread_local bool do_not_require_port_stubs;
+	thread_local bool default_nettype_wire;
 	bool sv_mode, formal_mode, lib_mode;
 	bool norestrict_mode, assume_asserts_mode;
-	bool current_wire_rand, current_wire_const;
-	std::istream *lexin;
+	thread_local bool current_wire_rand, current_wire_const;
+	thread_local std::istream *lexin;
 }
 YOSYS_NAMESPACE_END
 
@@ -93,6 +94,7 @@ static void free_attr(std::map<std::string, AstNode*> *al)
 %}
 
 %name-prefix "frontend_verilog_yy"
+%define api.pure
 
 %union {
 	std::string *string;
@@ -0,0 +1,546 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Clifford Wolf <clifford@clifford.at>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef BITSIM_H
+#define BITSIM_H
+
+#include "kernel/yosys.h"
+#include "kernel/sigtools.h"
+#include "kernel/celltypes.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+// Bit-parallel random simulation of combinational cells. Each signal bit holds
+// 64 patterns per word, as a value plane and an undef plane. The SAT based
+// passes use it to answer satisfiable queries without calling the solver: a
+// pattern for which all relevant signals are defined is a model of the
+// corresponding SAT problem. Cells are modelled like in SatGen, coarse cells
+// without a word-level implementation are evaluated pattern by pattern using
+// CellTypes::eval() (like ConstEval does). Everything else (and any pattern
+// the model is not sure about) is undef.
+
+struct BitSim
+{
+	enum op_t {
+		OP_NONE, OP_EVAL,
+		OP_BUF, OP_NOT, OP_AND, OP_NAND, OP_OR, OP_NOR, OP_XOR, OP_XNOR, OP_ANDNOT, OP_ORNOT,
+		OP_MUX, OP_AOI3, OP_OAI3, OP_AOI4, OP_OAI4, OP_PMUX,
+		OP_REDUCE_AND, OP_REDUCE_OR, OP_REDUCE_XOR, OP_REDUCE_XNOR, OP_LOGIC_NOT, OP_LOGIC_AND, OP_LOGIC_OR,
+		OP_EQ, OP_NE, OP_ADD, OP_SUB
+	};
+
+	struct SimCell {
+		RTLIL::Cell *cell;
+		op_t op;
+		std::vector<int> a, b, c, d, s, y;
+	};
+
+	SigMap *sigmap;
+	int num_words;
+	uint64_t rng_state;
+	bool dirty;
+
+	dict<RTLIL::SigBit, int> signals;
+	pool<RTLIL::Cell*> cells_pool;
+	std::vector<SimCell> cells;
+	std::vector<int> inputs;
+	std::vector<uint64_t> values, undefs;
+
+	BitSim(SigMap *sigmap = nullptr, int num_words = 4) : sigmap(sigmap), num_words(num_words), rng_state(123456789), dirty(true) { }
+
+	// signals 0, 1 and 2 are the constants 0, 1 and x
+	int signal(RTLIL::SigBit bit)
+	{
+		if (sigmap != nullptr)
+			bit = (*sigmap)(bit);
+		if (bit.wire == nullptr)
+			return bit == RTLIL::State::S0 ? 0 : bit == RTLIL::State::S1 ? 1 : 2;
+		auto it = signals.find(bit);
+		if (it != signals.end())
+			return it->second;
+		int idx = GetSize(signals) + 3;
+		signals[bit] = idx;
+		dirty = true;
+		return idx;
+	}
+
+	std::vector<int> signal(const RTLIL::SigSpec &sig)
+	{
+		std::vector<int> vec;
+		vec.reserve(GetSize(sig));
+		for (auto bit : sig)
+			vec.push_back(signal(bit));
+		return vec;
+	}
+
+	int lookup(RTLIL::SigBit bit) const
+	{
+		if (sigmap != nullptr)
+			bit = (*sigmap)(bit);
+		if (bit.wire == nullptr)
+			return bit == RTLIL::State::S0 ? 0 : bit == RTLIL::State::S1 ? 1 : 2;
+		auto it = signals.find(bit);
+		return it != signals.end() ? it->second : -1;
+	}
+
+	bool known(RTLIL::SigBit bit) const
+	{
+		return lookup(bit) >= 0;
+	}
+
+	static op_t cell_op(RTLIL::IdString type)
+	{
+		static const dict<RTLIL::IdString, op_t> ops = []() {
+			dict<RTLIL::IdString, op_t> ops;
+			ops["$_BUF_"] = OP_BUF, ops["$_NOT_"] = OP_NOT;
+			ops["$_AND_"] = OP_AND, ops["$_NAND_"] = OP_NAND, ops["$_OR_"] = OP_OR, ops["$_NOR_"] = OP_NOR;
+			ops["$_XOR_"] = OP_XOR, ops["$_XNOR_"] = OP_XNOR, ops["$_ANDNOT_"] = OP_ANDNOT, ops["$_ORNOT_"] = OP_ORNOT;
+			ops["$_MUX_"] = OP_MUX, ops["$_AOI3_"] = OP_AOI3, ops["$_OAI3_"] = OP_OAI3, ops["$_AOI4_"] = OP_AOI4, ops["$_OAI4_"] = OP_OAI4;
+			ops["$pos"] = OP_BUF, ops["$equiv"] = OP_BUF, ops["$not"] = OP_NOT;
+			ops["$and"] = OP_AND, ops["$or"] = OP_OR, ops["$xor"] = OP_XOR, ops["$xnor"] = OP_XNOR;
+			ops["$mux"] = OP_MUX, ops["$pmux"] = OP_PMUX;
+			ops["$reduce_and"] = OP_REDUCE_AND, ops["$reduce_or"] = OP_REDUCE_OR, ops["$reduce_bool"] = OP_REDUCE_OR;
+			ops["$reduce_xor"] = OP_REDUCE_XOR, ops["$reduce_xnor"] = OP_REDUCE_XNOR;
+			ops["$logic_not"] = OP_LOGIC_NOT, ops["$logic_and"] = OP_LOGIC_AND, ops["$logic_or"] = OP_LOGIC_OR;
+			ops["$eq"] = OP_EQ, ops["$eqx"] = OP_EQ, ops["$ne"] = OP_NE, ops["$nex"] = OP_NE;
+			ops["$add"] = OP_ADD, ops["$sub"] = OP_SUB;
+			for (auto type : {"$neg", "$shl", "$shr", "$sshl", "$sshr", "$shift", "$shiftx", "$lt", "$le", "$ge", "$gt",
+					"$mul", "$div", "$mod", "$slice", "$concat", "$lut", "$sop"})
+				ops[type] = OP_EVAL;
+			return ops;
+		}();
+		auto it = ops.find(type);
+		return it != ops.end() ? it->second : OP_NONE;
+	}
+
+	// add a cell to the simulated network. the outputs of cells that can't
+	// be simulated are undef, bits that are not driven by a cell are inputs.
+	void add_cell(RTLIL::Cell *cell)
+	{
+		if (cells_pool.count(cell))
+			return;
+		cells_pool.insert(cell);
+
+		SimCell sc;
+		sc.cell = cell;
+		sc.op = cell_op(cell->type);
+
+		bool signed_a = cell->parameters.count("\\A_SIGNED") && cell->getParam("\\A_SIGNED").as_bool();
+		bool signed_b = cell->parameters.count("\\B_SIGNED") && cell->getParam("\\B_SIGNED").as_bool();
+
+		if (sc.op == OP_NONE || !cell->hasPort("\\Y") || (sc.op == OP_EVAL && cell->parameters.count("\\B_SIGNED") && signed_a != signed_b)) {
+			sc.op = OP_NONE;
+			for (auto &conn : cell->connections())
+				if (yosys_celltypes.cell_output(cell->type, conn.first))
+					for (auto bit : conn.second)
+						sc.y.push_back(signal(bit));
+			for (auto &conn : cell->connections())
+				if (!yosys_celltypes.cell_output(cell->type, conn.first))
+					signal(conn.second);
+			cells.push_back(sc);
+			dirty = true;
+			return;
+		}
+
+		if (cell->hasPort("\\A"))
+			sc.a = signal(cell->getPort("\\A"));
+		if (cell->hasPort("\\B"))
+			sc.b = signal(cell->getPort("\\B"));
+		if (cell->hasPort("\\C"))
+			sc.c = signal(cell->getPort("\\C"));
+		if (cell->hasPort("\\D"))
+			sc.d = signal(cell->getPort("\\D"));
+		if (cell->hasPort("\\S"))
+			sc.s = signal(cell->getPort("\\S"));
+		sc.y = signal(cell->getPort("\\Y"));
+
+		if (cell->type[1] != '_' && sc.op != OP_EVAL)
+		{
+			// extend the operands like SatGen does
+			auto extend = [](std::vector<int> &vec, int width, bool is_signed) {
+				while (GetSize(vec) < width)
+					vec.push_back(is_signed && !vec.empty() ? vec.back() : 0);
+			};
+
+			if (sc.op == OP_BUF || sc.op == OP_NOT) {
+				extend(sc.a, GetSize(sc.y), signed_a);
+			} else if (sc.op == OP_AND || sc.op == OP_OR || sc.op == OP_XOR || sc.op == OP_XNOR || sc.op == OP_ADD || sc.op == OP_SUB) {
+				int width = max(GetSize(sc.y), max(GetSize(sc.a), GetSize(sc.b)));
+				extend(sc.a, width, signed_a && signed_b);
+				extend(sc.b, width, signed_a && signed_b);
+			} else if (sc.op == OP_EQ || sc.op == OP_NE) {
+				int width = max(GetSize(sc.a), GetSize(sc.b));
+				extend(sc.a, width, signed_a && signed_b);
+				extend(sc.b, width, signed_a && signed_b);
+			}
+		}
+
+		cells.push_back(sc);
+		dirty = true;
+	}
+
+	void add_signal(const RTLIL::SigSpec &sig)
+	{
+		signal(sig);
+	}
+
+	// sort the cells topologically and find the inputs. called automatically
+	// by simulate() if cells or signals have been added since the last call.
+	void setup()
+	{
+		int num_signals = GetSize(signals) + 3;
+		std::vector<int> driver(num_signals, -1);
+
+		for (int i = 0; i < GetSize(cells); i++)
+			for (int sig : cells[i].y)
+				if (sig > 2)
+					driver[sig] = i;
+
+		std::vector<SimCell> sorted;
+		std::vector<int> state(GetSize(cells), 0);
+		std::vector<std::pair<int, int>> stack;
+
+		for (int root = 0; root < GetSize(cells); root++)
+		{
+			if (state[root] != 0)
+				continue;
+
+			stack.push_back(std::pair<int, int>(root, 0));
+			state[root] = 1;
+
+			while (!stack.empty())
+			{
+				SimCell &sc = cells[stack.back().first];
+				int &pos = stack.back().second;
+				int n_a = GetSize(sc.a), n_b = GetSize(sc.b), n_c = GetSize(sc.c), n_d = GetSize(sc.d);
+
+				if (sc.op != OP_NONE && pos < n_a + n_b + n_c + n_d + GetSize(sc.s)) {
+					int k = pos++;
+					int sig = k < n_a ? sc.a[k] : (k -= n_a) < n_b ? sc.b[k] : (k -= n_b) < n_c ? sc.c[k] :
+							(k -= n_c) < n_d ? sc.d[k] : sc.s[k - n_d];
+					int drv = sig > 2 ? driver[sig] : -1;
+					// on logic loops the cell is evaluated before its driver, which
+					// leaves the input undef unless it has been written before
+					if (drv >= 0 && state[drv] == 0) {
+						state[drv] = 1;
+						stack.push_back(std::pair<int, int>(drv, 0));
+					}
+					continue;
+				}
+
+				state[stack.back().first] = 2;
+				sorted.push_back(sc);
+				stack.pop_back();
+			}
+		}
+
+		cells.swap(sorted);
+
+		inputs.clear();
+		for (int sig = 3; sig < num_signals; sig++)
+			if (driver[sig] < 0)
+				inputs.push_back(sig);
+
+		values.resize(num_signals * num_words);
+		undefs.resize(num_signals * num_words, ~uint64_t(0));
+
+		for (int w = 0; w < num_words; w++) {
+			values[0*num_words + w] = 0, undefs[0*num_words + w] = 0;
+			values[1*num_words + w] = ~uint64_t(0), undefs[1*num_words + w] = 0;
+			values[2*num_words + w] = 0, undefs[2*num_words + w] = ~uint64_t(0);
+		}
+
+		dirty = false;
+	}
+
+	uint64_t random_word()
+	{
+		rng_state ^= rng_state << 13;
+		rng_state ^= rng_state >> 7;
+		rng_state ^= rng_state << 17;
+		return rng_state;
+	}
+
+	// assign random (defined) values to all inputs
+	void randomize(int word = -1)
+	{
+		if (dirty)
+			setup();
+		for (int sig : inputs)
+			for (int w = 0; w < num_words; w++)
+				if (word < 0 || w == word) {
+					values[sig*num_words + w] = random_word();
+					undefs[sig*num_words + w] = 0;
+				}
+	}
+
+	void set(RTLIL::SigBit bit, int word, uint64_t value, uint64_t undef = 0)
+	{
+		int sig = signal(bit);
+		if (dirty)
+			setup();
+		if (sig > 2) {
+			values[sig*num_words + word] = value;
+			undefs[sig*num_words + word] = undef;
+		}
+	}
+
+	void set_lane(RTLIL::SigBit bit, int lane, bool value)
+	{
+		int sig = signal(bit);
+		if (dirty)
+			setup();
+		if (sig > 2) {
+			uint64_t mask = uint64_t(1) << (lane % 64);
+			uint64_t &v = values[sig*num_words + lane / 64];
+			v = value ? v | mask : v & ~mask;
+			undefs[sig*num_words + lane / 64] &= ~mask;
+		}
+	}
+
+	uint64_t get(RTLIL::SigBit bit, int word) const
+	{
+		int sig = lookup(bit);
+		return sig < 0 || sig*num_words >= GetSize(values) ? 0 : values[sig*num_words + word];
+	}
+
+	uint64_t get_undef(RTLIL::SigBit bit, int word) const
+	{
+		int sig = lookup(bit);
+		return sig < 0 || sig*num_words >= GetSize(undefs) ? ~uint64_t(0) : undefs[sig*num_words + word];
+	}
+
+	// returns a mask of the patterns in which the bit is defined and has the given value
+	uint64_t get_mask(RTLIL::SigBit bit, int word, bool value) const
+	{
+		uint64_t v = get(bit, word);
+		return (value ? v : ~v) & ~get_undef(bit, word);
+	}
+
+	bool fully_defined(RTLIL::SigBit bit) const
+	{
+		for (int w = 0; w < num_words; w++)
+			if (get_undef(bit, w) != 0)
+				return false;
+		return true;
+	}
+
+	void simulate(int word = -1)
+	{
+		if (dirty)
+			setup();
+		for (auto &sc : cells)
+			for (int w = 0; w < num_words; w++)
+				if (word < 0 || w == word)
+					eval(sc, w);
+	}
+
+	void eval(const SimCell &sc, int w)
+	{
+		const int nw = num_words;
+		auto V = [&](int sig) -> uint64_t& { return values[sig*nw + w]; };
+		auto U = [&](int sig) -> uint64_t& { return undefs[sig*nw + w]; };
+
+		auto set_y = [&](int i, uint64_t value, uint64_t undef) {
+			if (i < GetSize(sc.y) && sc.y[i] > 2)
+				V(sc.y[i]) = value, U(sc.y[i]) = undef;
+		};
+
+		auto set_y_bool = [&](uint64_t value, uint64_t undef) {
+			set_y(0, value, undef);
+			for (int i = 1; i < GetSize(sc.y); i++)
+				set_y(i, 0, 0);
+		};
+
+		auto undef_any = [&](const std::vector<int> &vec) {
+			uint64_t undef = 0;
+			for (int sig : vec)
+				undef |= U(sig);
+			return undef;
+		};
+
+		switch (sc.op)
+		{
+		case OP_NONE:
+			for (int i = 0; i < GetSize(sc.y); i++)
+				set_y(i, 0, ~uint64_t(0));
+			break;
+
+		case OP_BUF:
+		case OP_NOT:
+			for (int i = 0; i < GetSize(sc.y); i++)
+				set_y(i, sc.op == OP_NOT ? ~V(sc.a[i]) : V(sc.a[i]), U(sc.a[i]));
+			break;
+
+		case OP_AND:
+		case OP_NAND:
+		case OP_OR:
+		case OP_NOR:
+		case OP_XOR:
+		case OP_XNOR:
+		case OP_ANDNOT:
+		case OP_ORNOT:
+			for (int i = 0; i < GetSize(sc.y); i++) {
+				uint64_t a = V(sc.a[i]), b = V(sc.b[i]), y = 0;
+				switch (sc.op) {
+					case OP_AND: y = a & b; break;
+					case OP_NAND: y = ~(a & b); break;
+					case OP_OR: y = a | b; break;
+					case OP_NOR: y = ~(a | b); break;
+					case OP_XOR: y = a ^ b; break;
+					case OP_XNOR: y = ~(a ^ b); break;
+					case OP_ANDNOT: y = a & ~b; break;
+					case OP_ORNOT: y = a | ~b; break;
+					default: log_abort();
+				}
+				set_y(i, y, U(sc.a[i]) | U(sc.b[i]));
+			}
+			break;
+
+		case OP_MUX:
+			for (int i = 0; i < GetSize(sc.y); i++) {
+				uint64_t s = V(sc.s[0]);
+				set_y(i, (V(sc.a[i]) & ~s) | (V(sc.b[i]) & s), U(sc.s[0]) | (U(sc.a[i]) & ~s) | (U(sc.b[i]) & s));
+			}
+			break;
+
+		case OP_AOI3:
+		case OP_OAI3:
+		case OP_AOI4:
+		case OP_OAI4: {
+			uint64_t a = V(sc.a[0]), b = V(sc.b[0]), c = V(sc.c[0]), y = 0;
+			uint64_t undef = U(sc.a[0]) | U(sc.b[0]) | U(sc.c[0]);
+			if (sc.op == OP_AOI3)
+				y = ~((a & b) | c);
+			if (sc.op == OP_OAI3)
+				y = ~((a | b) & c);
+			if (sc.op == OP_AOI4)
+				y = ~((a & b) | (c & V(sc.d[0]))), undef |= U(sc.d[0]);
+			if (sc.op == OP_OAI4)
+				y = ~((a | b) & (c | V(sc.d[0]))), undef |= U(sc.d[0]);
+			set_y(0, y, undef);
+			break;
+		}
+
+		case OP_PMUX: {
+			// the pattern is undef if more than one select bit is set
+			int width = GetSize(sc.y);
+			uint64_t seen = 0, undef = 0;
+			for (int i = 0; i < width; i++)
+				set_y(i, V(sc.a[i]), U(sc.a[i]));
+			for (int k = 0; k < GetSize(sc.s); k++) {
+				uint64_t s = V(sc.s[k]);
+				undef |= U(sc.s[k]) | (seen & s);
+				seen |= s;
+				for (int i = 0; i < width; i++)
+					if (sc.y[i] > 2) {
+						uint64_t &y = V(sc.y[i]), &yu = U(sc.y[i]);
+						y = (y & ~s) | (V(sc.b[k*width + i]) & s);
+						yu = (yu & ~s) | (U(sc.b[k*width + i]) & s);
+					}
+			}
+			for (int i = 0; i < width; i++)
+				if (sc.y[i] > 2)
+					U(sc.y[i]) |= undef;
+			break;
+		}
+
+		case OP_REDUCE_AND:
+		case OP_REDUCE_OR:
+		case OP_REDUCE_XOR:
+		case OP_REDUCE_XNOR:
+		case OP_LOGIC_NOT: {
+			uint64_t y = sc.op == OP_REDUCE_AND ? ~uint64_t(0) : 0;
+			for (int sig : sc.a)
+				y = sc.op == OP_REDUCE_AND ? y & V(sig) : sc.op == OP_REDUCE_XOR || sc.op == OP_REDUCE_XNOR ? y ^ V(sig) : y | V(sig);
+			if (sc.op == OP_REDUCE_XNOR || sc.op == OP_LOGIC_NOT)
+				y = ~y;
+			set_y_bool(y, undef_any(sc.a));
+			break;
+		}
+
+		case OP_LOGIC_AND:
+		case OP_LOGIC_OR: {
+			uint64_t a = 0, b = 0;
+			for (int sig : sc.a)
+				a |= V(sig);
+			for (int sig : sc.b)
+				b |= V(sig);
+			set_y_bool(sc.op == OP_LOGIC_AND ? a & b : a | b, undef_any(sc.a) | undef_any(sc.b));
+			break;
+		}
+
+		case OP_EQ:
+		case OP_NE: {
+			uint64_t diff = 0;
+			for (int i = 0; i < GetSize(sc.a); i++)
+				diff |= V(sc.a[i]) ^ V(sc.b[i]);
+			set_y_bool(sc.op == OP_EQ ? ~diff : diff, undef_any(sc.a) | undef_any(sc.b));
+			break;
+		}
+
+		case OP_ADD:
+		case OP_SUB: {
+			uint64_t carry = sc.op == OP_SUB ? ~uint64_t(0) : 0;
+			uint64_t undef = undef_any(sc.a) | undef_any(sc.b);
+			for (int i = 0; i < GetSize(sc.y); i++) {
+				uint64_t a = V(sc.a[i]), b = sc.op == OP_SUB ? ~V(sc.b[i]) : V(sc.b[i]);
+				set_y(i, a ^ b ^ carry, undef);
+				carry = (a & b) | (carry & (a ^ b));
+			}
+			break;
+		}
+
+		case OP_EVAL: {
+			uint64_t undef = undef_any(sc.a) | undef_any(sc.b) | undef_any(sc.c) | undef_any(sc.d);
+			std::vector<uint64_t> y_values(GetSize(sc.y)), y_undefs(GetSize(sc.y), undef);
+
+			auto lane_const = [&](const std::vector<int> &vec, int lane) {
+				RTLIL::Const value(RTLIL::State::S0, GetSize(vec));
+				for (int i = 0; i < GetSize(vec); i++)
+					if ((V(vec[i]) >> lane) & 1)
+						value.bits[i] = RTLIL::State::S1;
+				return value;
+			};
+
+			for (int lane = 0; lane < 64; lane++) {
+				if ((undef >> lane) & 1)
+					continue;
+				RTLIL::Const result = CellTypes::eval(sc.cell, lane_const(sc.a, lane), lane_const(sc.b, lane),
+						lane_const(sc.c, lane), lane_const(sc.d, lane));
+				for (int i = 0; i < GetSize(sc.y); i++) {
+					RTLIL::State bit = i < GetSize(result) ? result.bits[i] : RTLIL::State::Sx;
+					if (bit == RTLIL::State::S1)
+						y_values[i] |= uint64_t(1) << lane;
+					else if (bit != RTLIL::State::S0)
+						y_undefs[i] |= uint64_t(1) << lane;
+				}
+			}
+
+			for (int i = 0; i < GetSize(sc.y); i++)
+				set_y(i, y_values[i], y_undefs[i]);
+			break;
+		}
+		}
+	}
+};
+
+YOSYS_NAMESPACE_END
+
+#endif
@@ -97,6 +97,51 @@ static RTLIL::Const big2const(const BigInteger &val, int result_len, int undef_b
 	return result;
 }
 
+// Fast paths for fully defined values that fit into a machine word. The value
+// is zero or sign extended to 64 bits. Returns false for values with undef bits
+// and for values that are wider than max_width.
+static bool const2word(const RTLIL::Const &val, bool as_signed, int max_width, uint64_t &word)
+{
+	int width = GetSize(val.bits);
+	if (width > max_width)
+		return false;
+
+	word = 0;
+	for (int i = 0; i < width; i++)
+		if (val.bits[i] == RTLIL::State::S1)
+			word |= uint64_t(1) << i;
+		else if (val.bits[i] != RTLIL::State::S0)
+			return false;
+
+	if (as_signed && width > 0 && width < 64 && val.bits[width-1] == RTLIL::State::S1)
+		word |= ~uint64_t(0) << width;
+	return true;
+}
+
+// with exact set, word is the value as a signed 64 bit integer and the bits
+// above 64 are sign extended. otherwise the result is the value modulo 2^64
+// and result_len must not be larger than 64.
+static RTLIL::Const word2const(uint64_t word, int result_len, bool exact = false)
+{
+	log_assert(exact || result_len <= 64);
+
+	RTLIL::Const result(RTLIL::State::S0, result_len);
+	for (int i = 0; i < result_len; i++)
+		if (i < 64 ? (word >> i) & 1 : int64_t(word) < 0)
+			result.bits[i] = RTLIL::State::S1;
+	return result;
+}
+
+// a shift amount that is small enough for int arithmetic on bit positions
+static bool const2offset(const RTLIL::Const &val, bool as_signed, int64_t &offset)
+{
+	uint64_t word;
+	if (!const2word(val, as_signed, 63, word))
+		return false;
+	offset = int64_t(word);
+	return offset > -(int64_t(1) << 40) && offset < (int64_t(1) << 40);
+}
+
 static RTLIL::State logic_and(RTLIL::State a, RTLIL::State b)
 {
 	if (a == RTLIL::State::S0) return RTLIL::State::S0;
@@ -277,12 +322,29 @@ RTLIL::Const RTLIL::const_logic_or(const RTLIL::Const &arg1, const RTLIL::Const
 
 static RTLIL::Const const_shift_worker(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool sign_ext, int direction, int result_len)
 {
-	int undef_bit_pos = -1;
-	BigInteger offset = const2big(arg2, false, undef_bit_pos) * direction;
-
 	if (result_len < 0)
 		result_len = arg1.bits.size();
 
+	int64_t small_offset;
+	if (const2offset(arg2, false, small_offset))
+	{
+		small_offset *= direction;
+		RTLIL::Const result(RTLIL::State::Sx, result_len);
+		for (int i = 0; i < result_len; i++) {
+			int64_t pos = i + small_offset;
+			if (pos < 0)
+				result.bits[i] = RTLIL::State::S0;
+			else if (pos >= GetSize(arg1.bits))
+				result.bits[i] = sign_ext ? arg1.bits.back() : RTLIL::State::S0;
+			else
+				result.bits[i] = arg1.bits[pos];
+		}
+		return result;
+	}
+
+	int undef_bit_pos = -1;
+	BigInteger offset = const2big(arg2, false, undef_bit_pos) * direction;
+
 	RTLIL::Const result(RTLIL::State::Sx, result_len);
 	if (undef_bit_pos >= 0)
 		return result;
@@ -330,12 +392,26 @@ RTLIL::Const RTLIL::const_sshr(const RTLIL::Const &arg1, const RTLIL::Const &arg
 
 static RTLIL::Const const_shift_shiftx(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool, bool signed2, int result_len, RTLIL::State other_bits)
 {
-	int undef_bit_pos = -1;
-	BigInteger offset = const2big(arg2, signed2, undef_bit_pos);
-
 	if (result_len < 0)
 		result_len = arg1.bits.size();
 
+	int64_t small_offset;
+	if (const2offset(arg2, signed2, small_offset))
+	{
+		RTLIL::Const result(RTLIL::State::Sx, result_len);
+		for (int i = 0; i < result_len; i++) {
+			int64_t pos = i + small_offset;
+			if (pos < 0 || pos >= GetSize(arg1.bits))
+				result.bits[i] = other_bits;
+			else
+				result.bits[i] = arg1.bits[pos];
+		}
+		return result;
+	}
+
+	int undef_bit_pos = -1;
+	BigInteger offset = const2big(arg2, signed2, undef_bit_pos);
+
 	RTLIL::Const result(RTLIL::State::Sx, result_len);
 	if (undef_bit_pos >= 0)
 		return result;
@@ -363,6 +439,14 @@ RTLIL::Const RTLIL::const_shiftx(const RTLIL::Const &arg1, const RTLIL::Const &a
 
 RTLIL::Const RTLIL::const_lt(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool signed1, bool signed2, int result_len)
 {
+	uint64_t a, b;
+	if (const2word(arg1, signed1, signed1 ? 64 : 63, a) && const2word(arg2, signed2, signed2 ? 64 : 63, b)) {
+		RTLIL::Const result(int64_t(a) < int64_t(b) ? RTLIL::State::S1 : RTLIL::State::S0);
+		while (int(result.bits.size()) < result_len)
+			result.bits.push_back(RTLIL::State::S0);
+		return result;
+	}
+
 	int undef_bit_pos = -1;
 	bool y = const2big(arg1, signed1, undef_bit_pos) < const2big(arg2, signed2, undef_bit_pos);
 	RTLIL::Const result(undef_bit_pos >= 0 ? RTLIL::State::Sx : y ? RTLIL::State::S1 : RTLIL::State::S0);
@@ -374,6 +458,14 @@ RTLIL::Const RTLIL::const_lt(const RTLIL::Const &arg1, const RTLIL::Const &arg2,
 
 RTLIL::Const RTLIL::const_le(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool signed1, bool signed2, int result_len)
 {
+	uint64_t a, b;
+	if (const2word(arg1, signed1, signed1 ? 64 : 63, a) && const2word(arg2, signed2, signed2 ? 64 : 63, b)) {
+		RTLIL::Const result(int64_t(a) <= int64_t(b) ? RTLIL::State::S1 : RTLIL::State::S0);
+		while (int(result.bits.size()) < result_len)
+			result.bits.push_back(RTLIL::State::S0);
+		return result;
+	}
+
 	int undef_bit_pos = -1;
 	bool y = const2big(arg1, signed1, undef_bit_pos) <= const2big(arg2, signed2, undef_bit_pos);
 	RTLIL::Const result(undef_bit_pos >= 0 ? RTLIL::State::Sx : y ? RTLIL::State::S1 : RTLIL::State::S0);
@@ -448,6 +540,14 @@ RTLIL::Const RTLIL::const_nex(const RTLIL::Const &arg1, const RTLIL::Const &arg2
 
 RTLIL::Const RTLIL::const_ge(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool signed1, bool signed2, int result_len)
 {
+	uint64_t a, b;
+	if (const2word(arg1, signed1, signed1 ? 64 : 63, a) && const2word(arg2, signed2, signed2 ? 64 : 63, b)) {
+		RTLIL::Const result(int64_t(a) >= int64_t(b) ? RTLIL::State::S1 : RTLIL::State::S0);
+		while (int(result.bits.size()) < result_len)
+			result.bits.push_back(RTLIL::State::S0);
+		return result;
+	}
+
 	int undef_bit_pos = -1;
 	bool y = const2big(arg1, signed1, undef_bit_pos) >= const2big(arg2, signed2, undef_bit_pos);
 	RTLIL::Const result(undef_bit_pos >= 0 ? RTLIL::State::Sx : y ? RTLIL::State::S1 : RTLIL::State::S0);
@@ -459,6 +559,14 @@ RTLIL::Const RTLIL::const_ge(const RTLIL::Const &arg1, const RTLIL::Const &arg2,
 
 RTLIL::Const RTLIL::const_gt(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool signed1, bool signed2, int result_len)
 {
+	uint64_t a, b;
+	if (const2word(arg1, signed1, signed1 ? 64 : 63, a) && const2word(arg2, signed2, signed2 ? 64 : 63, b)) {
+		RTLIL::Const result(int64_t(a) > int64_t(b) ? RTLIL::State::S1 : RTLIL::State::S0);
+		while (int(result.bits.size()) < result_len)
+			result.bits.push_back(RTLIL::State::S0);
+		return result;
+	}
+
 	int undef_bit_pos = -1;
 	bool y = const2big(arg1, signed1, undef_bit_pos) > const2big(arg2, signed2, undef_bit_pos);
 	RTLIL::Const result(undef_bit_pos >= 0 ? RTLIL::State::Sx : y ? RTLIL::State::S1 : RTLIL::State::S0);
@@ -470,6 +578,11 @@ RTLIL::Const RTLIL::const_gt(const RTLIL::Const &arg1, const RTLIL::Const &arg2,
 
 RTLIL::Const RTLIL::const_add(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool signed1, bool signed2, int result_len)
 {
+	int width = result_len >= 0 ? result_len : max(arg1.bits.size(), arg2.bits.size());
+	uint64_t a, b;
+	if (width <= 64 && const2word(arg1, signed1, 64, a) && const2word(arg2, signed2, 64, b))
+		return word2const(a + b, width);
+
 	int undef_bit_pos = -1;
 	BigInteger y = const2big(arg1, signed1, undef_bit_pos) + const2big(arg2, signed2, undef_bit_pos);
 	return big2const(y, result_len >= 0 ? result_len : max(arg1.bits.size(), arg2.bits.size()), undef_bit_pos);
@@ -477,6 +590,11 @@ RTLIL::Const RTLIL::const_add(const RTLIL::Const &arg1, const RTLIL::Const &arg2
 
 RTLIL::Const RTLIL::const_sub(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool signed1, bool signed2, int result_len)
 {
+	int width = result_len >= 0 ? result_len : max(arg1.bits.size(), arg2.bits.size());
+	uint64_t a, b;
+	if (width <= 64 && const2word(arg1, signed1, 64, a) && const2word(arg2, signed2, 64, b))
+		return word2const(a - b, width);
+
 	int undef_bit_pos = -1;
 	BigInteger y = const2big(arg1, signed1, undef_bit_pos) - const2big(arg2, signed2, undef_bit_pos);
 	return big2const(y, result_len >= 0 ? result_len : max(arg1.bits.size(), arg2.bits.size()), undef_bit_pos);
@@ -484,6 +602,11 @@ RTLIL::Const RTLIL::const_sub(const RTLIL::Const &arg1, const RTLIL::Const &arg2
 
 RTLIL::Const RTLIL::const_mul(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool signed1, bool signed2, int result_len)
 {
+	int width = result_len >= 0 ? result_len : max(arg1.bits.size(), arg2.bits.size());
+	uint64_t a, b;
+	if (width <= 64 && const2word(arg1, signed1, 64, a) && const2word(arg2, signed2, 64, b))
+		return word2const(a * b, width);
+
 	int undef_bit_pos = -1;
 	BigInteger y = const2big(arg1, signed1, undef_bit_pos) * const2big(arg2, signed2, undef_bit_pos);
 	return big2const(y, result_len >= 0 ? result_len : max(arg1.bits.size(), arg2.bits.size()), min(undef_bit_pos, 0));
@@ -491,6 +614,11 @@ RTLIL::Const RTLIL::const_mul(const RTLIL::Const &arg1, const RTLIL::Const &arg2
 
 RTLIL::Const RTLIL::const_div(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool signed1, bool signed2, int result_len)
 {
+	// the operands are smaller than 2^63 in magnitude, so there is no overflow
+	uint64_t word_a, word_b;
+	if (const2word(arg1, signed1, 63, word_a) && const2word(arg2, signed2, 63, word_b) && word_b != 0)
+		return word2const(int64_t(word_a) / int64_t(word_b), result_len >= 0 ? result_len : max(arg1.bits.size(), arg2.bits.size()), true);
+
 	int undef_bit_pos = -1;
 	BigInteger a = const2big(arg1, signed1, undef_bit_pos);
 	BigInteger b = const2big(arg2, signed2, undef_bit_pos);
@@ -504,6 +632,11 @@ RTLIL::Const RTLIL::const_div(const RTLIL::Const &arg1, const RTLIL::Const &arg2
 
 RTLIL::Const RTLIL::const_mod(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool signed1, bool signed2, int result_len)
 {
+	// the operands are smaller than 2^63 in magnitude, so there is no overflow
+	uint64_t word_a, word_b;
+	if (const2word(arg1, signed1, 63, word_a) && const2word(arg2, signed2, 63, word_b) && word_b != 0)
+		return word2const(int64_t(word_a) % int64_t(word_b), result_len >= 0 ? result_len : max(arg1.bits.size(), arg2.bits.size()), true);
+
 	int undef_bit_pos = -1;
 	BigInteger a = const2big(arg1, signed1, undef_bit_pos);
 	BigInteger b = const2big(arg2, signed2, undef_bit_pos);
@@ -517,6 +650,20 @@ RTLIL::Const RTLIL::const_mod(const RTLIL::Const &arg1, const RTLIL::Const &arg2
 
 RTLIL::Const RTLIL::const_pow(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool signed1, bool signed2, int result_len)
 {
+	uint64_t word_a, word_b;
+	if (result_len >= 0 && result_len <= 64 && const2word(arg1, signed1, 64, word_a) && const2word(arg2, signed2, 63, word_b) && int64_t(word_b) >= 0)
+	{
+		// modulo 2^64, like the power-modulus algorithm below
+		uint64_t word_y = 1;
+		while (word_b > 0) {
+			if (word_b % 2 == 1)
+				word_y *= word_a;
+			word_b = word_b / 2;
+			word_a *= word_a;
+		}
+		return word2const(word_y, result_len);
+	}
+
 	int undef_bit_pos = -1;
 
 	BigInteger a = const2big(arg1, signed1, undef_bit_pos);
@@ -446,6 +446,10 @@ struct CellTypes
 // initialized by yosys_setup()
 extern CellTypes yosys_celltypes;
 
+// the ports of all design modules, only set while parallel_for_modules() is
+// running (other modules may not be accessed from a worker thread)
+extern CellTypes *yosys_celltypes_design;
+
 YOSYS_NAMESPACE_END
 
 #endif
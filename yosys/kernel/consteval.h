@@ -27,15 +27,92 @@
 
 YOSYS_NAMESPACE_BEGIN
 
+// the values found by ConstEval. all bits are mapped by ConstEval::assign_map.
+// like the assignments in a SAT solver, each value has a level: the number of
+// push() checkpoints it depends on. pop() only undoes the values on the trail
+// of the innermost level, values that only depend on the outer levels (e.g.
+// the parts of the circuit not driven by the signals set after the push())
+// are kept and don't need to be evaluated again.
+struct ConstEvalValues
+{
+	dict<RTLIL::SigBit, std::pair<RTLIL::State, int>> values;
+	std::vector<std::vector<RTLIL::SigBit>> trails;
+
+	void clear()
+	{
+		values.clear();
+		trails.clear();
+	}
+
+	int depth() const
+	{
+		return GetSize(trails);
+	}
+
+	int level(const RTLIL::SigBit &bit) const
+	{
+		if (bit.wire == NULL)
+			return 0;
+		auto it = values.find(bit);
+		return it != values.end() ? it->second.second : 0;
+	}
+
+	void add(const RTLIL::SigBit &bit, RTLIL::State value, int level)
+	{
+		log_assert(level <= depth());
+		if (values.count(bit) == 0) {
+			values[bit] = std::pair<RTLIL::State, int>(value, level);
+			if (level > 0)
+				trails[level-1].push_back(bit);
+		}
+	}
+
+	void apply(RTLIL::SigBit &bit) const
+	{
+		if (bit.wire != NULL) {
+			auto it = values.find(bit);
+			if (it != values.end())
+				bit = it->second.first;
+		}
+	}
+
+	void apply(RTLIL::SigSpec &sig) const
+	{
+		if (values.empty() || sig.is_fully_const())
+			return;
+		std::vector<RTLIL::SigBit> bits = sig.bits();
+		for (auto &bit : bits)
+			apply(bit);
+		sig = bits;
+	}
+
+	RTLIL::SigSpec operator()(RTLIL::SigSpec sig) const
+	{
+		apply(sig);
+		return sig;
+	}
+
+	void push()
+	{
+		trails.push_back(std::vector<RTLIL::SigBit>());
+	}
+
+	void pop()
+	{
+		for (auto &bit : trails.back())
+			values.erase(bit);
+		trails.pop_back();
+	}
+};
+
 struct ConstEval
 {
 	RTLIL::Module *module;
 	SigMap assign_map;
-	SigMap values_map;
+	ConstEvalValues values_map;
 	SigPool stop_signals;
-	SigSet<RTLIL::Cell*> sig2driver;
-	std::set<RTLIL::Cell*> busy;
-	std::vector<SigMap> stack;
+	dict<RTLIL::SigBit, RTLIL::Cell*> sig2driver;
+	pool<RTLIL::Cell*> busy;
 
 	ConstEval(RTLIL::Module *module) : module(module), assign_map(module)
 	{
@@ -48,7 +125,9 @@ struct ConstEval
 				continue;
 			for (auto &it2 : it.second->connections())
 				if (ct.cell_output(it.second->type, it2.first))
-					sig2driver.insert(assign_map(it2.second), it.second);
+					for (auto bit : assign_map(it2.second))
+						if (bit.wire != NULL && sig2driver.count(bit) == 0)
+							sig2driver[bit] = it.second;
 		}
 	}
 
@@ -58,26 +137,35 @@ struct ConstEval
 		stop_signals.clear();
 	}
 
+	// push() is O(1), pop() only undoes the values that depend on what has
+	// been set since the matching push()
 	void push()
 	{
-		stack.push_back(values_map);
+		values_map.push();
 	}
 
 	void pop()
 	{
-		values_map.swap(stack.back());
-		stack.pop_back();
+		values_map.pop();
 	}
 
-	void set(RTLIL::SigSpec sig, RTLIL::Const value)
+	void set(RTLIL::SigSpec sig, RTLIL::Const value, int level = -1)
 	{
+		if (level < 0)
+			level = values_map.depth();
 		assign_map.apply(sig);
+		log_assert(GetSize(sig) == GetSize(value));
+		for (int i = 0; i < GetSize(sig); i++) {
+			RTLIL::SigBit bit = sig[i];
+			if (bit.wire == NULL)
+				continue;
 #ifndef NDEBUG
-		RTLIL::SigSpec current_val = values_map(sig);
-		for (int i = 0; i < GetSize(current_val); i++)
-			log_assert(current_val[i].wire != NULL || current_val[i] == value.bits[i]);
+			RTLIL::SigBit current_val = bit;
+			values_map.apply(current_val);
+			log_assert(current_val.wire != NULL || current_val == value.bits[i]);
 #endif
-		values_map.add(sig, RTLIL::SigSpec(value));
+			values_map.add(bit, value.bits[i], level);
+		}
 	}
 
 	void stop(RTLIL::SigSpec sig)
@@ -86,6 +174,19 @@ struct ConstEval
 		stop_signals.add(sig);
 	}
 
+	// the level of a value computed by the cell (with all inputs evaluated)
+	int input_level(RTLIL::Cell *cell)
+	{
+		int level = 0;
+		for (auto &conn : cell->connections()) {
+			if (cell->output(conn.first))
+				continue;
+			for (auto bit : assign_map(conn.second))
+				level = max(level, values_map.level(bit));
+		}
+		return level;
+	}
+
 	bool eval(RTLIL::Cell *cell, RTLIL::SigSpec &undef)
 	{
 		if (cell->type == "$lcu")
@@ -107,6 +208,8 @@ struct ConstEval
 			if (!eval(sig_ci, undef, cell))
 				return false;
 
+			int level = input_level(cell);
+
 			if (sig_p.is_fully_def() && sig_g.is_fully_def() && sig_ci.is_fully_def())
 			{
 				RTLIL::Const coval(RTLIL::Sx, GetSize(sig_co));
@@ -117,10 +220,10 @@ struct ConstEval
 					coval.bits[i] = carry ? RTLIL::S1 : RTLIL::S0;
 				}
 
-				set(sig_co, coval);
+				set(sig_co, coval, level);
 			}
 			else
-				set(sig_co, RTLIL::Const(RTLIL::Sx, GetSize(sig_co)));
+				set(sig_co, RTLIL::Const(RTLIL::Sx, GetSize(sig_co)), level);
 
 			return true;
 		}
@@ -177,6 +280,8 @@ struct ConstEval
 				y_values.push_back(yc.as_const());
 			}
 
+			int level = input_level(cell);
+
 			if (y_values.size() > 1)
 			{
 				std::vector<RTLIL::State> master_bits = y_values.at(0).bits;
@@ -189,10 +294,10 @@ struct ConstEval
 							master_bits[j] = RTLIL::State::Sx;
 				}
 
-				set(sig_y, RTLIL::Const(master_bits));
+				set(sig_y, RTLIL::Const(master_bits), level);
 			}
 			else
-				set(sig_y, y_values.front());
+				set(sig_y, y_values.front(), level);
 		}
 		else if (cell->type == "$fa")
 		{
@@ -209,6 +314,7 @@ struct ConstEval
 			if (!eval(sig_c, undef, cell))
 				return false;
 
+			int level = input_level(cell);
 			RTLIL::Const t1 = const_xor(sig_a.as_const(), sig_b.as_const(), false, false, width);
 			RTLIL::Const val_y = const_xor(t1, sig_c.as_const(), false, false, width);
 
@@ -220,8 +326,8 @@ struct ConstEval
 				if (val_y.bits[i] == RTLIL::Sx)
 					val_x.bits[i] = RTLIL::Sx;
 
-			set(sig_y, val_y);
-			set(sig_x, val_x);
+			set(sig_y, val_y, level);
+			set(sig_x, val_x, level);
 		}
 		else if (cell->type == "$alu")
 		{
@@ -246,6 +352,7 @@ struct ConstEval
 			RTLIL::SigSpec sig_x = cell->getPort("\\X");
 			RTLIL::SigSpec sig_co = cell->getPort("\\CO");
 
+			int level = input_level(cell);
 			bool any_input_undef = !(sig_a.is_fully_def() && sig_b.is_fully_def() && sig_ci.is_fully_def() && sig_bi.is_fully_def());
 			sig_a.extend_u0(GetSize(sig_y), signed_a);
 			sig_b.extend_u0(GetSize(sig_y), signed_b);
@@ -258,24 +365,24 @@ struct ConstEval
 				RTLIL::SigSpec x_inputs = { sig_a[i], sig_b[i], sig_bi[0] };
 
 				if (!x_inputs.is_fully_def()) {
-					set(sig_x[i], RTLIL::Sx);
+					set(sig_x[i], RTLIL::Sx, level);
 				} else {
 					bool bit_a = sig_a[i] == RTLIL::S1;
 					bool bit_b = (sig_b[i] == RTLIL::S1) != b_inv;
 					bool bit_x = bit_a != bit_b;
-					set(sig_x[i], bit_x ? RTLIL::S1 : RTLIL::S0);
+					set(sig_x[i], bit_x ? RTLIL::S1 : RTLIL::S0, level);
 				}
 
 				if (any_input_undef) {
-					set(sig_y[i], RTLIL::Sx);
-					set(sig_co[i], RTLIL::Sx);
+					set(sig_y[i], RTLIL::Sx, level);
+					set(sig_co[i], RTLIL::Sx, level);
 				} else {
 					bool bit_a = sig_a[i] == RTLIL::S1;
 					bool bit_b = (sig_b[i] == RTLIL::S1) != b_inv;
 					bool bit_y = (bit_a != bit_b) != carry;
 					carry = (bit_a && bit_b) || (bit_a && carry) || (bit_b && carry);
-					set(sig_y[i], bit_y ? RTLIL::S1 : RTLIL::S0);
-					set(sig_co[i], carry ? RTLIL::S1 : RTLIL::S0);
+					set(sig_y[i], bit_y ? RTLIL::S1 : RTLIL::S0, level);
+					set(sig_co[i], carry ? RTLIL::S1 : RTLIL::S0, level);
 				}
 			}
 		}
@@ -294,11 +401,12 @@ struct ConstEval
 					return false;
 			}
 
+			int level = input_level(cell);
 			RTLIL::Const result(0, GetSize(cell->getPort("\\Y")));
 			if (!macc.eval(result))
 				log_abort();
 
-			set(cell->getPort("\\Y"), result);
+			set(cell->getPort("\\Y"), result, level);
 		}
 		else
 		{
@@ -321,7 +429,7 @@ struct ConstEval
 				return false;
 
 			set(sig_y, CellTypes::eval(cell, sig_a.as_const(), sig_b.as_const(),
-					sig_c.as_const(), sig_d.as_const()));
+					sig_c.as_const(), sig_d.as_const()), input_level(cell));
 		}
 
 		return true;
@@ -348,8 +456,15 @@ struct ConstEval
 			busy.insert(busy_cell);
 		}
 
-		std::set<RTLIL::Cell*> driver_cells;
-		sig2driver.find(sig, driver_cells);
+		std::vector<RTLIL::Cell*> driver_cells;
+		pool<RTLIL::Cell*> driver_cells_pool;
+		for (auto &bit : sig) {
+			if (bit.wire == NULL)
+				continue;
+			auto it = sig2driver.find(bit);
+			if (it != sig2driver.end() && driver_cells_pool.insert(it->second).second)
+				driver_cells.push_back(it->second);
+		}
 		for (auto cell : driver_cells) {
 			if (!eval(cell, undef)) {
 				if (busy_cell)
@@ -133,6 +133,7 @@ int main(int argc, char **argv)
 	bool print_stats = true;
 	bool call_abort = false;
 	bool timing_details = false;
+	std::string profile_prefix;
 	bool mode_v = false;
 	bool mode_q = false;
 
@@ -171,6 +172,11 @@ int main(int argc, char **argv)
 		printf("    -d\n");
 		printf("        print more detailed timing stats at exit\n");
 		printf("\n");
+		printf("    -P <prefix>\n");
+		printf("        profile every command: write wall and cpu time, heap usage, peak RSS\n");
+		printf("        and per-module cell/wire counts to <prefix>.json, and the time per\n");
+		printf("        stack of commands to <prefix>.folded (for flamegraph.pl) at exit\n");
+		printf("\n");
 		printf("    -l logfile\n");
 		printf("        write log messages to the specified file\n");
 		printf("\n");
@@ -245,7 +251,7 @@ int main(int argc, char **argv)
 	}
 
 	int opt;
-	while ((opt = getopt(argc, argv, "MXAQTVSm:f:Hh:b:o:p:l:L:qv:tds:c:W:w:D:")) != -1)
+	while ((opt = getopt(argc, argv, "MXAQTVSm:f:Hh:b:o:p:l:L:qv:tdP:s:c:W:w:D:")) != -1)
 	{
 		switch (opt)
 		{
@@ -319,6 +325,10 @@ int main(int argc, char **argv)
 		case 'd':
 			timing_details = true;
 			break;
+		case 'P':
+			profile_prefix = optarg;
+			PassProfile::enabled = true;
+			break;
 		case 's':
 			scriptfile = optarg;
 			scriptfile_tcl = false;
@@ -410,6 +420,13 @@ int main(int argc, char **argv)
 	if (!backend_command.empty())
 		run_backend(output_filename, backend_command);
 
+	if (!profile_prefix.empty()) {
+		PassProfile::write(profile_prefix);
+		// the records hold IdStrings, which must be gone before yosys_shutdown()
+		PassProfile::records.clear();
+		PassProfile::enabled = false;
+	}
+
 	if (print_stats)
 	{
 		std::string hash = log_hasher->final().substr(0, 10);
@@ -52,11 +52,12 @@ bool log_cmd_error_throw = false;
 bool log_quiet_warnings = false;
 int log_verbose_level;
 string log_last_error;
+thread_local std::string *log_thread_buffer = nullptr;
 
 vector<int> header_count;
-pool<RTLIL::IdString> log_id_cache;
-vector<shared_str> string_buf;
-int string_buf_index = -1;
+thread_local pool<RTLIL::IdString> log_id_cache;
+thread_local vector<shared_str> string_buf;
+thread_local int string_buf_index = -1;
 
 static struct timeval initial_tv = { 0, 0 };
 static bool next_print_log = false;
@@ -94,6 +95,11 @@ void logv(const char *format, va_list ap)
 	if (str.empty())
 		return;
 
+	if (log_thread_buffer != nullptr) {
+		*log_thread_buffer += str;
+		return;
+	}
+
 	size_t nnl_pos = str.find_last_not_of('\n');
 	if (nnl_pos == std::string::npos)
 		log_newline_count += GetSize(str);
@@ -215,19 +221,25 @@ void logv_warning(const char *format, va_list ap)
 	}
 	else
 	{
-		if (log_errfile != NULL && !log_quiet_warnings)
+		bool use_errfile = log_errfile != NULL && !log_quiet_warnings && log_thread_buffer == nullptr;
+
+		if (use_errfile)
 			log_files.push_back(log_errfile);
 
 		log("Warning: %s", message.c_str());
-		log_flush();
+		if (log_thread_buffer == nullptr)
+			log_flush();
 
-		if (log_errfile != NULL && !log_quiet_warnings)
+		if (use_errfile)
 			log_files.pop_back();
 	}
 }
 
 void logv_error(const char *format, va_list ap)
 {
+	if (log_thread_buffer != nullptr)
+		throw log_thread_error_exception{vstringf(format, ap), false};
+
 #ifdef EMSCRIPTEN
 	auto backup_log_files = log_files;
 #endif
@@ -290,6 +302,9 @@ void log_cmd_error(const char *format, ...)
 	va_list ap;
 	va_start(ap, format);
 
+	if (log_thread_buffer != nullptr)
+		throw log_thread_error_exception{vstringf(format, ap), true};
+
 	if (log_cmd_error_throw) {
 		log_last_error = vstringf(format, ap);
 		log("ERROR: %s", log_last_error.c_str());
@@ -423,6 +438,11 @@ void log_reset_stack()
 	log_flush();
 }
 
+void log_id_cache_clear()
+{
+	log_id_cache.clear();
+}
+
 void log_flush()
 {
 	for (auto f : log_files)
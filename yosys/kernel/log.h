@@ -46,6 +46,12 @@ YOSYS_NAMESPACE_BEGIN
 
 struct log_cmd_error_exception { };
 
+// thrown by log_error() and log_cmd_error() in a thread with a log buffer
+struct log_thread_error_exception {
+	std::string message;
+	bool cmd_error;
+};
+
 extern std::vector<FILE*> log_files;
 extern std::vector<std::ostream*> log_streams;
 extern std::map<std::string, std::set<std::string>> log_hdump;
@@ -61,6 +67,10 @@ extern bool log_quiet_warnings;
 extern int log_verbose_level;
 extern string log_last_error;
 
+// if set, the log output of the current thread is appended to this buffer
+// instead of being written to the log files (see parallel_for_modules())
+extern thread_local std::string *log_thread_buffer;
+
 void logv(const char *format, va_list ap);
 void logv_header(RTLIL::Design *design, const char *format, va_list ap);
 void logv_warning(const char *format, va_list ap);
@@ -78,6 +88,7 @@ void log_pop();
 
 void log_backtrace(const char *prefix, int levels);
 void log_reset_stack();
+void log_id_cache_clear();
 void log_flush();
 
 const char *log_signal(const RTLIL::SigSpec &sig, bool autoint = true);
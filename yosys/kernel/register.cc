@@ -24,6 +24,44 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <errno.h>
+#include <chrono>
+
+#ifndef _WIN32
+#  include <sys/resource.h>
+#endif
+
+#ifdef __linux__
+#  include <malloc.h>
+
+// count the heap bytes for PassProfile. the size of a block is not known
+// in operator delete, so we use the usable size of the malloc() block.
+void *operator new(size_t size)
+{
+	void *p = malloc(size ? size : 1);
+	if (p == nullptr)
+		throw std::bad_alloc();
+	if (YOSYS_NAMESPACE_PREFIX PassProfile::enabled)
+		YOSYS_NAMESPACE_PREFIX PassProfile::heap_alloc_bytes.fetch_add(malloc_usable_size(p), std::memory_order_relaxed);
+	return p;
+}
+
+void *operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+	if (p != nullptr && YOSYS_NAMESPACE_PREFIX PassProfile::enabled)
+		YOSYS_NAMESPACE_PREFIX PassProfile::heap_freed_bytes.fetch_add(malloc_usable_size(p), std::memory_order_relaxed);
+	free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+	operator delete(p);
+}
+#endif
 
 YOSYS_NAMESPACE_BEGIN
 
@@ -45,6 +83,7 @@ Pass::Pass(std::string name, std::string short_help) : pass_name(name), short_he
 	first_queued_pass = this;
 	call_counter = 0;
 	runtime_ns = 0;
+	handles_lazy_modules = false;
 }
 
 void Pass::run_register()
@@ -73,12 +112,18 @@ Pass::~Pass()
 {
 }
 
-Pass::pre_post_exec_state_t Pass::pre_execute()
+Pass::pre_post_exec_state_t Pass::pre_execute(const std::vector<std::string> &args, RTLIL::Design *design)
 {
 	pre_post_exec_state_t state;
+	if (!handles_lazy_modules && design != nullptr)
+		design->materialize_all();
 	call_counter++;
 	state.begin_ns = PerformanceTimer::query();
 	state.parent_pass = current_pass;
+	state.profile_idx = -1;
+	state.design = design;
+	if (PassProfile::enabled && current_pass != this)
+		state.profile_idx = PassProfile::begin(this, args, design);
 	current_pass = this;
 	clear_flags();
 	return state;
@@ -91,6 +136,177 @@ void Pass::post_execute(Pass::pre_post_exec_state_t state)
 	current_pass = state.parent_pass;
 	if (current_pass)
 		current_pass->runtime_ns -= time_ns;
+	if (state.profile_idx >= 0)
+		PassProfile::end(state.profile_idx, state.design);
+}
+
+bool PassProfile::enabled = false;
+std::vector<PassProfile::record_t> PassProfile::records;
+int PassProfile::current = -1;
+std::atomic<int64_t> PassProfile::heap_alloc_bytes(0), PassProfile::heap_freed_bytes(0);
+
+static int64_t profile_wall_ns()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static long profile_maxrss_kb()
+{
+#ifdef _WIN32
+	return 0;
+#else
+	struct rusage ru_buffer;
+	getrusage(RUSAGE_SELF, &ru_buffer);
+	return ru_buffer.ru_maxrss;
+#endif
+}
+
+int PassProfile::begin(Pass *pass, const std::vector<std::string> &args, RTLIL::Design *design)
+{
+	int idx = GetSize(records);
+	records.push_back(record_t());
+
+	record_t &rec = records.back();
+	rec.pass_name = pass->pass_name;
+	for (auto &arg : args)
+		rec.command += (rec.command.empty() ? "" : " ") + arg;
+	rec.parent = current;
+	rec.done = false;
+
+	if (design != nullptr)
+		for (auto &it : design->modules_)
+			rec.modules[it.first] = {GetSize(it.second->cells_), GetSize(it.second->wires_), -1, -1, -1};
+
+	current = idx;
+
+	// the begin values, replaced by the differences in end()
+	rec.maxrss_kb = profile_maxrss_kb();
+	rec.heap_alloc = heap_alloc_bytes;
+	rec.heap_freed = heap_freed_bytes;
+	rec.cpu_ns = PerformanceTimer::query();
+	rec.wall_ns = profile_wall_ns();
+	return idx;
+}
+
+void PassProfile::end(int idx, RTLIL::Design *design)
+{
+	record_t &rec = records.at(idx);
+	rec.wall_ns = profile_wall_ns() - rec.wall_ns;
+	rec.cpu_ns = PerformanceTimer::query() - rec.cpu_ns;
+	rec.heap_alloc = heap_alloc_bytes - rec.heap_alloc;
+	rec.heap_freed = heap_freed_bytes - rec.heap_freed;
+	rec.maxrss_kb = profile_maxrss_kb() - rec.maxrss_kb;
+	rec.done = true;
+
+	if (design != nullptr)
+		for (auto &it : design->modules_) {
+			if (rec.modules.count(it.first) == 0)
+				rec.modules[it.first] = {-1, -1, -1, -1, -1};
+			auto &stats = rec.modules.at(it.first);
+			stats.cells_after = GetSize(it.second->cells_);
+			stats.wires_after = GetSize(it.second->wires_);
+		}
+
+	current = rec.parent;
+}
+
+void PassProfile::add_module_runtime(RTLIL::Module *module, int64_t runtime_ns)
+{
+	if (current < 0)
+		return;
+	auto &modules = records.at(current).modules;
+	if (modules.count(module->name) == 0)
+		modules[module->name] = {-1, -1, -1, -1, -1};
+	auto &stats = modules.at(module->name);
+	stats.runtime_ns = std::max(stats.runtime_ns, int64_t(0)) + runtime_ns;
+}
+
+static std::string profile_json_string(const std::string &str)
+{
+	std::string result = "\"";
+	for (char c : str) {
+		if (c == '"' || c == '\\')
+			result += '\\';
+		if ((unsigned char)c < 0x20)
+			result += stringf("\\u%04x", c);
+		else
+			result += c;
+	}
+	return result + "\"";
+}
+
+// writes <prefix>.json with all records, and <prefix>.folded with the
+// self time of each stack of passes in microseconds, the input format of
+// flamegraph.pl
+void PassProfile::write(std::string prefix)
+{
+	std::ofstream f;
+
+	f.open(prefix + ".json", std::ofstream::trunc);
+	if (f.fail())
+		log_error("Can't open file `%s.json' for writing: %s\n", prefix.c_str(), strerror(errno));
+
+	f << stringf("{\n  \"creator\": %s,\n  \"invocations\": [", profile_json_string(yosys_version_str).c_str());
+	for (int i = 0; i < GetSize(records); i++)
+	{
+		auto &rec = records[i];
+		f << stringf("%s\n    {\n", i ? "," : "");
+		f << stringf("      \"id\": %d,\n      \"parent\": %d,\n", i, rec.parent);
+		f << stringf("      \"pass\": %s,\n", profile_json_string(rec.pass_name).c_str());
+		f << stringf("      \"command\": %s,\n", profile_json_string(rec.command).c_str());
+		if (rec.done) {
+			f << stringf("      \"wall_ns\": %lld,\n      \"cpu_ns\": %lld,\n", (long long)rec.wall_ns, (long long)rec.cpu_ns);
+			f << stringf("      \"heap_alloc_bytes\": %lld,\n      \"heap_freed_bytes\": %lld,\n", (long long)rec.heap_alloc, (long long)rec.heap_freed);
+			f << stringf("      \"maxrss_delta_kb\": %ld,\n", rec.maxrss_kb);
+		} else
+			f << stringf("      \"incomplete\": true,\n");
+
+		// only the modules that were changed or timed
+		bool first = true;
+		f << stringf("      \"modules\": {");
+		for (auto &it : rec.modules) {
+			auto &stats = it.second;
+			if (rec.done && stats.runtime_ns < 0 && stats.cells_before == stats.cells_after && stats.wires_before == stats.wires_after)
+				continue;
+			f << stringf("%s\n        %s: { \"cells_before\": %d, \"cells_after\": %d, \"wires_before\": %d, \"wires_after\": %d",
+					first ? "" : ",", profile_json_string(it.first.str()).c_str(), stats.cells_before, stats.cells_after,
+					stats.wires_before, stats.wires_after);
+			if (stats.runtime_ns >= 0)
+				f << stringf(", \"runtime_ns\": %lld", (long long)stats.runtime_ns);
+			f << stringf(" }");
+			first = false;
+		}
+		f << stringf("%s}\n    }", first ? "" : "\n      ");
+	}
+	f << stringf("\n  ]\n}\n");
+	f.close();
+
+	std::vector<int64_t> self_ns(GetSize(records));
+	for (int i = 0; i < GetSize(records); i++) {
+		if (!records[i].done)
+			continue;
+		self_ns[i] += records[i].wall_ns;
+		if (records[i].parent >= 0)
+			self_ns[records[i].parent] -= records[i].wall_ns;
+	}
+
+	std::map<std::string, int64_t> stacks;
+	for (int i = 0; i < GetSize(records); i++) {
+		if (!records[i].done)
+			continue;
+		std::string stack = records[i].pass_name;
+		for (int k = records[i].parent; k >= 0; k = records[k].parent)
+			stack = records[k].pass_name + ";" + stack;
+		stacks[stack] += self_ns[i];
+	}
+
+	f.open(prefix + ".folded", std::ofstream::trunc);
+	if (f.fail())
+		log_error("Can't open file `%s.folded' for writing: %s\n", prefix.c_str(), strerror(errno));
+	for (auto &it : stacks)
+		if (it.second >= 1000)
+			f << stringf("%s %lld\n", it.first.c_str(), (long long)(it.second / 1000));
+	f.close();
 }
 
 void Pass::help()
@@ -228,7 +444,7 @@ void Pass::call(RTLIL::Design *design, std::vector<std::string> args)
 		log_cmd_error("No such command: %s (type 'help' for a command overview)\n", args[0].c_str());
 
 	size_t orig_sel_stack_pos = design->selection_stack.size();
-	auto state = pass_register[args[0]]->pre_execute();
+	auto state = pass_register[args[0]]->pre_execute(args, design);
 	pass_register[args[0]]->execute(args, design);
 	pass_register[args[0]]->post_execute(state);
 	while (design->selection_stack.size() > orig_sel_stack_pos)
@@ -366,7 +582,7 @@ void Frontend::execute(std::vector<std::string> args, RTLIL::Design *design)
 	do {
 		std::istream *f = NULL;
 		next_args.clear();
-		auto state = pre_execute();
+		auto state = pre_execute(args, design);
 		execute(f, std::string(), args, design);
 		post_execute(state);
 		args = next_args;
@@ -475,12 +691,12 @@ void Frontend::frontend_call(RTLIL::Design *design, std::istream *f, std::string
 		log_cmd_error("No such frontend: %s\n", args[0].c_str());
 
 	if (f != NULL) {
-		auto state = frontend_register[args[0]]->pre_execute();
+		auto state = frontend_register[args[0]]->pre_execute(args, design);
 		frontend_register[args[0]]->execute(f, filename, args, design);
 		frontend_register[args[0]]->post_execute(state);
 	} else if (filename == "-") {
 		std::istream *f_cin = &std::cin;
-		auto state = frontend_register[args[0]]->pre_execute();
+		auto state = frontend_register[args[0]]->pre_execute(args, design);
 		frontend_register[args[0]]->execute(f_cin, "<stdin>", args, design);
 		frontend_register[args[0]]->post_execute(state);
 	} else {
@@ -514,7 +730,7 @@ Backend::~Backend()
 void Backend::execute(std::vector<std::string> args, RTLIL::Design *design)
 {
 	std::ostream *f = NULL;
-	auto state = pre_execute();
+	auto state = pre_execute(args, design);
 	execute(f, std::string(), args, design);
 	post_execute(state);
 	if (f != &std::cout)
@@ -581,12 +797,12 @@ void Backend::backend_call(RTLIL::Design *design, std::ostream *f, std::string f
 	size_t orig_sel_stack_pos = design->selection_stack.size();
 
 	if (f != NULL) {
-		auto state = backend_register[args[0]]->pre_execute();
+		auto state = backend_register[args[0]]->pre_execute(args, design);
 		backend_register[args[0]]->execute(f, filename, args, design);
 		backend_register[args[0]]->post_execute(state);
 	} else if (filename == "-") {
 		std::ostream *f_cout = &std::cout;
-		auto state = backend_register[args[0]]->pre_execute();
+		auto state = backend_register[args[0]]->pre_execute(args, design);
 		backend_register[args[0]]->execute(f_cout, "<stdout>", args, design);
 		backend_register[args[0]]->post_execute(state);
 	} else {
@@ -37,12 +37,18 @@ struct Pass
 	int call_counter;
 	int64_t runtime_ns;
 
+	// set by passes that can work on designs with lazy modules (see
+	// RTLIL::LazyModule). they are materialized before all other passes.
+	bool handles_lazy_modules;
+
 	struct pre_post_exec_state_t {
 		Pass *parent_pass;
 		int64_t begin_ns;
+		int profile_idx;
+		RTLIL::Design *design;
 	};
 
-	pre_post_exec_state_t pre_execute();
+	pre_post_exec_state_t pre_execute(const std::vector<std::string> &args, RTLIL::Design *design);
 	void post_execute(pre_post_exec_state_t state);
 
 	void cmd_log_args(const std::vector<std::string> &args);
@@ -64,6 +70,37 @@ struct Pass
 	static void done_register();
 };
 
+// profile of every pass invocation, enabled with "yosys -P <prefix>"
+struct PassProfile
+{
+	struct module_stats_t {
+		int cells_before, wires_before;
+		int cells_after, wires_after;
+		int64_t runtime_ns;
+	};
+
+	struct record_t {
+		std::string pass_name, command;
+		int parent;
+		bool done;
+		int64_t wall_ns, cpu_ns, heap_alloc, heap_freed;
+		long maxrss_kb;
+		dict<RTLIL::IdString, module_stats_t> modules;
+	};
+
+	static bool enabled;
+	static std::vector<record_t> records;
+	static int current;
+
+	// bytes passed through operator new/delete while enabled
+	static std::atomic<int64_t> heap_alloc_bytes, heap_freed_bytes;
+
+	static int begin(Pass *pass, const std::vector<std::string> &args, RTLIL::Design *design);
+	static void end(int idx, RTLIL::Design *design);
+	static void add_module_runtime(RTLIL::Module *module, int64_t runtime_ns);
+	static void write(std::string prefix);
+};
+
 struct ScriptPass : Pass
 {
 	bool block_active, help_mode;
@@ -25,6 +25,8 @@
 
 #include <string.h>
 #include <algorithm>
+#include <atomic>
+#include <mutex>
 
 YOSYS_NAMESPACE_BEGIN
 
@@ -33,6 +35,202 @@ std::vector<int> RTLIL::IdString::global_refcount_storage_;
 std::vector<char*> RTLIL::IdString::global_id_storage_;
 dict<char*, int, hash_cstr_ops> RTLIL::IdString::global_id_index_;
 std::vector<int> RTLIL::IdString::global_free_idx_list_;
+bool RTLIL::IdString::global_threaded_ = false;
+
+// ids that are created while IdString::global_threaded_ is set are kept in
+// chunks that never move, and in sharded tables until end_threaded() moves
+// them to the global cache
+struct threaded_id_t {
+	char *str;
+	std::atomic<int> refcount;
+};
+
+static const int threaded_chunk_bits = 12;
+static const int threaded_chunk_size = 1 << threaded_chunk_bits;
+static const int threaded_max_chunks = 0x40000000 >> threaded_chunk_bits;
+static const int threaded_num_shards = 16;
+
+struct threaded_shard_t {
+	std::mutex mutex;
+	dict<char*, int, hash_cstr_ops> index;
+};
+
+static int threaded_base, threaded_step;
+static thread_local int threaded_next_idx = -1;
+static std::atomic<threaded_id_t*> *threaded_chunks;
+static std::atomic<int> threaded_num_chunks;
+static std::mutex threaded_chunks_mutex;
+static threaded_shard_t threaded_shards[threaded_num_shards];
+
+static inline std::atomic<int> &threaded_refcount(int idx)
+{
+	static_assert(sizeof(std::atomic<int>) == sizeof(int), "unexpected size of std::atomic<int>");
+	return *reinterpret_cast<std::atomic<int>*>(&RTLIL::IdString::global_refcount_storage_[idx]);
+}
+
+static inline threaded_id_t &threaded_id(int idx)
+{
+	idx -= threaded_base;
+	threaded_id_t *chunk = threaded_chunks[idx >> threaded_chunk_bits].load(std::memory_order_acquire);
+	return chunk[idx & (threaded_chunk_size-1)];
+}
+
+void RTLIL::IdString::begin_threaded(int num_jobs)
+{
+	// attribute names that are looked up by name in the worker threads. they
+	// are kept in the cache, otherwise the job that creates them first would
+	// decide their index.
+	static std::vector<IdString> pinned_ids;
+	if (pinned_ids.empty())
+		for (auto p : {"\\blackbox", "\\init", "\\keep", "\\src", "\\top", "\\unused_bits"})
+			pinned_ids.push_back(p);
+
+	log_assert(!global_threaded_);
+
+	if (threaded_chunks == nullptr) {
+		threaded_chunks = new std::atomic<threaded_id_t*>[threaded_max_chunks];
+		for (int i = 0; i < threaded_max_chunks; i++)
+			threaded_chunks[i] = nullptr;
+	}
+
+	// a lookup may rehash the dict, do that now and not in the threads
+	global_id_index_.count((char*)"");
+
+	threaded_base = GetSize(global_id_storage_);
+	threaded_step = num_jobs;
+	global_threaded_ = true;
+}
+
+void RTLIL::IdString::set_thread_job(int job)
+{
+	threaded_next_idx = job < 0 ? -1 : threaded_base + job;
+}
+
+void RTLIL::IdString::end_threaded()
+{
+	log_assert(global_threaded_);
+	global_threaded_ = false;
+
+	std::vector<int> free_list;
+
+	for (int idx = 0; idx < threaded_base; idx++) {
+		if (global_refcount_storage_[idx] != 0 || global_id_storage_[idx] == nullptr)
+			continue;
+		global_id_index_.erase(global_id_storage_[idx]);
+		free(global_id_storage_[idx]);
+		global_id_storage_[idx] = nullptr;
+		free_list.push_back(idx);
+	}
+
+	int size = threaded_base;
+	for (int i = 0; i < threaded_num_chunks; i++) {
+		threaded_id_t *chunk = threaded_chunks[i];
+		for (int k = 0; k < threaded_chunk_size; k++) {
+			int idx = threaded_base + (i << threaded_chunk_bits) + k;
+			if (chunk[k].str == nullptr)
+				continue;
+			if (chunk[k].refcount == 0) {
+				free(chunk[k].str);
+				continue;
+			}
+			if (idx >= size) {
+				global_id_storage_.resize(idx+1, nullptr);
+				global_refcount_storage_.resize(idx+1, 0);
+				size = idx+1;
+			}
+			global_id_storage_[idx] = chunk[k].str;
+			global_refcount_storage_[idx] = chunk[k].refcount;
+			global_id_index_[chunk[k].str] = idx;
+		}
+		delete[] chunk;
+		threaded_chunks[i] = nullptr;
+	}
+	threaded_num_chunks = 0;
+
+	for (auto &shard : threaded_shards)
+		shard.index.clear();
+
+	// the holes in the job stripes go to the free list
+	for (int idx = threaded_base; idx < size; idx++)
+		if (global_id_storage_[idx] == nullptr)
+			free_list.push_back(idx);
+
+	// the lowest free index is the first to be reused
+	std::sort(free_list.begin(), free_list.end());
+	global_free_idx_list_.insert(global_free_idx_list_.end(), free_list.rbegin(), free_list.rend());
+}
+
+int RTLIL::IdString::get_reference_threaded(int idx)
+{
+	if (idx < threaded_base)
+		threaded_refcount(idx).fetch_add(1, std::memory_order_relaxed);
+	else
+		threaded_id(idx).refcount.fetch_add(1, std::memory_order_relaxed);
+	return idx;
+}
+
+int RTLIL::IdString::get_reference_threaded(const char *p)
+{
+	const dict<char*, int, hash_cstr_ops> &index = global_id_index_;
+	auto it = index.find((char*)p);
+	if (it != index.end())
+		return get_reference_threaded(it->second);
+
+	threaded_shard_t &shard = threaded_shards[hash_cstr_ops::hash(p) % threaded_num_shards];
+	std::lock_guard<std::mutex> lock(shard.mutex);
+
+	auto shard_it = shard.index.find((char*)p);
+	if (shard_it != shard.index.end())
+		return get_reference_threaded(shard_it->second);
+
+	if (p[0]) {
+		log_assert(p[1] != 0);
+		log_assert(p[0] == '$' || p[0] == '\\');
+	}
+
+	// new ids can only be created by parallel_for_modules() jobs
+	log_assert(threaded_next_idx >= 0);
+	int idx = threaded_next_idx;
+	threaded_next_idx += threaded_step;
+
+	int chunk_idx = (idx - threaded_base) >> threaded_chunk_bits;
+	log_assert(chunk_idx < threaded_max_chunks);
+
+	if (chunk_idx >= threaded_num_chunks.load(std::memory_order_acquire)) {
+		std::lock_guard<std::mutex> chunks_lock(threaded_chunks_mutex);
+		while (chunk_idx >= threaded_num_chunks.load(std::memory_order_relaxed)) {
+			threaded_id_t *chunk = new threaded_id_t[threaded_chunk_size];
+			for (int k = 0; k < threaded_chunk_size; k++) {
+				chunk[k].str = nullptr;
+				chunk[k].refcount = 0;
+			}
+			threaded_chunks[threaded_num_chunks.load(std::memory_order_relaxed)].store(chunk, std::memory_order_release);
+			threaded_num_chunks.fetch_add(1, std::memory_order_release);
+		}
+	}
+
+	threaded_id_t &id = threaded_id(idx);
+	id.str = strdup(p);
+	id.refcount = 1;
+	shard.index[id.str] = idx;
+	return idx;
+}
+
+void RTLIL::IdString::put_reference_threaded(int idx)
+{
+	// ids without references are freed in end_threaded()
+	if (idx < threaded_base)
+		threaded_refcount(idx).fetch_sub(1, std::memory_order_relaxed);
+	else
+		threaded_id(idx).refcount.fetch_sub(1, std::memory_order_relaxed);
+}
+
+const char *RTLIL::IdString::c_str_threaded(int idx)
+{
+	if (idx < threaded_base)
+		return global_id_storage_[idx];
+	return threaded_id(idx).str;
+}
 
 RTLIL::Const::Const()
 {
@@ -292,7 +490,7 @@ void RTLIL::Selection::optimize(RTLIL::Design *design)
 
 RTLIL::Design::Design()
 {
-	static unsigned int hashidx_count = 123456789;
+	static thread_local unsigned int hashidx_count = 123456789;
 	hashidx_count = mkhash_xorshift(hashidx_count);
 	hashidx_ = hashidx_count;
 
@@ -312,11 +510,14 @@ RTLIL::Design::~Design()
 
 RTLIL::ObjRange<RTLIL::Module*> RTLIL::Design::modules()
 {
+	materialize_all();
 	return RTLIL::ObjRange<RTLIL::Module*>(&modules_, &refcount_modules_);
 }
 
 RTLIL::Module *RTLIL::Design::module(RTLIL::IdString name)
 {
+	if (lazy_modules_.count(name))
+		return materialize(name);
 	return modules_.count(name) ? modules_.at(name) : NULL;
 }
 
@@ -338,6 +539,7 @@ RTLIL::Module *RTLIL::Design::top_module()
 void RTLIL::Design::add(RTLIL::Module *module)
 {
 	log_assert(modules_.count(module->name) == 0);
+	log_assert(lazy_modules_.count(module->name) == 0);
 	log_assert(refcount_modules_ == 0);
 	modules_[module->name] = module;
 	module->design = this;
@@ -351,6 +553,33 @@ void RTLIL::Design::add(RTLIL::Module *module)
 	}
 }
 
+void RTLIL::Design::add_lazy(RTLIL::IdString name, std::shared_ptr<RTLIL::LazyModule> lazy)
+{
+	log_assert(!has(name));
+	lazy_modules_[name] = lazy;
+}
+
+RTLIL::Module *RTLIL::Design::materialize(RTLIL::IdString name)
+{
+	std::shared_ptr<RTLIL::LazyModule> lazy = lazy_modules_.at(name);
+	lazy_modules_.erase(name);
+
+	RTLIL::Module *module = lazy->load();
+	module->name = name;
+	add(module);
+	return module;
+}
+
+void RTLIL::Design::materialize_all()
+{
+	// in the order the lazy modules were added
+	std::vector<RTLIL::IdString> names;
+	for (auto &it : lazy_modules_)
+		names.push_back(it.first);
+	for (auto it = names.rbegin(); it != names.rend(); ++it)
+		materialize(*it);
+}
+
 RTLIL::Module *RTLIL::Design::addModule(RTLIL::IdString name)
 {
 	log_assert(modules_.count(name) == 0);
@@ -558,7 +787,7 @@ std::vector<RTLIL::Module*> RTLIL::Design::selected_whole_modules_warn() const
 
 RTLIL::Module::Module()
 {
-	static unsigned int hashidx_count = 123456789;
+	static thread_local unsigned int hashidx_count = 123456789;
 	hashidx_count = mkhash_xorshift(hashidx_count);
 	hashidx_ = hashidx_count;
 
@@ -2054,7 +2283,7 @@ RTLIL::SigSpec RTLIL::Module::Initstate(RTLIL::IdString name)
 
 RTLIL::Wire::Wire()
 {
-	static unsigned int hashidx_count = 123456789;
+	static thread_local unsigned int hashidx_count = 123456789;
 	hashidx_count = mkhash_xorshift(hashidx_count);
 	hashidx_ = hashidx_count;
 
@@ -2069,7 +2298,7 @@ RTLIL::Wire::Wire()
 
 RTLIL::Memory::Memory()
 {
-	static unsigned int hashidx_count = 123456789;
+	static thread_local unsigned int hashidx_count = 123456789;
 	hashidx_count = mkhash_xorshift(hashidx_count);
 	hashidx_ = hashidx_count;
 
@@ -2080,7 +2309,7 @@ RTLIL::Memory::Memory()
 
 RTLIL::Cell::Cell() : module(nullptr)
 {
-	static unsigned int hashidx_count = 123456789;
+	static thread_local unsigned int hashidx_count = 123456789;
 	hashidx_count = mkhash_xorshift(hashidx_count);
 	hashidx_ = hashidx_count;
 
@@ -2157,6 +2386,8 @@ bool RTLIL::Cell::known() const
 {
 	if (yosys_celltypes.cell_known(type))
 		return true;
+	if (yosys_celltypes_design)
+		return yosys_celltypes_design->cell_known(type);
 	if (module && module->design && module->design->module(type))
 		return true;
 	return false;
@@ -2166,6 +2397,8 @@ bool RTLIL::Cell::input(RTLIL::IdString portname) const
 {
 	if (yosys_celltypes.cell_known(type))
 		return yosys_celltypes.cell_input(type, portname);
+	if (yosys_celltypes_design)
+		return yosys_celltypes_design->cell_input(type, portname);
 	if (module && module->design) {
 		RTLIL::Module *m = module->design->module(type);
 		RTLIL::Wire *w = m ? m->wire(portname) : nullptr;
@@ -2178,6 +2411,8 @@ bool RTLIL::Cell::output(RTLIL::IdString portname) const
 {
 	if (yosys_celltypes.cell_known(type))
 		return yosys_celltypes.cell_output(type, portname);
+	if (yosys_celltypes_design)
+		return yosys_celltypes_design->cell_output(type, portname);
 	if (module && module->design) {
 		RTLIL::Module *m = module->design->module(type);
 		RTLIL::Wire *w = m ? m->wire(portname) : nullptr;
@@ -2417,6 +2652,7 @@ const RTLIL::SigSpec &RTLIL::SigSpec::operator=(const RTLIL::SigSpec &other)
 	cover("kernel.rtlil.sigspec.assign");
 
 	width_ = other.width_;
+	gen_++;
 	hash_ = other.hash_;
 	chunks_ = other.chunks_;
 	bits_.clear();
@@ -2596,6 +2832,7 @@ void RTLIL::SigSpec::pack() const
 
 	cover("kernel.rtlil.sigspec.convert.pack");
 	log_assert(that->chunks_.empty());
+	that->gen_++;
 
 	std::vector<RTLIL::SigBit> old_bits;
 	old_bits.swap(that->bits_);
@@ -2639,6 +2876,7 @@ void RTLIL::SigSpec::unpack() const
 			that->bits_.push_back(RTLIL::SigBit(c, i));
 
 	that->chunks_.clear();
+	that->gen_++;
 	that->hash_ = 0;
 }
 
@@ -2975,6 +3213,7 @@ void RTLIL::SigSpec::remove_const()
 			}
 
 		chunks_.swap(new_chunks);
+		gen_++;
 	}
 	else
 	{
@@ -3012,9 +3251,36 @@ void RTLIL::SigSpec::remove(int offset, int length)
 
 RTLIL::SigSpec RTLIL::SigSpec::extract(int offset, int length) const
 {
-	unpack();
-	cover("kernel.rtlil.sigspec.extract_pos");
-	return std::vector<RTLIL::SigBit>(bits_.begin() + offset, bits_.begin() + offset + length);
+	log_assert(offset >= 0);
+	log_assert(length >= 0);
+	log_assert(offset + length <= width_);
+
+	if (!packed()) {
+		cover("kernel.rtlil.sigspec.extract_pos.unpacked");
+		return std::vector<RTLIL::SigBit>(bits_.begin() + offset, bits_.begin() + offset + length);
+	}
+
+	// cut the range out of the chunks, so that neither this nor the
+	// returned SigSpec needs to be unpacked
+	cover("kernel.rtlil.sigspec.extract_pos.packed");
+
+	RTLIL::SigSpec result;
+	for (auto &c : chunks_) {
+		if (length == 0)
+			break;
+		if (offset >= c.width) {
+			offset -= c.width;
+			continue;
+		}
+		int n = std::min(c.width - offset, length);
+		result.chunks_.push_back(offset == 0 && n == c.width ? c : c.extract(offset, n));
+		result.width_ += n;
+		length -= n;
+		offset = 0;
+	}
+
+	result.check();
+	return result;
 }
 
 void RTLIL::SigSpec::append(const RTLIL::SigSpec &signal)
@@ -3449,22 +3715,26 @@ std::vector<RTLIL::SigBit> RTLIL::SigSpec::to_sigbit_vector() const
 {
 	cover("kernel.rtlil.sigspec.to_sigbit_vector");
 
-	unpack();
-	return bits_;
+	if (!packed())
+		return bits_;
+
+	std::vector<RTLIL::SigBit> sigbits;
+	sigbits.reserve(width_);
+	for (auto &c : chunks_)
+		for (int i = 0; i < c.width; i++)
+			sigbits.push_back(RTLIL::SigBit(c, i));
+	return sigbits;
 }
 
 std::map<RTLIL::SigBit, RTLIL::SigBit> RTLIL::SigSpec::to_sigbit_map(const RTLIL::SigSpec &other) const
 {
 	cover("kernel.rtlil.sigspec.to_sigbit_map");
 
-	unpack();
-	other.unpack();
-
 	log_assert(width_ == other.width_);
 
 	std::map<RTLIL::SigBit, RTLIL::SigBit> new_map;
-	for (int i = 0; i < width_; i++)
-		new_map[bits_[i]] = other.bits_[i];
+	for (auto it = begin(), other_it = other.begin(); it != end(); ++it, ++other_it)
+		new_map[*it] = *other_it;
 
 	return new_map;
 }
@@ -3473,14 +3743,11 @@ dict<RTLIL::SigBit, RTLIL::SigBit> RTLIL::SigSpec::to_sigbit_dict(const RTLIL::S
 {
 	cover("kernel.rtlil.sigspec.to_sigbit_dict");
 
-	unpack();
-	other.unpack();
-
 	log_assert(width_ == other.width_);
 
 	dict<RTLIL::SigBit, RTLIL::SigBit> new_map;
-	for (int i = 0; i < width_; i++)
-		new_map[bits_[i]] = other.bits_[i];
+	for (auto it = begin(), other_it = other.begin(); it != end(); ++it, ++other_it)
+		new_map[*it] = *other_it;
 
 	return new_map;
 }
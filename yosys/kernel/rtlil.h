@@ -57,6 +57,7 @@ namespace RTLIL
 	struct AttrObject;
 	struct Selection;
 	struct Monitor;
+	struct LazyModule;
 	struct Design;
 	struct Module;
 	struct Wire;
@@ -89,13 +90,56 @@ namespace RTLIL
 		static dict<char*, int, hash_cstr_ops> global_id_index_;
 		static std::vector<int> global_free_idx_list_;
 
+		// while parallel_for_modules() is running, all accesses to the cache
+		// go through the *_threaded() functions below: existing ids are looked
+		// up without locking, new ids are added to sharded tables and get an
+		// index from the stripe of the current job, and unused ids are only
+		// freed in end_threaded(). this way the indices do not depend on timing.
+		static bool global_threaded_;
+
+		static void begin_threaded(int num_jobs);
+		static void set_thread_job(int job);
+		static void end_threaded();
+
+		static int get_reference_threaded(int idx);
+		static int get_reference_threaded(const char *p);
+		static void put_reference_threaded(int idx);
+		static const char *c_str_threaded(int idx);
+
 		static inline int get_reference(int idx)
+		{
+			if (global_threaded_)
+				return get_reference_threaded(idx);
+			return get_reference_unlocked(idx);
+		}
+
+		static inline int get_reference(const char *p)
+		{
+			if (global_threaded_)
+				return get_reference_threaded(p);
+			return get_reference_unlocked(p);
+		}
+
+		static inline void put_reference(int idx)
+		{
+			// put_reference() may be called from destructors after the destructor of
+			// global_refcount_storage_ has been run. in this case we simply do nothing.
+			if (!destruct_guard.ok)
+				return;
+
+			if (global_threaded_)
+				put_reference_threaded(idx);
+			else
+				put_reference_unlocked(idx);
+		}
+
+		static inline int get_reference_unlocked(int idx)
 		{
 			global_refcount_storage_.at(idx)++;
 			return idx;
 		}
 
-		static inline int get_reference(const char *p)
+		static inline int get_reference_unlocked(const char *p)
 		{
 			log_assert(destruct_guard.ok);
 
@@ -125,9 +169,9 @@ namespace RTLIL
 
 			// Avoid Create->Delete->Create pattern
 			static IdString last_created_id;
-			put_reference(last_created_id.index_);
+			put_reference_unlocked(last_created_id.index_);
 			last_created_id.index_ = idx;
-			get_reference(last_created_id.index_);
+			get_reference_unlocked(last_created_id.index_);
 
 			if (yosys_xtrace) {
 				log("#X# New IdString '%s' with index %d.\n", p, idx);
@@ -137,13 +181,8 @@ namespace RTLIL
 			return idx;
 		}
 
-		static inline void put_reference(int idx)
+		static inline void put_reference_unlocked(int idx)
 		{
-			// put_reference() may be called from destructors after the destructor of
-			// global_refcount_storage_ has been run. in this case we simply do nothing.
-			if (!destruct_guard.ok)
-				return;
-
 			log_assert(global_refcount_storage_.at(idx) > 0);
 
 			if (--global_refcount_storage_.at(idx) != 0)
@@ -186,11 +225,13 @@ namespace RTLIL
 		}
 
 		const char *c_str() const {
+			if (global_threaded_)
+				return c_str_threaded(index_);
 			return global_id_storage_.at(index_);
 		}
 
 		std::string str() const {
-			return std::string(global_id_storage_.at(index_));
+			return std::string(c_str());
 		}
 
 		bool operator<(const IdString &rhs) const {
@@ -567,16 +608,25 @@ struct RTLIL::SigSpecConstIterator : public std::iterator<std::input_iterator_ta
 	const RTLIL::SigSpec *sig_p;
 	int index;
 
+	// a packed SigSpec is walked chunk by chunk instead of being unpacked,
+	// this falls back to operator[] when the SigSpec changes under our feet
+	int chunk_idx, chunk_offset;
+	unsigned int gen;
+	RTLIL::SigBit bit;
+
 	inline const RTLIL::SigBit &operator*() const;
 	inline bool operator!=(const RTLIL::SigSpecConstIterator &other) const { return index != other.index; }
 	inline bool operator==(const RTLIL::SigSpecIterator &other) const { return index == other.index; }
-	inline void operator++() { index++; }
+	inline void operator++();
 };
 
 struct RTLIL::SigSpec
 {
 private:
+	friend struct RTLIL::SigSpecConstIterator;
+
 	int width_;
+	unsigned int gen_ = 0; // changed when chunks_ is rebuilt, see SigSpecConstIterator
 	unsigned long hash_;
 	std::vector<RTLIL::SigChunk> chunks_; // LSB at index 0
 	std::vector<RTLIL::SigBit> bits_; // LSB at index 0
@@ -623,6 +673,7 @@ public:
 
 	const RTLIL::SigSpec &operator=(RTLIL::SigSpec &&other) {
 		width_ = other.width_;
+		gen_++;
 		hash_ = other.hash_;
 		chunks_ = std::move(other.chunks_);
 		bits_ = std::move(other.bits_);
@@ -646,8 +697,8 @@ public:
 	inline RTLIL::SigSpecIterator begin() { RTLIL::SigSpecIterator it; it.sig_p = this; it.index = 0; return it; }
 	inline RTLIL::SigSpecIterator end() { RTLIL::SigSpecIterator it; it.sig_p = this; it.index = width_; return it; }
 
-	inline RTLIL::SigSpecConstIterator begin() const { RTLIL::SigSpecConstIterator it; it.sig_p = this; it.index = 0; return it; }
-	inline RTLIL::SigSpecConstIterator end() const { RTLIL::SigSpecConstIterator it; it.sig_p = this; it.index = width_; return it; }
+	inline RTLIL::SigSpecConstIterator begin() const;
+	inline RTLIL::SigSpecConstIterator end() const { RTLIL::SigSpecConstIterator it; it.sig_p = this; it.index = width_; it.chunk_idx = -1; return it; }
 
 	void sort();
 	void sort_and_unify();
@@ -769,7 +820,7 @@ struct RTLIL::Monitor
 	unsigned int hash() const { return hashidx_; }
 
 	Monitor() {
-		static unsigned int hashidx_count = 123456789;
+		static thread_local unsigned int hashidx_count = 123456789;
 		hashidx_count = mkhash_xorshift(hashidx_count);
 		hashidx_ = hashidx_count;
 	}
@@ -783,6 +834,16 @@ struct RTLIL::Monitor
 	virtual void notify_blackout(RTLIL::Module*) { }
 };
 
+// a module that is only created when it is first used, e.g. from a memory
+// mapped binary RTLIL checkpoint (see 'read_rtlil_bin -lazy'). load() returns
+// a new module on every call, so the same object can be shared by copies of
+// a design.
+struct RTLIL::LazyModule
+{
+	virtual ~LazyModule() { }
+	virtual RTLIL::Module *load() = 0;
+};
+
 struct RTLIL::Design
 {
 	unsigned int hashidx_;
@@ -793,6 +854,7 @@ struct RTLIL::Design
 
 	int refcount_modules_;
 	dict<RTLIL::IdString, RTLIL::Module*> modules_;
+	dict<RTLIL::IdString, std::shared_ptr<RTLIL::LazyModule>> lazy_modules_;
 	std::vector<AST::AstNode*> verilog_packages, verilog_globals;
 	dict<std::string, std::pair<std::string, bool>> verilog_defines;
 
@@ -808,10 +870,13 @@ struct RTLIL::Design
 	RTLIL::Module *top_module();
 
 	bool has(RTLIL::IdString id) const {
-		return modules_.count(id) != 0;
+		return modules_.count(id) != 0 || lazy_modules_.count(id) != 0;
 	}
 
 	void add(RTLIL::Module *module);
+	void add_lazy(RTLIL::IdString name, std::shared_ptr<RTLIL::LazyModule> lazy);
+	RTLIL::Module *materialize(RTLIL::IdString name);
+	void materialize_all();
 	RTLIL::Module *addModule(RTLIL::IdString name);
 	void remove(RTLIL::Module *module);
 	void rename(RTLIL::Module *module, RTLIL::IdString new_name);
@@ -1282,9 +1347,41 @@ inline RTLIL::SigBit &RTLIL::SigSpecIterator::operator*() const {
 }
 
 inline const RTLIL::SigBit &RTLIL::SigSpecConstIterator::operator*() const {
+	if (chunk_idx >= 0 && gen == sig_p->gen_)
+		return bit;
 	return (*sig_p)[index];
 }
 
+inline void RTLIL::SigSpecConstIterator::operator++() {
+	index++;
+	if (chunk_idx < 0)
+		return;
+	if (gen != sig_p->gen_) {
+		chunk_idx = -1;
+		return;
+	}
+	if (++chunk_offset == sig_p->chunks_[chunk_idx].width) {
+		chunk_idx++;
+		chunk_offset = 0;
+	}
+	if (index < sig_p->width_)
+		bit = RTLIL::SigBit(sig_p->chunks_[chunk_idx], chunk_offset);
+}
+
+inline RTLIL::SigSpecConstIterator RTLIL::SigSpec::begin() const {
+	RTLIL::SigSpecConstIterator it;
+	it.sig_p = this;
+	it.index = 0;
+	it.chunk_idx = -1;
+	if (packed() && width_ > 0) {
+		it.chunk_idx = 0;
+		it.chunk_offset = 0;
+		it.gen = gen_;
+		it.bit = RTLIL::SigBit(chunks_[0], 0);
+	}
+	return it;
+}
+
 inline RTLIL::SigBit::SigBit(const RTLIL::SigSpec &sig) {
 	log_assert(sig.size() == 1 && sig.chunks().size() == 1);
 	*this = SigBit(sig.chunks().front());
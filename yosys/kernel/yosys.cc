@@ -48,6 +48,12 @@
 
 #include <limits.h>
 #include <errno.h>
+#include <chrono>
+
+#if !defined(_WIN32) && !defined(__EMSCRIPTEN__)
+#  include <thread>
+#  include <mutex>
+#endif
 
 YOSYS_NAMESPACE_BEGIN
 
@@ -55,6 +61,13 @@ int autoidx = 1;
 int yosys_xtrace = 0;
 RTLIL::Design *yosys_design = NULL;
 CellTypes yosys_celltypes;
+CellTypes *yosys_celltypes_design = nullptr;
+
+// NEW_ID numbers for a job of parallel_for_modules()
+struct autoidx_stripe_t {
+	int next, step;
+};
+static thread_local autoidx_stripe_t *autoidx_stripe = nullptr;
 
 #ifdef YOSYS_ENABLE_TCL
 Tcl_Interp *yosys_tcl_interp = NULL;
@@ -458,6 +471,147 @@ int GetSize(RTLIL::Wire *wire)
 	return wire->width;
 }
 
+void parallel_for(int num_jobs, int num_threads, const std::function<void(int)> &job)
+{
+#if !defined(_WIN32) && !defined(__EMSCRIPTEN__)
+	if (num_threads > num_jobs)
+		num_threads = num_jobs;
+
+	if (num_threads > 1)
+	{
+		std::atomic<int> next_job(0);
+		std::exception_ptr error;
+		std::mutex error_mutex;
+
+		auto worker = [&]() {
+			for (int i = next_job++; i < num_jobs; i = next_job++)
+				try {
+					job(i);
+				} catch (...) {
+					std::lock_guard<std::mutex> lock(error_mutex);
+					if (!error)
+						error = std::current_exception();
+					next_job = num_jobs;
+				}
+		};
+
+		std::vector<std::thread> threads;
+		for (int i = 1; i < num_threads; i++)
+			threads.push_back(std::thread(worker));
+		worker();
+		for (auto &t : threads)
+			t.join();
+
+		if (error)
+			std::rethrow_exception(error);
+		return;
+	}
+#else
+	(void)num_threads;
+#endif
+
+	for (int i = 0; i < num_jobs; i++)
+		job(i);
+}
+
+static int64_t module_job_wall_ns()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void parallel_for_modules(const std::vector<RTLIL::Module*> &modules, int num_threads, const std::function<void(RTLIL::Module*)> &worker)
+{
+	if (num_threads <= 0) {
+		for (auto module : modules) {
+			int64_t begin_ns = PassProfile::enabled ? module_job_wall_ns() : 0;
+			worker(module);
+			if (PassProfile::enabled)
+				PassProfile::add_module_runtime(module, module_job_wall_ns() - begin_ns);
+		}
+		return;
+	}
+
+	int num_jobs = GetSize(modules);
+	if (num_jobs == 0)
+		return;
+
+	// start with the largest modules, so that they do not end up last
+	std::vector<int> order(num_jobs);
+	for (int i = 0; i < num_jobs; i++)
+		order[i] = i;
+	std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+		return GetSize(modules[a]->cells_) > GetSize(modules[b]->cells_);
+	});
+
+	CellTypes design_ct;
+	design_ct.setup_design(modules.front()->design);
+
+	// job i uses the NEW_ID numbers autoidx+i, autoidx+i+num_jobs, ..
+	std::vector<autoidx_stripe_t> stripes(num_jobs);
+	for (int i = 0; i < num_jobs; i++)
+		stripes[i] = {autoidx + i, num_jobs};
+
+	std::vector<std::string> job_logs(num_jobs);
+	std::vector<log_thread_error_exception> job_errors(num_jobs);
+	std::vector<bool> job_failed(num_jobs);
+	std::vector<int64_t> job_runtime_ns(num_jobs);
+
+	auto job = [&](int k) {
+		int i = order[k];
+		autoidx_stripe = &stripes[i];
+		log_thread_buffer = &job_logs[i];
+		RTLIL::IdString::set_thread_job(i);
+		try {
+			int64_t begin_ns = PassProfile::enabled ? module_job_wall_ns() : 0;
+			worker(modules[i]);
+			if (PassProfile::enabled)
+				job_runtime_ns[i] = module_job_wall_ns() - begin_ns;
+		} catch (log_thread_error_exception &e) {
+			job_errors[i] = e;
+			job_failed[i] = true;
+		} catch (...) {
+			log_id_cache_clear();
+			RTLIL::IdString::set_thread_job(-1);
+			log_thread_buffer = nullptr;
+			autoidx_stripe = nullptr;
+			throw;
+		}
+		log_id_cache_clear();
+		RTLIL::IdString::set_thread_job(-1);
+		log_thread_buffer = nullptr;
+		autoidx_stripe = nullptr;
+	};
+
+	log_id_cache_clear();
+	yosys_celltypes_design = &design_ct;
+	RTLIL::IdString::begin_threaded(num_jobs);
+
+	try {
+		parallel_for(num_jobs, num_threads, job);
+	} catch (...) {
+		RTLIL::IdString::end_threaded();
+		yosys_celltypes_design = nullptr;
+		throw;
+	}
+
+	RTLIL::IdString::end_threaded();
+	yosys_celltypes_design = nullptr;
+
+	for (auto &stripe : stripes)
+		autoidx = std::max(autoidx, stripe.next);
+
+	for (int i = 0; i < num_jobs; i++) {
+		if (PassProfile::enabled)
+			PassProfile::add_module_runtime(modules[i], job_runtime_ns[i]);
+		log("%s", job_logs[i].c_str());
+		if (!job_failed[i])
+			continue;
+		if (job_errors[i].cmd_error)
+			log_cmd_error("%s", job_errors[i].message.c_str());
+		log_error("%s", job_errors[i].message.c_str());
+	}
+}
+
 void yosys_setup()
 {
 	// if there are already IdString objects then we have a global initialization order bug
@@ -521,7 +675,11 @@ RTLIL::IdString new_id(std::string file, int line, std::string func)
 	if (pos != std::string::npos)
 		func = func.substr(pos+1);
 
-	return stringf("$auto$%s:%d:%s$%d", file.c_str(), line, func.c_str(), autoidx++);
+	int idx = autoidx_stripe ? autoidx_stripe->next : autoidx++;
+	if (autoidx_stripe)
+		autoidx_stripe->next += autoidx_stripe->step;
+
+	return stringf("$auto$%s:%d:%s$%d", file.c_str(), line, func.c_str(), idx);
 }
 
 RTLIL::Design *yosys_get_design()
@@ -794,6 +952,8 @@ void run_frontend(std::string filename, std::string command, std::string *backen
 			command = "blif";
 		else if (filename.size() > 3 && filename.substr(filename.size()-3) == ".il")
 			command = "ilang";
+		else if (filename.size() > 4 && filename.substr(filename.size()-4) == ".ilb")
+			command = "rtlil_bin";
 		else if (filename.size() > 3 && filename.substr(filename.size()-3) == ".ys")
 			command = "script";
 		else if (filename == "-")
@@ -903,6 +1063,8 @@ void run_backend(std::string filename, std::string command, RTLIL::Design *desig
 			command = "verilog";
 		else if (filename.size() > 3 && filename.substr(filename.size()-3) == ".il")
 			command = "ilang";
+		else if (filename.size() > 4 && filename.substr(filename.size()-4) == ".ilb")
+			command = "rtlil_bin";
 		else if (filename.size() > 4 && filename.substr(filename.size()-4) == ".aig")
 			command = "aiger";
 		else if (filename.size() > 5 && filename.substr(filename.size()-5) == ".blif")
@@ -52,6 +52,7 @@
 #include <stdexcept>
 #include <memory>
 #include <cmath>
+#include <atomic>
 
 #include <sstream>
 #include <fstream>
@@ -242,6 +243,19 @@ bool check_file_exists(std::string filename, bool is_exec = false);
 bool is_absolute_path(std::string filename);
 void remove_directory(std::string dirname);
 
+// Call job(0) .. job(num_jobs-1) using up to num_threads threads. The jobs
+// must not call log functions or create new IdStrings.
+void parallel_for(int num_jobs, int num_threads, const std::function<void(int)> &job);
+
+// Call worker(module) for all modules. With num_threads > 0 the modules are
+// processed in parallel using up to num_threads threads. This can only be used
+// by module-local passes: the worker may only access its own module (and the
+// ports of other modules via RTLIL::Cell::input() etc.), must not modify the
+// design, and must use NEW_ID for new names. The log output of each module is
+// buffered and printed in module order, and the NEW_ID names do not depend on
+// the number of threads.
+void parallel_for_modules(const std::vector<RTLIL::Module*> &modules, int num_threads, const std::function<void(RTLIL::Module*)> &worker);
+
 template<typename T> int GetSize(const T &obj) { return obj.size(); }
 int GetSize(RTLIL::Wire *wire);
 
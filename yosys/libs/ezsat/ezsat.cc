@@ -85,11 +85,13 @@ int ezSAT::literal()
 
 int ezSAT::literal(const std::string &name)
 {
-	if (literalsCache.count(name) == 0) {
-		literals.push_back(name);
-		literalsCache[name] = literals.size();
-	}
-	return literalsCache.at(name);
+	auto it = literalsCache.find(name);
+	if (it != literalsCache.end())
+		return it->second;
+
+	literals.push_back(name);
+	literalsCache[name] = literals.size();
+	return literals.size();
 }
 
 int ezSAT::frozen_literal()
@@ -106,25 +108,65 @@ int ezSAT::frozen_literal(const std::string &name)
 	return id;
 }
 
+static inline unsigned int expression_hash(ezSAT::OpId op, const int *args, int num_args)
+{
+	unsigned int h = 2166136261u ^ op;
+	for (int i = 0; i < num_args; i++)
+		h = (h ^ (unsigned int)args[i]) * 16777619u;
+	return h ^ (h >> 15);
+}
+
 int ezSAT::expression(OpId op, int a, int b, int c, int d, int e, int f)
 {
-	std::vector<int> args(6);
-	args[0] = a, args[1] = b, args[2] = c;
-	args[3] = d, args[4] = e, args[5] = f;
-	return expression(op, args);
+	int args[6] = { a, b, c, d, e, f };
+	return make_expression(op, args, 6);
 }
 
 int ezSAT::expression(OpId op, const std::vector<int> &args)
 {
-	std::vector<int> myArgs;
-	myArgs.reserve(args.size());
+	if (args.size() <= 8) {
+		int buffer[8];
+		std::copy(args.begin(), args.end(), buffer);
+		return make_expression(op, buffer, args.size());
+	}
+
+	std::vector<int> buffer(args);
+	return make_expression(op, buffer.data(), buffer.size());
+}
+
+// make room for 'num' new expressions in the hash table
+void ezSAT::reserve_expressions(int num)
+{
+	size_t min_size = 2 * (expressions.size() + num);
+	if (expressionsTable.size() >= min_size)
+		return;
+
+	size_t size = std::max(expressionsTable.size(), size_t(1024));
+	while (size < min_size)
+		size *= 2;
+
+	expressionsTable.assign(size, 0);
+	for (int i = 0; i < int(expressions.size()); i++) {
+		size_t slot = expressionsHash[i] & (size - 1);
+		while (expressionsTable[slot] != 0)
+			slot = (slot + 1) & (size - 1);
+		expressionsTable[slot] = -(i + 1);
+	}
+}
+
+// args is used as scratch buffer (the arguments are simplified and sorted in place)
+int ezSAT::make_expression(OpId op, int *args, int num_args)
+{
+	int numArgs = 0;
 	bool xorRemovedOddTrues = false;
 
 	addhash(__LINE__);
 	addhash(op);
 
-	for (auto arg : args)
+	for (int i = 0; i < num_args; i++)
 	{
+		int arg = args[i];
+
 		addhash(__LINE__);
 		addhash(arg);
 
@@ -138,79 +180,96 @@ int ezSAT::expression(OpId op, const std::vector<int> &args)
 			xorRemovedOddTrues = !xorRemovedOddTrues;
 			continue;
 		}
-		myArgs.push_back(arg);
+		args[numArgs++] = arg;
 	}
 
-	if (myArgs.size() > 0 && (op == OpAnd || op == OpOr || op == OpXor || op == OpIFF)) {
-		std::sort(myArgs.begin(), myArgs.end());
+	if (numArgs > 0 && (op == OpAnd || op == OpOr || op == OpXor || op == OpIFF)) {
+		std::sort(args, args + numArgs);
 		int j = 0;
-		for (int i = 1; i < int(myArgs.size()); i++)
-			if (j < 0 || myArgs[j] != myArgs[i])
-				myArgs[++j] = myArgs[i];
+		for (int i = 1; i < numArgs; i++)
+			if (j < 0 || args[j] != args[i])
+				args[++j] = args[i];
 			else if (op == OpXor)
 				j--;
-		myArgs.resize(j+1);
+		numArgs = j+1;
 	}
 
 	switch (op)
 	{
 	case OpNot:
-		assert(myArgs.size() == 1);
-		if (myArgs[0] == CONST_TRUE)
+		assert(numArgs == 1);
+		if (args[0] == CONST_TRUE)
 			return CONST_FALSE;
-		if (myArgs[0] == CONST_FALSE)
+		if (args[0] == CONST_FALSE)
 			return CONST_TRUE;
 		break;
 
 	case OpAnd:
-		if (myArgs.size() == 0)
+		if (numArgs == 0)
 			return CONST_TRUE;
-		if (myArgs.size() == 1)
-			return myArgs[0];
+		if (numArgs == 1)
+			return args[0];
 		break;
 
 	case OpOr:
-		if (myArgs.size() == 0)
+		if (numArgs == 0)
 			return CONST_FALSE;
-		if (myArgs.size() == 1)
-			return myArgs[0];
+		if (numArgs == 1)
+			return args[0];
 		break;
 
 	case OpXor:
-		if (myArgs.size() == 0)
+		if (numArgs == 0)
 			return xorRemovedOddTrues ? CONST_TRUE : CONST_FALSE;
-		if (myArgs.size() == 1)
-			return xorRemovedOddTrues ? NOT(myArgs[0]) : myArgs[0];
+		if (numArgs == 1)
+			return xorRemovedOddTrues ? NOT(args[0]) : args[0];
 		break;
 
 	case OpIFF:
-		assert(myArgs.size() >= 1);
-		if (myArgs.size() == 1)
+		assert(numArgs >= 1);
+		if (numArgs == 1)
 			return CONST_TRUE;
 		// FIXME: Add proper const folding
 		break;
 
 	case OpITE:
-		assert(myArgs.size() == 3);
-		if (myArgs[0] == CONST_TRUE)
-			return myArgs[1];
-		if (myArgs[0] == CONST_FALSE)
-			return myArgs[2];
+		assert(numArgs == 3);
+		if (args[0] == CONST_TRUE)
+			return args[1];
+		if (args[0] == CONST_FALSE)
+			return args[2];
 		break;
 
 	default:
 		abort();
 	}
 
-	std::pair<OpId, std::vector<int>> myExpr(op, myArgs);
+	reserve_expressions(1);
+
+	unsigned int hash = expression_hash(op, args, numArgs);
+	size_t mask = expressionsTable.size() - 1;
 	int id = 0;
 
-	if (expressionsCache.count(myExpr) > 0) {
-		id = expressionsCache.at(myExpr);
-	} else {
-		id = -(int(expressions.size()) + 1);
-		expressionsCache[myExpr] = id;
-		expressions.push_back(myExpr);
+	for (size_t slot = hash & mask;; slot = (slot + 1) & mask)
+	{
+		int entry = expressionsTable[slot];
+
+		if (entry == 0) {
+			id = -(int(expressions.size()) + 1);
+			expressionsTable[slot] = id;
+			expressionsHash.push_back(hash);
+			expressions.push_back(std::pair<OpId, std::vector<int>>(op, std::vector<int>(args, args + numArgs)));
+			break;
+		}
+
+		if (expressionsHash[-entry - 1] != hash)
+			continue;
+
+		const std::pair<OpId, std::vector<int>> &expr = expressions[-entry - 1];
+		if (expr.first == op && int(expr.second.size()) == numArgs && std::equal(args, args + numArgs, expr.second.begin())) {
+			id = entry;
+			break;
+		}
 	}
 
 	if (xorRemovedOddTrues)
@@ -737,9 +796,12 @@ std::vector<int> ezSAT::vec_cast(const std::vector<int> &vec1, int toBits, bool
 
 std::vector<int> ezSAT::vec_not(const std::vector<int> &vec1)
 {
-	std::vector<int> vec;
-	for (auto bit : vec1)
-		vec.push_back(NOT(bit));
+	std::vector<int> vec(vec1.size());
+	reserve_expressions(vec1.size());
+	for (int i = 0; i < int(vec1.size()); i++) {
+		int args[1] = { vec1[i] };
+		vec[i] = make_expression(OpNot, args, 1);
+	}
 	return vec;
 }
 
@@ -747,8 +809,11 @@ std::vector<int> ezSAT::vec_and(const std::vector<int> &vec1, const std::vector<
 {
 	assert(vec1.size() == vec2.size());
 	std::vector<int> vec(vec1.size());
-	for (int i = 0; i < int(vec1.size()); i++)
-		vec[i] = AND(vec1[i], vec2[i]);
+	reserve_expressions(vec1.size());
+	for (int i = 0; i < int(vec1.size()); i++) {
+		int args[2] = { vec1[i], vec2[i] };
+		vec[i] = make_expression(OpAnd, args, 2);
+	}
 	return vec;
 }
 
@@ -756,8 +821,11 @@ std::vector<int> ezSAT::vec_or(const std::vector<int> &vec1, const std::vector<i
 {
 	assert(vec1.size() == vec2.size());
 	std::vector<int> vec(vec1.size());
-	for (int i = 0; i < int(vec1.size()); i++)
-		vec[i] = OR(vec1[i], vec2[i]);
+	reserve_expressions(vec1.size());
+	for (int i = 0; i < int(vec1.size()); i++) {
+		int args[2] = { vec1[i], vec2[i] };
+		vec[i] = make_expression(OpOr, args, 2);
+	}
 	return vec;
 }
 
@@ -765,8 +833,11 @@ std::vector<int> ezSAT::vec_xor(const std::vector<int> &vec1, const std::vector<
 {
 	assert(vec1.size() == vec2.size());
 	std::vector<int> vec(vec1.size());
-	for (int i = 0; i < int(vec1.size()); i++)
-		vec[i] = XOR(vec1[i], vec2[i]);
+	reserve_expressions(vec1.size());
+	for (int i = 0; i < int(vec1.size()); i++) {
+		int args[2] = { vec1[i], vec2[i] };
+		vec[i] = make_expression(OpXor, args, 2);
+	}
 	return vec;
 }
 
@@ -774,8 +845,11 @@ std::vector<int> ezSAT::vec_iff(const std::vector<int> &vec1, const std::vector<
 {
 	assert(vec1.size() == vec2.size());
 	std::vector<int> vec(vec1.size());
-	for (int i = 0; i < int(vec1.size()); i++)
-		vec[i] = IFF(vec1[i], vec2[i]);
+	reserve_expressions(vec1.size());
+	for (int i = 0; i < int(vec1.size()); i++) {
+		int args[2] = { vec1[i], vec2[i] };
+		vec[i] = make_expression(OpIFF, args, 2);
+	}
 	return vec;
 }
 
@@ -783,8 +857,11 @@ std::vector<int> ezSAT::vec_ite(const std::vector<int> &vec1, const std::vector<
 {
 	assert(vec1.size() == vec2.size() && vec2.size() == vec3.size());
 	std::vector<int> vec(vec1.size());
-	for (int i = 0; i < int(vec1.size()); i++)
-		vec[i] = ITE(vec1[i], vec2[i], vec3[i]);
+	reserve_expressions(vec1.size());
+	for (int i = 0; i < int(vec1.size()); i++) {
+		int args[3] = { vec1[i], vec2[i], vec3[i] };
+		vec[i] = make_expression(OpITE, args, 3);
+	}
 	return vec;
 }
 
@@ -793,8 +870,11 @@ std::vector<int> ezSAT::vec_ite(int sel, const std::vector<int> &vec1, const std
 {
 	assert(vec1.size() == vec2.size());
 	std::vector<int> vec(vec1.size());
-	for (int i = 0; i < int(vec1.size()); i++)
-		vec[i] = ITE(sel, vec1[i], vec2[i]);
+	reserve_expressions(vec1.size());
+	for (int i = 0; i < int(vec1.size()); i++) {
+		int args[3] = { sel, vec1[i], vec2[i] };
+		vec[i] = make_expression(OpITE, args, 3);
+	}
 	return vec;
 }
 
@@ -1302,16 +1382,17 @@ void ezSAT::printInternalState(FILE *f) const
 	fprintf(f, "--8<-- snip --8<--\n");
 
 	fprintf(f, "literalsCache:\n");
-	for (auto &it : literalsCache)
-		fprintf(f, "    `%s' -> %d\n", it.first.c_str(), it.second);
+	for (int i = 0; i < int(literals.size()); i++)
+		if (literalsCache.count(literals[i]) && literalsCache.at(literals[i]) == i+1)
+			fprintf(f, "    `%s' -> %d\n", literals[i].c_str(), i+1);
 
 	fprintf(f, "literals:\n");
 	for (int i = 0; i < int(literals.size()); i++)
 		fprintf(f, "    %d: `%s'\n", i+1, literals[i].c_str());
 
 	fprintf(f, "expressionsCache:\n");
-	for (auto &it : expressionsCache)
-		fprintf(f, "    `%s' -> %d\n", expression2str(it.first).c_str(), it.second);
+	for (int i = 0; i < int(expressions.size()); i++)
+		fprintf(f, "    `%s' -> %d\n", expression2str(expressions[i]).c_str(), -i-1);
 
 	fprintf(f, "expressions:\n");
 	for (int i = 0; i < int(expressions.size()); i++)
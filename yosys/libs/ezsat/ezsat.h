@@ -22,6 +22,7 @@
 
 #include <set>
 #include <map>
+#include <unordered_map>
 #include <vector>
 #include <string>
 #include <stdio.h>
@@ -54,12 +55,19 @@ private:
 
 	bool non_incremental_solve_used_up;
 
-	std::map<std::string, int> literalsCache;
+	std::unordered_map<std::string, int> literalsCache;
 	std::vector<std::string> literals;
 
-	std::map<std::pair<OpId, std::vector<int>>, int> expressionsCache;
+	// expressions are hash-consed using an open addressing hash table with linear probing.
+	// each slot holds the id of an expression (or zero for an empty slot), the hash values
+	// of the expressions are stored separately so that the table can be resized quickly.
+	std::vector<int> expressionsTable;
+	std::vector<unsigned int> expressionsHash;
 	std::vector<std::pair<OpId, std::vector<int>>> expressions;
 
+	int make_expression(OpId op, int *args, int num_args);
+	void reserve_expressions(int num);
+
 	bool cnfConsumed;
 	int cnfVariableCount, cnfClausesCount;
 	std::vector<int> cnfLiteralVariables, cnfExpressionVariables;
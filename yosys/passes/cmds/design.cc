@@ -26,7 +26,9 @@ std::map<std::string, RTLIL::Design*> saved_designs;
 std::vector<RTLIL::Design*> pushed_designs;
 
 struct DesignPass : public Pass {
-	DesignPass() : Pass("design", "save, restore and reset current design") { }
+	DesignPass() : Pass("design", "save, restore and reset current design") {
+		handles_lazy_modules = true;
+	}
 	virtual ~DesignPass() {
 		for (auto &it : saved_designs)
 			delete it.second;
@@ -86,6 +88,13 @@ struct DesignPass : public Pass {
 		log("The Verilog front-end remembers defined macros and top-level declarations\n");
 		log("between calls to 'read_verilog'. This command resets this memory.\n");
 		log("\n");
+		log("\n");
+		log("Modules that are not materialized yet (see 'read_rtlil_bin -lazy') stay that\n");
+		log("way when a design is saved, loaded, pushed or popped. Every copy of such a\n");
+		log("module is created from the checkpoint when a command first uses it, instead\n");
+		log("of being cloned when the design is saved and loaded. The modules of both\n");
+		log("designs are materialized for -copy-from and -copy-to.\n");
+		log("\n");
 	}
 	virtual void execute(std::vector<std::string> args, RTLIL::Design *design)
 	{
@@ -169,6 +178,9 @@ struct DesignPass : public Pass {
 			if (copy_from_design != design && argidx == args.size())
 				cmd_error(args, argidx, "Missing selection.");
 
+			copy_from_design->materialize_all();
+			copy_to_design->materialize_all();
+
 			RTLIL::Selection sel = design->selection_stack.back();
 			if (argidx != args.size()) {
 				handle_extra_select_args(this, args, argidx, args.size(), copy_from_design);
@@ -218,6 +230,7 @@ struct DesignPass : public Pass {
 
 			for (auto &it : design->modules_)
 				design_copy->add(it.second->clone());
+			design_copy->lazy_modules_ = design->lazy_modules_;
 
 			design_copy->selection_stack = design->selection_stack;
 			design_copy->selection_vars = design->selection_vars;
@@ -237,6 +250,7 @@ struct DesignPass : public Pass {
 			for (auto &it : design->modules_)
 				delete it.second;
 			design->modules_.clear();
+			design->lazy_modules_.clear();
 
 			design->selection_stack.clear();
 			design->selection_vars.clear();
@@ -264,6 +278,7 @@ struct DesignPass : public Pass {
 
 			for (auto &it : saved_design->modules_)
 				design->add(it.second->clone());
+			design->lazy_modules_ = saved_design->lazy_modules_;
 
 			design->selection_stack = saved_design->selection_stack;
 			design->selection_vars = saved_design->selection_vars;
@@ -0,0 +1,474 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Clifford Wolf <clifford@clifford.at>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "kernel/yosys.h"
+#include "backends/ilang/ilang_backend.h"
+#include "backends/rtlil_bin/rtlil_bin_backend.h"
+#include "frontends/rtlil_bin/rtlil_bin_frontend.h"
+#include "libs/sha1/sha1.h"
+
+#ifndef _WIN32
+#  include <sys/types.h>
+#  include <sys/stat.h>
+#endif
+
+USING_YOSYS_NAMESPACE
+PRIVATE_NAMESPACE_BEGIN
+
+// Auto-generated names contain "$<autoidx>" after the last '$', optionally followed
+// by a suffix such as "_Y". The absolute autoidx values depend on everything that was
+// elaborated before the module, but their relative order within a module does not.
+// So we replace them by their rank in the module.
+int autoidx_suffix(RTLIL::IdString id, size_t *prefix_len = nullptr, size_t *suffix_pos = nullptr)
+{
+	const std::string &str = id.str();
+	size_t pos = str.rfind('$'), end = pos+1;
+
+	if (str[0] != '$' || pos == 0)
+		return -1;
+
+	while (end < str.size() && '0' <= str[end] && str[end] <= '9')
+		end++;
+
+	if (end == pos+1)
+		return -1;
+
+	if (prefix_len != nullptr)
+		*prefix_len = pos+1;
+	if (suffix_pos != nullptr)
+		*suffix_pos = end;
+	return atoi(str.c_str() + pos + 1);
+}
+
+void sort_switch_attributes(RTLIL::SwitchRule *sw);
+
+void sort_case_attributes(RTLIL::CaseRule *cs)
+{
+	for (auto sw : cs->switches)
+		sort_switch_attributes(sw);
+}
+
+void sort_switch_attributes(RTLIL::SwitchRule *sw)
+{
+	sw->attributes.sort(RTLIL::sort_by_id_str());
+	for (auto cs : sw->cases)
+		sort_case_attributes(cs);
+}
+
+// Create a textual representation of the module that does not depend on the
+// autoidx counter or on the order in which objects were added to the module.
+std::string canonical_dump(RTLIL::Module *module)
+{
+	RTLIL::Design *scratch = new RTLIL::Design;
+	RTLIL::Module *mod = module->clone();
+	scratch->add(mod);
+
+	std::set<int> indices;
+	for (auto wire : mod->wires())
+		indices.insert(autoidx_suffix(wire->name));
+	for (auto cell : mod->cells())
+		indices.insert(autoidx_suffix(cell->name));
+	for (auto &it : mod->memories)
+		indices.insert(autoidx_suffix(it.first));
+	for (auto &it : mod->processes)
+		indices.insert(autoidx_suffix(it.first));
+	indices.erase(-1);
+
+	dict<int, int> rank;
+	for (int idx : indices)
+		rank[idx] = GetSize(rank);
+
+	auto canonical_name = [&](RTLIL::IdString id) -> RTLIL::IdString {
+		size_t prefix_len, suffix_pos;
+		int idx = autoidx_suffix(id, &prefix_len, &suffix_pos);
+		if (idx < 0)
+			return id;
+		return id.str().substr(0, prefix_len) + stringf("%d", rank.at(idx)) + id.str().substr(suffix_pos);
+	};
+
+	// rename via temporary names so that intermediate names never collide
+	dict<RTLIL::Wire*, RTLIL::IdString> wire_names;
+	dict<RTLIL::Cell*, RTLIL::IdString> cell_names;
+	int tmp_idx = 0;
+
+	for (auto wire : mod->wires().to_vector())
+		if (autoidx_suffix(wire->name) >= 0) {
+			wire_names[wire] = canonical_name(wire->name);
+			mod->rename(wire, stringf("$incr_tmp$%d", tmp_idx++));
+		}
+
+	for (auto cell : mod->cells().to_vector())
+		if (autoidx_suffix(cell->name) >= 0) {
+			cell_names[cell] = canonical_name(cell->name);
+			mod->rename(cell, stringf("$incr_tmp$%d", tmp_idx++));
+		}
+
+	for (auto &it : wire_names)
+		mod->rename(it.first, it.second);
+
+	for (auto &it : cell_names)
+		mod->rename(it.first, it.second);
+
+	dict<RTLIL::IdString, RTLIL::Memory*> new_memories;
+	for (auto &it : mod->memories) {
+		it.second->name = canonical_name(it.first);
+		new_memories[it.second->name] = it.second;
+	}
+	mod->memories.swap(new_memories);
+
+	dict<RTLIL::IdString, RTLIL::Process*> new_processes;
+	for (auto &it : mod->processes) {
+		it.second->name = canonical_name(it.first);
+		new_processes[it.second->name] = it.second;
+	}
+	mod->processes.swap(new_processes);
+
+	mod->sort();
+	mod->attributes.sort(RTLIL::sort_by_id_str());
+	for (auto &it : mod->processes) {
+		it.second->attributes.sort(RTLIL::sort_by_id_str());
+		sort_case_attributes(&it.second->root_case);
+	}
+
+	std::stringstream buf;
+	ILANG_BACKEND::dump_module(buf, "", mod, scratch, false);
+	delete scratch;
+
+	return buf.str();
+}
+
+std::string port_signature(RTLIL::Module *module)
+{
+	std::string sig;
+	for (auto port : module->ports) {
+		RTLIL::Wire *wire = module->wire(port);
+		sig += stringf("%s %d %d %d %d %d %d\n", log_id(port), wire->width, wire->start_offset,
+				wire->upto, wire->port_input, wire->port_output, wire->port_id);
+	}
+	return sig;
+}
+
+// modules of binary checkpoints are only decoded when they are used if lazy is set
+void load_checkpoint(RTLIL::Design *design, std::string filename, bool lazy = false)
+{
+	std::ifstream f;
+	rewrite_filename(filename);
+	f.open(filename.c_str(), std::ifstream::binary);
+	if (f.fail())
+		log_cmd_error("Can't open checkpoint `%s'.\n", filename.c_str());
+
+	// checkpoints can be ilang or binary RTLIL files
+	char magic[8];
+	int len = strlen(RTLIL_BIN_BACKEND::magic);
+	f.read(magic, len);
+	bool binary = RTLIL_BIN_FRONTEND::RtlilBinFile::check_magic(magic, f.gcount());
+	f.clear();
+	f.seekg(0);
+
+	Frontend::frontend_call(design, &f, filename, binary ? (lazy ? "rtlil_bin -lazy" : "rtlil_bin") : "ilang");
+}
+
+// The key of a module in the synthesis cache. The netlist of a module only depends
+// on its own RTL, on the interfaces of its submodules (they are synthesized in
+// isolation) and on the flow that produces the netlist, described by the tag.
+std::string cache_key(RTLIL::Module *module, std::string tag)
+{
+	std::string str = stringf("%s\n%s\n", yosys_version_str, tag.c_str());
+
+	str += canonical_dump(module);
+
+	std::set<RTLIL::IdString> submodules;
+	for (auto cell : module->cells())
+		if (module->design->module(cell->type) != nullptr)
+			submodules.insert(cell->type);
+
+	for (auto type : submodules)
+		str += stringf("submodule %s\n", log_id(type)) + port_signature(module->design->module(type));
+
+	return sha1(str);
+}
+
+std::string cache_filename(std::string cache_dir, std::string key)
+{
+	return cache_dir + "/" + key + ".ilb";
+}
+
+void store_cache_entry(RTLIL::Module *module, std::string cache_dir, std::string key)
+{
+	// write to a temporary file first, so that concurrent runs sharing the cache
+	// never see partial entries
+	std::string tmp_filename = make_temp_file(cache_dir + "/.incremental_XXXXXX");
+	std::ofstream f(tmp_filename.c_str(), std::ofstream::binary);
+	if (f.fail())
+		log_cmd_error("Can't open cache file `%s' for writing: %s\n", tmp_filename.c_str(), strerror(errno));
+
+	RTLIL::Design *scratch = new RTLIL::Design;
+	scratch->add(module->clone());
+	std::string buf = RTLIL_BIN_BACKEND::dump_design(scratch, false);
+	f.write(buf.data(), buf.size());
+	delete scratch;
+
+	f.close();
+	if (f.fail() || rename(tmp_filename.c_str(), cache_filename(cache_dir, key).c_str()) != 0) {
+		remove(tmp_filename.c_str());
+		log_cmd_error("Can't write cache entry `%s'.\n", cache_filename(cache_dir, key).c_str());
+	}
+}
+
+struct IncrementalPass : public Pass {
+	IncrementalPass() : Pass("incremental", "reuse netlists of unchanged modules from a baseline run") { }
+	virtual void help()
+	{
+		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
+		log("\n");
+		log("    incremental [-rtl <filename> -netlist <filename>] [-cache <dir> [-tag <str>]]\n");
+		log("\n");
+		log("This command compares the (elaborated but not yet synthesized) modules in the\n");
+		log("current design against the modules of a baseline run. The netlist of every\n");
+		log("module that did not change is copied from the baseline netlist, replacing the\n");
+		log("RTL version of the module. The current selection is then set to the modules\n");
+		log("that changed, so that the following synthesis commands only process them.\n");
+		log("\n");
+		log("    -rtl <filename>\n");
+		log("        the design of the baseline run in ilang or binary RTLIL format (see\n");
+		log("        'write_rtlil_bin'), written at the same point in the flow as the\n");
+		log("        current design (e.g. directly after 'hierarchy -top').\n");
+		log("\n");
+		log("    -netlist <filename>\n");
+		log("        the hierarchical (not flattened) netlist of the baseline run in ilang\n");
+		log("        or binary RTLIL format.\n");
+		log("\n");
+		log("    -cache <dir>\n");
+		log("        look up the modules that are not reused from the baseline in a\n");
+		log("        persistent synthesis cache. The key of a module is the SHA1 hash of\n");
+		log("        its canonical RTL, the ports of its submodules, the Yosys version and\n");
+		log("        the tag. Modules that are not found in the cache are marked with an\n");
+		log("        'incremental_key' attribute, so that 'incremental -store' can add them\n");
+		log("        to the cache after synthesis.\n");
+		log("\n");
+		log("    -tag <str>\n");
+		log("        a string that identifies the synthesis flow, e.g. a hash of the\n");
+		log("        script and its parameters. Netlists produced by different flows must\n");
+		log("        use different tags.\n");
+		log("\n");
+		log("Two versions of a module are considered equal if they only differ in the\n");
+		log("values of the automatically generated $-names. A module is also considered\n");
+		log("changed when the ports of one of its submodules changed.\n");
+		log("\n");
+		log("\n");
+		log("    incremental -store -cache <dir>\n");
+		log("\n");
+		log("Add the netlists of all modules with an 'incremental_key' attribute to the\n");
+		log("cache and remove the attribute. The cache directory is created if necessary.\n");
+		log("\n");
+		log("Modules are synthesized in isolation in an incremental flow. So the design\n");
+		log("must not be flattened before technology mapping, as in the following example:\n");
+		log("\n");
+		log("    hierarchy -top top\n");
+		log("    write_rtlil_bin delta/rtl.ilb\n");
+		log("    incremental -rtl base/rtl.ilb -netlist base/netlist.ilb -cache cache\n");
+		log("    synth -run coarse; techmap; opt -fast; abc\n");
+		log("    select -clear\n");
+		log("    incremental -store -cache cache\n");
+		log("    write_rtlil_bin delta/netlist.ilb\n");
+		log("    flatten\n");
+		log("\n");
+	}
+	void store(RTLIL::Design *design, std::string cache_dir)
+	{
+#ifdef _WIN32
+		mkdir(cache_dir.c_str());
+#else
+		mkdir(cache_dir.c_str(), 0777);
+#endif
+
+		int stored_count = 0;
+		for (auto module : design->modules())
+		{
+			if (!module->attributes.count("\\incremental_key"))
+				continue;
+
+			std::string key = module->attributes.at("\\incremental_key").decode_string();
+			module->attributes.erase("\\incremental_key");
+
+			log("Storing netlist of module %s as %s.\n", log_id(module), key.c_str());
+			store_cache_entry(module, cache_dir, key);
+			stored_count++;
+		}
+
+		log("Stored %d modules in the cache.\n", stored_count);
+	}
+	virtual void execute(std::vector<std::string> args, RTLIL::Design *design)
+	{
+		std::string rtl_filename, netlist_filename, cache_dir, tag;
+		bool store_mode = false;
+
+		log_header(design, "Executing INCREMENTAL pass (reuse netlists from baseline).\n");
+
+		size_t argidx;
+		for (argidx = 1; argidx < args.size(); argidx++) {
+			if (args[argidx] == "-rtl" && argidx+1 < args.size()) {
+				rtl_filename = args[++argidx];
+				continue;
+			}
+			if (args[argidx] == "-netlist" && argidx+1 < args.size()) {
+				netlist_filename = args[++argidx];
+				continue;
+			}
+			if (args[argidx] == "-cache" && argidx+1 < args.size()) {
+				cache_dir = args[++argidx];
+				rewrite_filename(cache_dir);
+				continue;
+			}
+			if (args[argidx] == "-tag" && argidx+1 < args.size()) {
+				tag = args[++argidx];
+				continue;
+			}
+			if (args[argidx] == "-store") {
+				store_mode = true;
+				continue;
+			}
+			break;
+		}
+		extra_args(args, argidx, design, false);
+
+		if (store_mode) {
+			if (cache_dir.empty())
+				log_cmd_error("Option -store requires -cache.\n");
+			store(design, cache_dir);
+			return;
+		}
+
+		if (rtl_filename.empty() != netlist_filename.empty())
+			log_cmd_error("Options -rtl and -netlist must be used together.\n");
+
+		if (rtl_filename.empty() && cache_dir.empty())
+			log_cmd_error("Neither a baseline nor a cache was specified.\n");
+
+		RTLIL::Design *base_rtl = new RTLIL::Design;
+		RTLIL::Design *base_netlist = new RTLIL::Design;
+
+		if (!rtl_filename.empty()) {
+			log_push();
+			load_checkpoint(base_rtl, rtl_filename, true);
+			load_checkpoint(base_netlist, netlist_filename, true);
+			log_pop();
+		}
+
+		pool<RTLIL::IdString> changed, changed_ports;
+		int reused_count = 0, cached_count = 0;
+
+		for (auto module : design->modules())
+		{
+			if (module->get_bool_attribute("\\blackbox"))
+				continue;
+
+			if (rtl_filename.empty()) {
+				changed.insert(module->name);
+				continue;
+			}
+
+			RTLIL::Module *old_rtl = base_rtl->module(module->name);
+
+			if (old_rtl == nullptr || !base_netlist->has(module->name)) {
+				log("Module %s is not in the baseline.\n", log_id(module));
+				changed.insert(module->name);
+				continue;
+			}
+
+			if (canonical_dump(module) != canonical_dump(old_rtl)) {
+				log("Module %s has changed.\n", log_id(module));
+				changed.insert(module->name);
+				if (port_signature(module) != port_signature(old_rtl))
+					changed_ports.insert(module->name);
+			}
+		}
+
+		for (auto module : design->modules().to_vector())
+		{
+			if (module->get_bool_attribute("\\blackbox") || changed.count(module->name))
+				continue;
+
+			for (auto cell : module->cells())
+				if (changed_ports.count(cell->type)) {
+					log("Module %s has changed ports in submodule %s.\n", log_id(module), log_id(cell->type));
+					changed.insert(module->name);
+					break;
+				}
+
+			if (changed.count(module->name))
+				continue;
+
+			log("Reusing baseline netlist for module %s.\n", log_id(module));
+			RTLIL::Module *new_mod = base_netlist->module(module->name)->clone();
+			design->remove(module);
+			design->add(new_mod);
+			reused_count++;
+		}
+
+		if (!cache_dir.empty())
+		{
+			// compute all keys before replacing any module, as the keys depend on the
+			// ports of the submodules in their RTL version
+			dict<RTLIL::IdString, std::string> keys;
+			for (auto name : changed)
+				keys[name] = cache_key(design->module(name), tag);
+
+			for (auto &it : keys)
+			{
+				RTLIL::Module *module = design->module(it.first);
+				std::string filename = cache_filename(cache_dir, it.second);
+
+				if (!check_file_exists(filename)) {
+					module->attributes["\\incremental_key"] = RTLIL::Const(it.second);
+					continue;
+				}
+
+				RTLIL::Design *entry = new RTLIL::Design;
+				log_push();
+				load_checkpoint(entry, filename);
+				log_pop();
+
+				if (GetSize(entry->modules_) != 1 || entry->module(module->name) == nullptr)
+					log_cmd_error("Cache entry `%s' does not contain module %s.\n", filename.c_str(), log_id(module));
+
+				log("Using cached netlist %s for module %s.\n", it.second.c_str(), log_id(module));
+				RTLIL::Module *new_mod = entry->module(module->name)->clone();
+				design->remove(module);
+				design->add(new_mod);
+				changed.erase(it.first);
+				cached_count++;
+				delete entry;
+			}
+		}
+
+		log("Reused %d modules, %d modules found in cache, %d modules need to be synthesized.\n",
+				reused_count, cached_count, GetSize(changed));
+
+		RTLIL::Selection sel(false);
+		for (auto name : changed)
+			sel.selected_modules.insert(name);
+		design->selection_stack.back() = sel;
+
+		delete base_rtl;
+		delete base_netlist;
+	}
+} IncrementalPass;
+
+PRIVATE_NAMESPACE_END
@@ -179,6 +179,9 @@ struct EquivInductPass : public Pass {
 		log("    -seq <N>\n");
 		log("        the max. number of time steps to be considered (default = 4)\n");
 		log("\n");
+		log("    -j <N>\n");
+		log("        process the selected modules in parallel using N threads\n");
+		log("\n");
 		log("This command is very effective in proving complex sequential circuits, when\n");
 		log("the internal state of the circuit quickly propagates to $equiv cells.\n");
 		log("\n");
@@ -194,9 +197,10 @@ struct EquivInductPass : public Pass {
 	}
 	virtual void execute(std::vector<std::string> args, Design *design)
 	{
-		int success_counter = 0;
+		std::atomic<int> success_counter(0);
 		bool model_undef = false;
 		int max_seq = 4;
+		int num_threads = 0;
 
 		log_header(design, "Executing EQUIV_INDUCT pass.\n");
 
@@ -210,11 +214,15 @@ struct EquivInductPass : public Pass {
 				max_seq = atoi(args[++argidx].c_str());
 				continue;
 			}
+			if (args[argidx] == "-j" && argidx+1 < args.size()) {
+				num_threads = std::max(atoi(args[++argidx].c_str()), 1);
+				continue;
+			}
 			break;
 		}
 		extra_args(args, argidx, design);
 
-		for (auto module : design->selected_modules())
+		parallel_for_modules(design->selected_modules(), num_threads, [&](Module *module)
 		{
 			pool<Cell*> unproven_equiv_cells;
 
@@ -226,15 +234,15 @@ struct EquivInductPass : public Pass {
 
 			if (unproven_equiv_cells.empty()) {
 				log("No selected unproven $equiv cells found in %s.\n", log_id(module));
-				continue;
+				return;
 			}
 
 			EquivInductWorker worker(module, unproven_equiv_cells, model_undef, max_seq);
 			worker.run();
 			success_counter += worker.success_counter;
-		}
+		});
 
-		log("Proved %d previously unproven $equiv cells.\n", success_counter);
+		log("Proved %d previously unproven $equiv cells.\n", int(success_counter));
 	}
 } EquivInductPass;
 
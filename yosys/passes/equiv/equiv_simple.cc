@@ -19,6 +19,9 @@
 
 #include "kernel/yosys.h"
 #include "kernel/satgen.h"
+#include "kernel/bitsim.h"
+#include <mutex>
+#include <thread>
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
@@ -31,6 +34,7 @@ struct EquivSimpleWorker
 
 	SigMap &sigmap;
 	dict<SigBit, Cell*> &bit2driver;
+	const pool<IdString> &sim_failed;
 
 	ezSatPtr ez;
 	SatGen satgen;
@@ -39,9 +43,9 @@ struct EquivSimpleWorker
 
 	pool<pair<Cell*, int>> imported_cells_cache;
 
-	EquivSimpleWorker(const vector<Cell*> &equiv_cells, SigMap &sigmap, dict<SigBit, Cell*> &bit2driver, int max_seq, bool verbose, bool model_undef) :
+	EquivSimpleWorker(const vector<Cell*> &equiv_cells, SigMap &sigmap, dict<SigBit, Cell*> &bit2driver, const pool<IdString> &sim_failed, int max_seq, bool verbose, bool model_undef) :
 			module(equiv_cells.front()->module), equiv_cells(equiv_cells), equiv_cell(nullptr),
-			sigmap(sigmap), bit2driver(bit2driver), satgen(ez.get(), &sigmap), max_seq(max_seq), verbose(verbose)
+			sigmap(sigmap), bit2driver(bit2driver), sim_failed(sim_failed), satgen(ez.get(), &sigmap), max_seq(max_seq), verbose(verbose)
 	{
 		satgen.model_undef = model_undef;
 	}
@@ -91,6 +95,15 @@ struct EquivSimpleWorker
 	{
 		SigBit bit_a = sigmap(equiv_cell->getPort("\\A")).as_bit();
 		SigBit bit_b = sigmap(equiv_cell->getPort("\\B")).as_bit();
+
+		if (sim_failed.count(equiv_cell->name)) {
+			if (verbose)
+				log("  Simulation found a counterexample for $equiv cell %s.\n", log_id(equiv_cell));
+			else
+				log("  Trying to prove $equiv for %s: failed (simulation).\n", log_signal(equiv_cell->getPort("\\Y")));
+			return false;
+		}
+
 		int ez_context = ez->frozen_literal();
 
 		if (satgen.model_undef)
@@ -248,6 +261,181 @@ struct EquivSimpleWorker
 
 };
 
+void find_drivers(Module *module, SigMap &sigmap, CellTypes &ct, dict<SigBit, Cell*> &bit2driver)
+{
+	for (auto cell : module->cells()) {
+		if (!ct.cell_known(cell->type) && !cell->type.in("$dff", "$_DFF_P_", "$_DFF_N_", "$ff", "$_FF_"))
+			continue;
+		for (auto &conn : cell->connections())
+			if (yosys_celltypes.cell_output(cell->type, conn.first))
+				for (auto bit : sigmap(conn.second))
+					bit2driver[bit] = cell;
+	}
+}
+
+// simulate max_seq+1 time steps, starting with random register values. a pattern
+// with different values for A and B of an $equiv cell is a model for all of the
+// SAT problems of EquivSimpleWorker::run_cell() (each of them is a relaxation of
+// the simulated one), so the cell can't be proven.
+void simulate_module(pool<IdString> &sim_failed, Module *module, SigMap &sigmap, const dict<SigBit, Cell*> &bit2driver,
+		const vector<vector<Cell*>> &groups, int max_seq)
+{
+	BitSim sim(&sigmap);
+
+	vector<pair<SigBit, SigBit>> ff_bits;
+	pool<Cell*> cells;
+
+	for (auto &it : bit2driver)
+		cells.insert(it.second);
+
+	for (auto cell : module->cells()) {
+		if (!cells.count(cell))
+			continue;
+		if (cell->type.in("$dff", "$_DFF_P_", "$_DFF_N_", "$ff", "$_FF_")) {
+			SigSpec sig_d = sigmap(cell->getPort("\\D"));
+			SigSpec sig_q = sigmap(cell->getPort("\\Q"));
+			for (int i = 0; i < GetSize(sig_q); i++)
+				ff_bits.push_back(pair<SigBit, SigBit>(sig_q[i], sig_d[i]));
+			sim.add_signal(sig_d);
+			sim.add_signal(sig_q);
+		} else
+			sim.add_cell(cell);
+	}
+
+	vector<uint64_t> ff_values, ff_undefs;
+
+	for (int step = 0; step <= max_seq; step++)
+	{
+		sim.randomize();
+
+		for (int i = 0; i < GetSize(ff_values); i++)
+			sim.set(ff_bits[i / sim.num_words].first, i % sim.num_words, ff_values[i], ff_undefs[i]);
+
+		sim.simulate();
+
+		ff_values.clear();
+		ff_undefs.clear();
+
+		for (auto &it : ff_bits)
+			for (int w = 0; w < sim.num_words; w++) {
+				ff_values.push_back(sim.get(it.second, w));
+				ff_undefs.push_back(sim.get_undef(it.second, w));
+			}
+	}
+
+	for (auto &cells : groups)
+		for (auto cell : cells) {
+			SigBit bit_a = sigmap(cell->getPort("\\A")).as_bit();
+			SigBit bit_b = sigmap(cell->getPort("\\B")).as_bit();
+			for (int w = 0; w < sim.num_words; w++)
+				if (((sim.get(bit_a, w) ^ sim.get(bit_b, w)) & ~(sim.get_undef(bit_a, w) | sim.get_undef(bit_b, w))) != 0) {
+					sim_failed.insert(cell->name);
+					break;
+				}
+		}
+}
+
+// prove the groups of $equiv cells in parallel. every thread works on its own copy of the
+// module, because SigMap, SigSpec and the hashlib containers update cached data in their
+// const methods. the proven cells are marked afterwards, in the order of the groups.
+int prove_parallel(Module *module, CellTypes &ct, const vector<vector<Cell*>> &groups, const pool<IdString> &sim_failed,
+		int num_threads, int max_seq, bool verbose, bool model_undef)
+{
+	struct ThreadContext {
+		Module *module;
+		SigMap sigmap;
+		dict<SigBit, Cell*> bit2driver;
+	};
+
+	int num_jobs = GetSize(groups);
+	num_threads = std::min(num_threads, num_jobs);
+
+	vector<ThreadContext> contexts(num_threads);
+	for (auto &ctx : contexts) {
+		ctx.module = module->clone();
+		ctx.sigmap.set(ctx.module);
+		find_drivers(ctx.module, ctx.sigmap, ct, ctx.bit2driver);
+	}
+
+	// a lookup may rehash the pool, do that now and not in the threads
+	sim_failed.count(IdString());
+
+	std::mutex slots_mutex;
+	std::map<std::thread::id, int> slots;
+
+	vector<std::string> job_logs(num_jobs);
+	vector<log_thread_error_exception> job_errors(num_jobs);
+	vector<char> job_failed(num_jobs);
+	vector<vector<IdString>> job_proven(num_jobs);
+
+	auto job = [&](int k) {
+		ThreadContext *ctx;
+		{
+			std::lock_guard<std::mutex> lock(slots_mutex);
+			auto it = slots.find(std::this_thread::get_id());
+			if (it == slots.end())
+				it = slots.insert(std::pair<std::thread::id, int>(std::this_thread::get_id(), GetSize(slots))).first;
+			ctx = &contexts.at(it->second);
+		}
+		log_thread_buffer = &job_logs[k];
+		RTLIL::IdString::set_thread_job(k);
+		try {
+			vector<Cell*> cells;
+			for (auto cell : groups[k])
+				cells.push_back(ctx->module->cell(cell->name));
+			EquivSimpleWorker worker(cells, ctx->sigmap, ctx->bit2driver, sim_failed, max_seq, verbose, model_undef);
+			worker.run();
+			for (auto cell : cells)
+				if (cell->getPort("\\A") == cell->getPort("\\B"))
+					job_proven[k].push_back(cell->name);
+		} catch (log_thread_error_exception &e) {
+			job_errors[k] = e;
+			job_failed[k] = true;
+		} catch (...) {
+			log_id_cache_clear();
+			RTLIL::IdString::set_thread_job(-1);
+			log_thread_buffer = nullptr;
+			throw;
+		}
+		log_id_cache_clear();
+		RTLIL::IdString::set_thread_job(-1);
+		log_thread_buffer = nullptr;
+	};
+
+	log_id_cache_clear();
+	RTLIL::IdString::begin_threaded(num_jobs);
+
+	try {
+		parallel_for(num_jobs, num_threads, job);
+	} catch (...) {
+		RTLIL::IdString::end_threaded();
+		for (auto &ctx : contexts)
+			delete ctx.module;
+		throw;
+	}
+
+	RTLIL::IdString::end_threaded();
+
+	for (auto &ctx : contexts)
+		delete ctx.module;
+
+	int counter = 0;
+	for (int k = 0; k < num_jobs; k++) {
+		log("%s", job_logs[k].c_str());
+		if (job_failed[k]) {
+			if (job_errors[k].cmd_error)
+				log_cmd_error("%s", job_errors[k].message.c_str());
+			log_error("%s", job_errors[k].message.c_str());
+		}
+		for (auto name : job_proven[k]) {
+			Cell *cell = module->cell(name);
+			cell->setPort("\\B", cell->getPort("\\A"));
+			counter++;
+		}
+	}
+	return counter;
+}
+
 struct EquivSimplePass : public Pass {
 	EquivSimplePass() : Pass("equiv_simple", "try proving simple $equiv instances") { }
 	virtual void help()
@@ -270,12 +458,22 @@ struct EquivSimplePass : public Pass {
 		log("    -seq <N>\n");
 		log("        the max. number of time steps to be considered (default = 1)\n");
 		log("\n");
+		log("    -nosim\n");
+		log("        do not use random simulation to find $equiv cells that can't be\n");
+		log("        proven before calling the SAT solver\n");
+		log("\n");
+		log("    -j <N>\n");
+		log("        prove the groups of $equiv cells in parallel using N threads, each\n");
+		log("        with its own SAT solver. The result and the log output do not\n");
+		log("        depend on N.\n");
+		log("\n");
 	}
 	virtual void execute(std::vector<std::string> args, Design *design)
 	{
-		bool verbose = false, model_undef = false, nogroup = false;
+		bool verbose = false, model_undef = false, nogroup = false, nosim = false;
 		int success_counter = 0;
 		int max_seq = 1;
+		int num_threads = 0;
 
 		log_header(design, "Executing EQUIV_SIMPLE pass.\n");
 
@@ -297,6 +495,14 @@ struct EquivSimplePass : public Pass {
 				max_seq = atoi(args[++argidx].c_str());
 				continue;
 			}
+			if (args[argidx] == "-nosim") {
+				nosim = true;
+				continue;
+			}
+			if (args[argidx] == "-j" && argidx+1 < args.size()) {
+				num_threads = std::max(atoi(args[++argidx].c_str()), 1);
+				continue;
+			}
 			break;
 		}
 		extra_args(args, argidx, design);
@@ -328,15 +534,9 @@ struct EquivSimplePass : public Pass {
 			log("Found %d unproven $equiv cells (%d groups) in %s:\n",
 					unproven_cells_counter, GetSize(unproven_equiv_cells), log_id(module));
 
-			for (auto cell : module->cells()) {
-				if (!ct.cell_known(cell->type) && !cell->type.in("$dff", "$_DFF_P_", "$_DFF_N_", "$ff", "$_FF_"))
-					continue;
-				for (auto &conn : cell->connections())
-					if (yosys_celltypes.cell_output(cell->type, conn.first))
-						for (auto bit : sigmap(conn.second))
-							bit2driver[bit] = cell;
-			}
+			find_drivers(module, sigmap, ct, bit2driver);
 
+			vector<vector<Cell*>> groups;
 			unproven_equiv_cells.sort();
 			for (auto it : unproven_equiv_cells)
 			{
@@ -345,8 +545,20 @@ struct EquivSimplePass : public Pass {
 				vector<Cell*> cells;
 				for (auto it2 : it.second)
 					cells.push_back(it2.second);
+				groups.push_back(cells);
+			}
+
+			pool<IdString> sim_failed;
+			if (!nosim)
+				simulate_module(sim_failed, module, sigmap, bit2driver, groups, max_seq);
+
+			if (num_threads > 0 && GetSize(groups) > 1) {
+				success_counter += prove_parallel(module, ct, groups, sim_failed, num_threads, max_seq, verbose, model_undef);
+				continue;
+			}
 
-				EquivSimpleWorker worker(cells, sigmap, bit2driver, max_seq, verbose, model_undef);
+			for (auto &cells : groups) {
+				EquivSimpleWorker worker(cells, sigmap, bit2driver, sim_failed, max_seq, verbose, model_undef);
 				success_counter += worker.run();
 			}
 		}
@@ -27,6 +27,7 @@
 #include "kernel/sigtools.h"
 #include "kernel/consteval.h"
 #include "kernel/celltypes.h"
+#include "kernel/bitsim.h"
 #include "fsmdata.h"
 
 USING_YOSYS_NAMESPACE
@@ -253,6 +254,464 @@ undef_bit_in_next_state:
 	}
 }
 
+// A bit-parallel version of find_transitions(): the ctrl output and next state
+// logic is simulated with BitSim, with one cube (a partial assignment of the
+// ctrl inputs, the unassigned inputs are undef) per pattern. A cube for which
+// an output is still undef is split on the ctrl input found by tracing the
+// undef output back to the inputs, like find_transitions() splits on the stop
+// signal ConstEval runs into. sweep() returns false if a cube can't be
+// resolved that way (e.g. because of undef constants or cells that BitSim
+// can't simulate) and find_transitions() is used for the state instead.
+struct TransitionSweep
+{
+	static const int num_words = 16;
+
+	BitSim sim;
+	RTLIL::SigSpec ctrl_in, ctrl_out, dff_in, dff_out;
+	std::vector<int> ctrl_in_sig, ctrl_out_sig, dff_in_sig, dff_out_sig;
+	std::vector<int> driver;
+	dict<int, int> var_index;
+	dict<RTLIL::SigBit, int> ctrl_in_index;
+	std::vector<bool> fixed, not_one;
+	std::vector<int> active_cells;
+	bool ok;
+
+	TransitionSweep(RTLIL::SigSpec ctrl_in, RTLIL::SigSpec ctrl_out, RTLIL::SigSpec dff_in, RTLIL::SigSpec dff_out) :
+			sim(&assign_map, num_words), ctrl_in(ctrl_in), ctrl_out(ctrl_out), dff_in(dff_in), dff_out(dff_out)
+	{
+		CellTypes ct;
+		ct.setup_internals();
+		ct.setup_stdcells();
+
+		dict<RTLIL::SigBit, RTLIL::Cell*> bit2driver;
+		for (auto cell : module->cells()) {
+			if (!ct.cell_known(cell->type))
+				continue;
+			for (auto &conn : cell->connections())
+				if (ct.cell_output(cell->type, conn.first))
+					for (auto bit : assign_map(conn.second))
+						if (bit.wire != nullptr)
+							bit2driver[bit] = cell;
+		}
+
+		pool<RTLIL::SigBit> visited;
+		for (auto bit : assign_map(ctrl_in))
+			visited.insert(bit);
+		for (auto bit : assign_map(dff_out))
+			visited.insert(bit);
+
+		std::vector<RTLIL::SigBit> queue;
+		for (auto bit : assign_map(ctrl_out))
+			queue.push_back(bit);
+		for (auto bit : assign_map(dff_in))
+			queue.push_back(bit);
+
+		while (!queue.empty())
+		{
+			RTLIL::SigBit bit = queue.back();
+			queue.pop_back();
+
+			if (bit.wire == nullptr || visited.count(bit))
+				continue;
+			visited.insert(bit);
+
+			if (bit2driver.count(bit) == 0)
+				continue;
+
+			RTLIL::Cell *cell = bit2driver.at(bit);
+			sim.add_cell(cell);
+			for (auto &conn : cell->connections())
+				if (!ct.cell_output(cell->type, conn.first))
+					for (auto in_bit : assign_map(conn.second))
+						queue.push_back(in_bit);
+		}
+
+		ctrl_in_sig = sim.signal(ctrl_in);
+		ctrl_out_sig = sim.signal(ctrl_out);
+		dff_in_sig = sim.signal(dff_in);
+		dff_out_sig = sim.signal(dff_out);
+		sim.setup();
+
+		driver.resize(GetSize(sim.values) / num_words, -1);
+		for (int i = 0; i < GetSize(sim.cells); i++)
+			for (int sig : sim.cells[i].y)
+				if (sig > 2)
+					driver[sig] = i;
+
+		// ctrl inputs driven by a cell in the cone (e.g. by another output of
+		// a multi-bit cell) are not supported
+		ok = true;
+		for (int i = 0; i < GetSize(ctrl_in_sig); i++) {
+			if (ctrl_in_sig[i] > 2 && driver[ctrl_in_sig[i]] < 0)
+				var_index[ctrl_in_sig[i]] = i;
+			else
+				ok = false;
+			ctrl_in_index[ctrl_in[i]] = i;
+		}
+	}
+
+	bool undef(int sig, int w, uint64_t mask) const
+	{
+		return (sim.undefs[sig*num_words + w] & mask) != 0;
+	}
+
+	bool value(int sig, int w, uint64_t mask) const
+	{
+		return (sim.values[sig*num_words + w] & mask) != 0;
+	}
+
+	// follow the undef signal sig back to an undef input and return the index
+	// of that input in ctrl_in, or -1 if it isn't a ctrl input
+	int trace_undef(int sig, int w, uint64_t mask) const
+	{
+		while (sig > 2 && driver[sig] >= 0)
+		{
+			const BitSim::SimCell &sc = sim.cells[driver[sig]];
+			int next_sig = -1;
+
+			int pos = 0;
+			while (pos < GetSize(sc.y) && sc.y[pos] != sig)
+				pos++;
+
+			switch (sc.op)
+			{
+			case BitSim::OP_NONE:
+				return -1;
+
+			case BitSim::OP_BUF:
+			case BitSim::OP_NOT:
+			case BitSim::OP_AND:
+			case BitSim::OP_NAND:
+			case BitSim::OP_OR:
+			case BitSim::OP_NOR:
+			case BitSim::OP_XOR:
+			case BitSim::OP_XNOR:
+			case BitSim::OP_ANDNOT:
+			case BitSim::OP_ORNOT:
+				if (undef(sc.a[pos], w, mask))
+					next_sig = sc.a[pos];
+				else if (!sc.b.empty() && undef(sc.b[pos], w, mask))
+					next_sig = sc.b[pos];
+				break;
+
+			case BitSim::OP_MUX:
+				if (undef(sc.s[0], w, mask))
+					next_sig = sc.s[0];
+				else
+					next_sig = value(sc.s[0], w, mask) ? sc.b[pos] : sc.a[pos];
+				break;
+
+			case BitSim::OP_PMUX: {
+				int width = GetSize(sc.y), selected = -1;
+				for (int k = 0; k < GetSize(sc.s) && next_sig < 0; k++) {
+					if (undef(sc.s[k], w, mask))
+						next_sig = sc.s[k];
+					else if (value(sc.s[k], w, mask)) {
+						if (selected >= 0)
+							return -1;
+						selected = k;
+					}
+				}
+				if (next_sig < 0)
+					next_sig = selected < 0 ? sc.a[pos] : sc.b[selected*width + pos];
+				break;
+			}
+
+			default:
+				for (auto vec : {&sc.a, &sc.b, &sc.c, &sc.d, &sc.s})
+					for (int s : *vec)
+						if (next_sig < 0 && undef(s, w, mask))
+							next_sig = s;
+				break;
+			}
+
+			if (next_sig < 0)
+				return -1;
+			sig = next_sig;
+		}
+
+		return var_index.count(sig) ? var_index.at(sig) : -1;
+	}
+
+	// find the ctrl inputs that have a constant value in this state (see the
+	// ce_nostop case in find_transitions()) and the ctrl inputs that can't be
+	// one because an exclusive signal is not zero in this state. returns false
+	// if the state is contradictory or if an exclusive signal that isn't
+	// constant is used by the simulated logic (find_transitions() would set
+	// it to zero).
+	bool find_fixed_inputs(ConstEval &ce_nostop, RTLIL::Const &cube)
+	{
+		fixed.assign(GetSize(ctrl_in), false);
+		not_one.assign(GetSize(ctrl_in), false);
+
+		for (int i = 0; i < GetSize(ctrl_in); i++) {
+			RTLIL::SigSpec sig = ctrl_in[i];
+			if (ce_nostop.eval(sig)) {
+				if (!sig.is_fully_def())
+					return false;
+				cube.bits[i] = sig.as_const().bits[0];
+				fixed[i] = true;
+			}
+			if (exclusive_ctrls.count(ctrl_in[i]))
+				for (auto &bit : exclusive_ctrls.at(ctrl_in[i])) {
+					if (ctrl_in_index.count(bit))
+						continue;
+					RTLIL::SigSpec bitval = bit;
+					if (!ce_nostop.eval(bitval)) {
+						if (sim.known(bit))
+							return false;
+					} else if (bitval != RTLIL::State::S0)
+						not_one[i] = true;
+				}
+		}
+
+		for (int i = 0; i < GetSize(ctrl_in); i++)
+			if (fixed[i] && cube.bits[i] == RTLIL::State::S1 && !set_exclusive(cube, i))
+				return false;
+
+		return true;
+	}
+
+	// set the ctrl inputs that are exclusive to ctrl input i to zero. returns
+	// false on a contradiction.
+	bool set_exclusive(RTLIL::Const &cube, int i)
+	{
+		if (not_one[i])
+			return false;
+
+		if (exclusive_ctrls.count(ctrl_in[i]) == 0)
+			return true;
+
+		for (auto &bit : exclusive_ctrls.at(ctrl_in[i])) {
+			if (ctrl_in_index.count(bit) == 0)
+				continue;
+			int j = ctrl_in_index.at(bit);
+			if (cube.bits[j] == RTLIL::State::Sx && !fixed[j])
+				cube.bits[j] = RTLIL::State::S0;
+			else if (cube.bits[j] != RTLIL::State::S0)
+				return false;
+		}
+
+		return true;
+	}
+
+	// find the cells that need to be simulated in this state: the cells with
+	// undef outputs (with all ctrl inputs undef) that are used by the outputs,
+	// not following the unselected inputs of multiplexers with a constant
+	// select input
+	void find_active_cells()
+	{
+		std::vector<bool> active(GetSize(sim.cells));
+		std::vector<int> queue;
+
+		for (auto vec : {&ctrl_out_sig, &dff_in_sig})
+			for (int sig : *vec)
+				queue.push_back(sig);
+
+		while (!queue.empty())
+		{
+			int sig = queue.back();
+			queue.pop_back();
+
+			if (sig <= 2 || driver[sig] < 0 || active[driver[sig]] || !undef(sig, 0, 1))
+				continue;
+
+			const BitSim::SimCell &sc = sim.cells[driver[sig]];
+			active[driver[sig]] = true;
+
+			if (sc.op == BitSim::OP_MUX && !undef(sc.s[0], 0, 1)) {
+				for (int s : value(sc.s[0], 0, 1) ? sc.b : sc.a)
+					queue.push_back(s);
+				continue;
+			}
+
+			if (sc.op == BitSim::OP_PMUX) {
+				int width = GetSize(sc.y), selected = -1;
+				bool select_undef = false;
+				for (int k = 0; k < GetSize(sc.s); k++) {
+					if (undef(sc.s[k], 0, 1))
+						select_undef = true;
+					else if (value(sc.s[k], 0, 1))
+						selected = selected < 0 ? k : GetSize(sc.s);
+				}
+				if (!select_undef && selected < GetSize(sc.s)) {
+					for (int i = 0; i < width; i++)
+						queue.push_back(selected < 0 ? sc.a[i] : sc.b[selected*width + i]);
+					continue;
+				}
+			}
+
+			for (auto vec : {&sc.a, &sc.b, &sc.c, &sc.d, &sc.s})
+				for (int s : *vec)
+					queue.push_back(s);
+		}
+
+		active_cells.clear();
+		for (int i = 0; i < GetSize(sim.cells); i++)
+			if (active[i])
+				active_cells.push_back(i);
+	}
+
+	bool sweep(ConstEval &ce_nostop, FsmData &fsm_data, std::map<RTLIL::Const, int> &states, int state_in)
+	{
+		RTLIL::Const initial_cube(RTLIL::State::Sx, GetSize(ctrl_in));
+
+		if (!ok || !find_fixed_inputs(ce_nostop, initial_cube))
+			return false;
+
+		const RTLIL::Const &state_value = fsm_data.state_table.at(state_in);
+		for (int i = 0; i < GetSize(dff_out_sig); i++)
+			if (dff_out_sig[i] > 2)
+				for (int w = 0; w < num_words; w++) {
+					sim.values[dff_out_sig[i]*num_words + w] = state_value.bits[i] == RTLIL::State::S1 ? ~uint64_t(0) : 0;
+					sim.undefs[dff_out_sig[i]*num_words + w] = state_value.bits[i] == RTLIL::State::S1 ||
+							state_value.bits[i] == RTLIL::State::S0 ? 0 : ~uint64_t(0);
+				}
+
+		for (auto &it : var_index) {
+			RTLIL::State bit = initial_cube.bits[it.second];
+			for (int w = 0; w < num_words; w++) {
+				sim.values[it.first*num_words + w] = bit == RTLIL::State::S1 ? ~uint64_t(0) : 0;
+				sim.undefs[it.first*num_words + w] = bit == RTLIL::State::S0 || bit == RTLIL::State::S1 ? 0 : ~uint64_t(0);
+			}
+		}
+
+		// the signals that are not driven by active cells have the same value
+		// in all words
+		sim.simulate(0);
+		find_active_cells();
+		for (int idx : active_cells)
+			for (auto vec : {&sim.cells[idx].a, &sim.cells[idx].b, &sim.cells[idx].c, &sim.cells[idx].d, &sim.cells[idx].s})
+				for (int sig : *vec)
+					for (int w = 1; w < num_words; w++) {
+						sim.values[sig*num_words + w] = sim.values[sig*num_words];
+						sim.undefs[sig*num_words + w] = sim.undefs[sig*num_words];
+					}
+
+		// the cubes are split breadth first, the path (the sequence of the
+		// values the cube has been split on) is used to sort the transitions
+		// in the order find_transitions() would find them
+		struct leaf_t {
+			std::string path, message;
+			bool valid;
+			FsmData::transition_t tr;
+			bool operator<(const leaf_t &other) const { return path < other.path; }
+		};
+
+		std::vector<leaf_t> leaves;
+		std::vector<std::pair<RTLIL::Const, std::string>> cubes, next_cubes;
+		cubes.push_back(std::make_pair(initial_cube, std::string()));
+
+		while (!cubes.empty())
+		{
+			for (int offset = 0; offset < GetSize(cubes); offset += 64*num_words)
+			{
+				int num_cubes = min(GetSize(cubes) - offset, 64*num_words);
+				int used_words = (num_cubes + 63) / 64;
+
+				for (int i = 0; i < GetSize(ctrl_in_sig); i++) {
+					if (var_index.count(ctrl_in_sig[i]) == 0 || var_index.at(ctrl_in_sig[i]) != i)
+						continue;
+					for (int w = 0; w < used_words; w++) {
+						uint64_t value = 0, undef = 0;
+						for (int lane = 0; lane < 64 && 64*w + lane < num_cubes; lane++) {
+							RTLIL::State bit = cubes[offset + 64*w + lane].first.bits[i];
+							if (bit == RTLIL::State::S1)
+								value |= uint64_t(1) << lane;
+							else if (bit != RTLIL::State::S0)
+								undef |= uint64_t(1) << lane;
+						}
+						sim.values[ctrl_in_sig[i]*num_words + w] = value;
+						sim.undefs[ctrl_in_sig[i]*num_words + w] = undef;
+					}
+				}
+
+				for (int w = 0; w < used_words; w++)
+					for (int idx : active_cells)
+						sim.eval(sim.cells[idx], w);
+
+				for (int k = 0; k < num_cubes; k++)
+				{
+					const RTLIL::Const &cube = cubes[offset + k].first;
+					const std::string &path = cubes[offset + k].second;
+					int w = k / 64;
+					uint64_t mask = uint64_t(1) << (k % 64);
+
+					int undef_sig = -1;
+					for (auto vec : {&ctrl_out_sig, &dff_in_sig})
+						for (int sig : *vec)
+							if (undef_sig < 0 && undef(sig, w, mask))
+								undef_sig = sig;
+
+					if (undef_sig >= 0)
+					{
+						int var = trace_undef(undef_sig, w, mask);
+						if (var < 0 || fixed[var] || cube.bits[var] != RTLIL::State::Sx)
+							return false;
+
+						RTLIL::Const cube0 = cube, cube1 = cube;
+						cube0.bits[var] = RTLIL::State::S0;
+						cube1.bits[var] = RTLIL::State::S1;
+						next_cubes.push_back(std::make_pair(cube0, path + "0"));
+						if (set_exclusive(cube1, var))
+							next_cubes.push_back(std::make_pair(cube1, path + "1"));
+						continue;
+					}
+
+					FsmData::transition_t tr;
+					tr.ctrl_in = cube;
+					tr.ctrl_out = RTLIL::Const(RTLIL::State::S0, GetSize(ctrl_out_sig));
+					RTLIL::Const next_state(RTLIL::State::S0, GetSize(dff_in_sig));
+
+					for (int i = 0; i < GetSize(ctrl_out_sig); i++)
+						if (value(ctrl_out_sig[i], w, mask))
+							tr.ctrl_out.bits[i] = RTLIL::State::S1;
+					for (int i = 0; i < GetSize(dff_in_sig); i++)
+						if (value(dff_in_sig[i], w, mask))
+							next_state.bits[i] = RTLIL::State::S1;
+
+					for (int i = 0; i < GetSize(ctrl_in); i++)
+						if (fixed[i] || tr.ctrl_in.bits[i] == RTLIL::State::Sx)
+							tr.ctrl_in.bits[i] = RTLIL::State::Sa;
+					for (int i = 0; i < GetSize(ctrl_in); i++)
+						if (tr.ctrl_in.bits[i] == RTLIL::State::S1 && exclusive_ctrls.count(ctrl_in[i]))
+							for (auto &bit : exclusive_ctrls.at(ctrl_in[i]))
+								if (ctrl_in_index.count(bit))
+									tr.ctrl_in.bits[ctrl_in_index.at(bit)] = RTLIL::State::Sa;
+
+					leaf_t leaf;
+					leaf.path = path;
+					leaf.valid = states.count(next_state) != 0;
+					leaf.tr = tr;
+					leaf.tr.state_in = state_in;
+					if (leaf.valid)
+						leaf.tr.state_out = states.at(next_state);
+					else
+						leaf.message = stringf("  transition: %10s %s -> INVALID_STATE(%s) %s  <ignored invalid transistion!>\n",
+								log_signal(state_value), log_signal(tr.ctrl_in), log_signal(next_state), log_signal(tr.ctrl_out));
+					leaves.push_back(leaf);
+				}
+			}
+
+			cubes.swap(next_cubes);
+			next_cubes.clear();
+		}
+
+		std::sort(leaves.begin(), leaves.end());
+
+		for (auto &leaf : leaves) {
+			if (!leaf.valid) {
+				log("%s", leaf.message.c_str());
+				continue;
+			}
+			fsm_data.transition_table.push_back(leaf.tr);
+			log("  transition: %10s %s -> %10s %s\n", log_signal(state_value), log_signal(leaf.tr.ctrl_in),
+					log_signal(fsm_data.state_table[leaf.tr.state_out]), log_signal(leaf.tr.ctrl_out));
+		}
+		return true;
+	}
+};
+
 static void extract_fsm(RTLIL::Wire *wire)
 {
 	log("Extracting FSM `%s' from module `%s'.\n", wire->name.c_str(), module->name.c_str());
@@ -357,12 +816,14 @@ static void extract_fsm(RTLIL::Wire *wire)
 	// Create transition table
 
 	ConstEval ce(module), ce_nostop(module);
+	TransitionSweep sweep(ctrl_in, ctrl_out, dff_in, dff_out);
 	ce.stop(ctrl_in);
 	for (int state_idx = 0; state_idx < int(fsm_data.state_table.size()); state_idx++) {
 		ce.push(), ce_nostop.push();
 		ce.set(dff_out, fsm_data.state_table[state_idx]);
 		ce_nostop.set(dff_out, fsm_data.state_table[state_idx]);
-		find_transitions(ce, ce_nostop, fsm_data, states, state_idx, ctrl_in, ctrl_out, dff_in, RTLIL::SigSpec());
+		if (!sweep.sweep(ce_nostop, fsm_data, states, state_idx) && (getenv("SWEEPDBG") ? log("SWEEP-FALLBACK\n"), true : true))
+			find_transitions(ce, ce_nostop, fsm_data, states, state_idx, ctrl_in, ctrl_out, dff_in, RTLIL::SigSpec());
 		ce.pop(), ce_nostop.pop();
 	}
 
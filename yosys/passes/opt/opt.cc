@@ -25,6 +25,96 @@
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
 
+// the opt_* passes work on one module at a time, so a module that was not
+// changed by any of them in one iteration of the loop below will not be
+// changed by the next iteration either. OptWorklist keeps a monitor on each
+// module and only reruns the passes on the modules that were modified.
+struct OptModuleMonitor : public RTLIL::Monitor
+{
+	bool dirty;
+
+	OptModuleMonitor() : dirty(false) { }
+
+	virtual void notify_connect(RTLIL::Cell*, const RTLIL::IdString&, const RTLIL::SigSpec&, RTLIL::SigSpec&) YS_OVERRIDE {
+		dirty = true;
+	}
+
+	virtual void notify_connect(RTLIL::Module*, const RTLIL::SigSig&) YS_OVERRIDE {
+		dirty = true;
+	}
+
+	virtual void notify_connect(RTLIL::Module*, const std::vector<RTLIL::SigSig>&) YS_OVERRIDE {
+		dirty = true;
+	}
+
+	virtual void notify_blackout(RTLIL::Module*) YS_OVERRIDE {
+		dirty = true;
+	}
+};
+
+struct OptWorklist
+{
+	RTLIL::Design *design;
+	RTLIL::Selection worklist;
+	dict<RTLIL::Module*, pool<RTLIL::IdString>> partial_modules;
+	dict<RTLIL::Module*, OptModuleMonitor*> monitors;
+	dict<RTLIL::Module*, int> wire_counts;
+
+	OptWorklist(RTLIL::Design *design) : design(design), worklist(false)
+	{
+		for (auto module : design->selected_modules()) {
+			if (!design->selected_whole_module(module))
+				partial_modules[module] = design->selection_stack.back().selected_members.at(module->name);
+			monitors[module] = new OptModuleMonitor;
+			module->monitors.insert(monitors.at(module));
+		}
+		select(design->selected_modules());
+	}
+
+	~OptWorklist()
+	{
+		for (auto &it : monitors) {
+			it.first->monitors.erase(it.second);
+			delete it.second;
+		}
+	}
+
+	void select(const std::vector<RTLIL::Module*> &modules)
+	{
+		worklist = RTLIL::Selection(false);
+		for (auto module : modules) {
+			if (partial_modules.count(module))
+				worklist.selected_members[module->name] = partial_modules.at(module);
+			else
+				worklist.selected_modules.insert(module->name);
+			monitors.at(module)->dirty = false;
+			wire_counts[module] = GetSize(module->wires_);
+		}
+	}
+
+	int size() const
+	{
+		return GetSize(worklist.selected_modules) + GetSize(worklist.selected_members);
+	}
+
+	void call(std::string command)
+	{
+		Pass::call_on_selection(design, worklist, command);
+	}
+
+	// continue with the modules modified since the last call to select(),
+	// returns false when there are none
+	bool next()
+	{
+		std::vector<RTLIL::Module*> modules;
+		for (auto &it : monitors)
+			if (it.second->dirty || GetSize(it.first->wires_) != wire_counts.at(it.first))
+				modules.push_back(it.first);
+		select(modules);
+		return !modules.empty();
+	}
+};
+
 struct OptPass : public Pass {
 	OptPass() : Pass("opt", "perform simple optimizations") { }
 	virtual void help()
@@ -37,30 +127,36 @@ struct OptPass : public Pass {
 		log("a series of trivial optimizations and cleanups. This pass executes the other\n");
 		log("passes in the following order:\n");
 		log("\n");
-		log("    opt_expr [-mux_undef] [-mux_bool] [-undriven] [-clkinv] [-fine] [-full] [-keepdc]\n");
-		log("    opt_merge [-share_all] -nomux\n");
+		log("    opt_expr [-mux_undef] [-mux_bool] [-undriven] [-clkinv] [-fine] [-full] [-keepdc] [-j <N>]\n");
+		log("    opt_merge [-share_all] [-j <N>] -nomux\n");
 		log("\n");
 		log("    do\n");
-		log("        opt_muxtree\n");
-		log("        opt_reduce [-fine] [-full]\n");
-		log("        opt_merge [-share_all]\n");
-		log("        opt_rmdff [-keepdc]\n");
-		log("        opt_clean [-purge]\n");
-		log("        opt_expr [-mux_undef] [-mux_bool] [-undriven] [-clkinv] [-fine] [-full] [-keepdc]\n");
+		log("        opt_muxtree [-j <N>]\n");
+		log("        opt_reduce [-fine] [-full] [-j <N>]\n");
+		log("        opt_merge [-share_all] [-j <N>]\n");
+		log("        opt_rmdff [-keepdc] [-j <N>]\n");
+		log("        opt_clean [-purge] [-j <N>]\n");
+		log("        opt_expr [-mux_undef] [-mux_bool] [-undriven] [-clkinv] [-fine] [-full] [-keepdc] [-j <N>]\n");
 		log("    while <changed design>\n");
 		log("\n");
 		log("When called with -fast the following script is used instead:\n");
 		log("\n");
 		log("    do\n");
-		log("        opt_expr [-mux_undef] [-mux_bool] [-undriven] [-clkinv] [-fine] [-full] [-keepdc]\n");
-		log("        opt_merge [-share_all]\n");
-		log("        opt_rmdff [-keepdc]\n");
-		log("        opt_clean [-purge]\n");
+		log("        opt_expr [-mux_undef] [-mux_bool] [-undriven] [-clkinv] [-fine] [-full] [-keepdc] [-j <N>]\n");
+		log("        opt_merge [-share_all] [-j <N>]\n");
+		log("        opt_rmdff [-keepdc] [-j <N>]\n");
+		log("        opt_clean [-purge] [-j <N>]\n");
 		log("    while <changed design in opt_rmdff>\n");
 		log("\n");
+		log("Only the first iteration of the loop runs on all selected modules. Further\n");
+		log("iterations only revisit the modules that were changed in the previous one.\n");
+		log("\n");
 		log("Note: Options in square brackets (such as [-keepdc]) are passed through to\n");
 		log("the opt_* commands when given to 'opt'.\n");
 		log("\n");
+		log("The -j <N> option runs each of the opt_* commands on the selected modules in\n");
+		log("parallel using N threads. The result does not depend on N.\n");
+		log("\n");
 		log("\n");
 	}
 	virtual void execute(std::vector<std::string> args, RTLIL::Design *design)
@@ -70,6 +166,7 @@ struct OptPass : public Pass {
 		std::string opt_reduce_args;
 		std::string opt_merge_args;
 		std::string opt_rmdff_args;
+		std::string opt_muxtree_args;
 		bool fast_mode = false;
 
 		log_header(design, "Executing OPT pass (performing simple optimizations).\n");
@@ -116,6 +213,16 @@ struct OptPass : public Pass {
 				opt_merge_args += " -share_all";
 				continue;
 			}
+			if (args[argidx] == "-j" && argidx+1 < args.size()) {
+				std::string j_arg = " -j " + args[++argidx];
+				opt_clean_args += j_arg;
+				opt_expr_args += j_arg;
+				opt_reduce_args += j_arg;
+				opt_merge_args += j_arg;
+				opt_rmdff_args += j_arg;
+				opt_muxtree_args += j_arg;
+				continue;
+			}
 			if (args[argidx] == "-fast") {
 				fast_mode = true;
 				continue;
@@ -126,33 +233,37 @@ struct OptPass : public Pass {
 
 		if (fast_mode)
 		{
+			OptWorklist worklist(design);
 			while (1) {
-				Pass::call(design, "opt_expr" + opt_expr_args);
-				Pass::call(design, "opt_merge" + opt_merge_args);
+				worklist.call("opt_expr" + opt_expr_args);
+				worklist.call("opt_merge" + opt_merge_args);
 				design->scratchpad_unset("opt.did_something");
-				Pass::call(design, "opt_rmdff" + opt_rmdff_args);
+				worklist.call("opt_rmdff" + opt_rmdff_args);
 				if (design->scratchpad_get_bool("opt.did_something") == false)
 					break;
-				Pass::call(design, "opt_clean" + opt_clean_args);
-				log_header(design, "Rerunning OPT passes. (Removed registers in this run.)\n");
+				worklist.call("opt_clean" + opt_clean_args);
+				if (!worklist.next())
+					break;
+				log_header(design, "Rerunning OPT passes on %d modules. (Removed registers in this run.)\n", worklist.size());
 			}
-			Pass::call(design, "opt_clean" + opt_clean_args);
+			worklist.call("opt_clean" + opt_clean_args);
 		}
 		else
 		{
 			Pass::call(design, "opt_expr" + opt_expr_args);
 			Pass::call(design, "opt_merge -nomux" + opt_merge_args);
+			OptWorklist worklist(design);
 			while (1) {
 				design->scratchpad_unset("opt.did_something");
-				Pass::call(design, "opt_muxtree");
-				Pass::call(design, "opt_reduce" + opt_reduce_args);
-				Pass::call(design, "opt_merge" + opt_merge_args);
-				Pass::call(design, "opt_rmdff" + opt_rmdff_args);
-				Pass::call(design, "opt_clean" + opt_clean_args);
-				Pass::call(design, "opt_expr" + opt_expr_args);
-				if (design->scratchpad_get_bool("opt.did_something") == false)
+				worklist.call("opt_muxtree" + opt_muxtree_args);
+				worklist.call("opt_reduce" + opt_reduce_args);
+				worklist.call("opt_merge" + opt_merge_args);
+				worklist.call("opt_rmdff" + opt_rmdff_args);
+				worklist.call("opt_clean" + opt_clean_args);
+				worklist.call("opt_expr" + opt_expr_args);
+				if (design->scratchpad_get_bool("opt.did_something") == false || !worklist.next())
 					break;
-				log_header(design, "Rerunning OPT passes. (Maybe there is more to do..)\n");
+				log_header(design, "Rerunning OPT passes on %d modules. (Maybe there is more to do..)\n", worklist.size());
 			}
 		}
 
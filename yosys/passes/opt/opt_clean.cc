@@ -79,7 +79,8 @@ struct keep_cache_t
 
 keep_cache_t keep_cache;
 CellTypes ct_reg, ct_all;
-int count_rm_cells, count_rm_wires;
+std::atomic<int> count_rm_cells, count_rm_wires;
+std::atomic<bool> did_something;
 
 void rmunused_module_cells(Module *module, bool verbose)
 {
@@ -131,7 +132,7 @@ void rmunused_module_cells(Module *module, bool verbose)
 	for (auto cell : unused) {
 		if (verbose)
 			log("  removing unused `%s' cell `%s'.\n", cell->type.c_str(), cell->name.c_str());
-		module->design->scratchpad_set_bool("opt.did_something", true);
+		did_something = true;
 		module->remove(cell);
 		count_rm_cells++;
 	}
@@ -235,7 +236,10 @@ void rmunused_module_signals(RTLIL::Module *module, bool purge_mode, bool verbos
 		}
 	}
 
-	module->connections_.clear();
+	// the connections are rebuilt below, monitors are only notified if
+	// they are actually different
+	std::vector<RTLIL::SigSig> old_connections;
+	old_connections.swap(module->connections_);
 
 	SigPool used_signals;
 	SigPool used_signals_nodrivers;
@@ -283,7 +287,7 @@ void rmunused_module_signals(RTLIL::Module *module, bool purge_mode, bool verbos
 				if (new_conn.first.size() > 0) {
 					used_signals.add(new_conn.first);
 					used_signals.add(new_conn.second);
-					module->connect(new_conn);
+					module->connections_.push_back(new_conn);
 				}
 			}
 		} else {
@@ -313,6 +317,13 @@ void rmunused_module_signals(RTLIL::Module *module, bool purge_mode, bool verbos
 	}
 
 
+	if (module->connections_ != old_connections) {
+		std::vector<RTLIL::SigSig> new_connections;
+		new_connections.swap(module->connections_);
+		module->connections_.swap(old_connections);
+		module->new_connections(new_connections);
+	}
+
 	pool<RTLIL::Wire*> del_wires;
 
 	int del_wires_count = 0;
@@ -354,7 +365,7 @@ void rmunused_module(RTLIL::Module *module, bool purge_mode, bool verbose)
 		module->remove(cell);
 	}
 	if (!delcells.empty())
-		module->design->scratchpad_set_bool("opt.did_something", true);
+		did_something = true;
 
 	rmunused_module_cells(module, verbose);
 	rmunused_module_signals(module, purge_mode, verbose);
@@ -378,10 +389,14 @@ struct OptCleanPass : public Pass {
 		log("    -purge\n");
 		log("        also remove internal nets if they have a public name\n");
 		log("\n");
+		log("    -j <N>\n");
+		log("        process the selected modules in parallel using N threads\n");
+		log("\n");
 	}
 	virtual void execute(std::vector<std::string> args, RTLIL::Design *design)
 	{
 		bool purge_mode = false;
+		int num_threads = 0;
 
 		log_header(design, "Executing OPT_CLEAN pass (remove unused cells and wires).\n");
 		log_push();
@@ -392,6 +407,10 @@ struct OptCleanPass : public Pass {
 				purge_mode = true;
 				continue;
 			}
+			if (args[argidx] == "-j" && argidx+1 < args.size()) {
+				num_threads = std::max(atoi(args[++argidx].c_str()), 1);
+				continue;
+			}
 			break;
 		}
 		extra_args(args, argidx, design);
@@ -403,11 +422,24 @@ struct OptCleanPass : public Pass {
 
 		ct_all.setup(design);
 
-		for (auto module : design->selected_whole_modules_warn()) {
-			if (module->has_processes_warn())
-				continue;
+		std::vector<RTLIL::Module*> modules;
+		for (auto module : design->selected_whole_modules_warn())
+			if (!module->has_processes_warn())
+				modules.push_back(module);
+
+		// the keep cache is shared between the threads and must be
+		// complete before the modules are modified
+		if (num_threads > 0)
+			for (auto module : design->modules())
+				keep_cache.query(module);
+
+		did_something = false;
+		parallel_for_modules(modules, num_threads, [&](RTLIL::Module *module) {
 			rmunused_module(module, purge_mode, true);
-		}
+		});
+
+		if (did_something)
+			design->scratchpad_set_bool("opt.did_something", true);
 
 		design->optimize();
 		design->sort();
@@ -461,6 +493,7 @@ struct CleanPass : public Pass {
 
 		count_rm_cells = 0;
 		count_rm_wires = 0;
+		did_something = false;
 
 		for (auto module : design->selected_whole_modules()) {
 			if (module->has_processes())
@@ -468,8 +501,11 @@ struct CleanPass : public Pass {
 			rmunused_module(module, purge_mode, false);
 		}
 
+		if (did_something)
+			design->scratchpad_set_bool("opt.did_something", true);
+
 		if (count_rm_cells > 0 || count_rm_wires > 0)
-			log("Removed %d unused cells and %d unused wires.\n", count_rm_cells, count_rm_wires);
+			log("Removed %d unused cells and %d unused wires.\n", int(count_rm_cells), int(count_rm_wires));
 
 		design->optimize();
 		design->sort();
@@ -29,11 +29,10 @@
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
 
-bool did_something;
+thread_local bool did_something;
 
-void replace_undriven(RTLIL::Design *design, RTLIL::Module *module)
+void replace_undriven(CellTypes &ct, RTLIL::Module *module)
 {
-	CellTypes ct(design);
 	SigMap sigmap(module);
 	SigPool driven_signals;
 	SigPool used_signals;
@@ -1364,6 +1363,9 @@ struct OptExprPass : public Pass {
 		log("        all result bits to be set to x. this behavior changes when 'a+0' is\n");
 		log("        replaced by 'a'. the -keepdc option disables all such optimizations.\n");
 		log("\n");
+		log("    -j <N>\n");
+		log("        process the selected modules in parallel using N threads\n");
+		log("\n");
 	}
 	virtual void execute(std::vector<std::string> args, RTLIL::Design *design)
 	{
@@ -1373,6 +1375,7 @@ struct OptExprPass : public Pass {
 		bool clkinv = false;
 		bool do_fine = false;
 		bool keepdc = false;
+		int num_threads = 0;
 
 		log_header(design, "Executing OPT_EXPR pass (perform const folding).\n");
 		log_push();
@@ -1410,25 +1413,37 @@ struct OptExprPass : public Pass {
 				keepdc = true;
 				continue;
 			}
+			if (args[argidx] == "-j" && argidx+1 < args.size()) {
+				num_threads = std::max(atoi(args[++argidx].c_str()), 1);
+				continue;
+			}
 			break;
 		}
 		extra_args(args, argidx, design);
 
-		for (auto module : design->selected_modules())
+		CellTypes ct;
+		if (undriven)
+			ct.setup(design);
+
+		std::atomic<bool> changed(false);
+		parallel_for_modules(design->selected_modules(), num_threads, [&](RTLIL::Module *module)
 		{
 			if (undriven)
-				replace_undriven(design, module);
+				replace_undriven(ct, module);
 
 			do {
 				do {
 					did_something = false;
 					replace_const_cells(design, module, false, mux_undef, mux_bool, do_fine, keepdc, clkinv);
 					if (did_something)
-						design->scratchpad_set_bool("opt.did_something", true);
+						changed = true;
 				} while (did_something);
 				replace_const_cells(design, module, true, mux_undef, mux_bool, do_fine, keepdc, clkinv);
 			} while (did_something);
-		}
+		});
+
+		if (changed)
+			design->scratchpad_set_bool("opt.did_something", true);
 
 		log_pop();
 	}
@@ -21,16 +21,89 @@
 #include "kernel/sigtools.h"
 #include "kernel/log.h"
 #include "kernel/celltypes.h"
-#include "libs/sha1/sha1.h"
 #include <stdlib.h>
 #include <stdio.h>
-#include <set>
-
-#define USE_CELL_HASH_CACHE
+#include <map>
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
 
+// The cells of a module that were left over by the last opt_merge run, with
+// their hash values. Cells that are modified later are marked as dirty, and
+// the next run only compares the dirty (and new) cells against the others.
+struct OptMergeCache
+{
+	bool valid = false;
+	bool updating = false;
+	bool mode_nomux = false;
+	bool mode_share_all = false;
+	dict<RTLIL::Cell*, unsigned int, hash_ptr_ops> cell_hashes;
+	pool<RTLIL::Cell*, hash_ptr_ops> dirty_cells;
+};
+
+// Keeps the caches up to date. A module level connect() changes the SigMap
+// of the module and thus possibly the hashes of all cells, so it invalidates
+// the cache of the module.
+struct OptMergeMonitor : public RTLIL::Monitor
+{
+	// only modified in OptMergePass::execute(), the notifications from
+	// parallel_for_modules() workers only read it
+	std::map<RTLIL::Module*, OptMergeCache> caches;
+
+	OptMergeCache *cache(RTLIL::Module *module)
+	{
+		auto it = caches.find(module);
+		if (it == caches.end() || it->second.updating)
+			return nullptr;
+		return &it->second;
+	}
+
+	virtual void notify_module_del(RTLIL::Module *module) YS_OVERRIDE
+	{
+		caches.erase(module);
+	}
+
+	virtual void notify_connect(RTLIL::Cell *cell, const RTLIL::IdString&, const RTLIL::SigSpec&, RTLIL::SigSpec&) YS_OVERRIDE
+	{
+		auto c = cache(cell->module);
+		if (c != nullptr && c->valid)
+			c->dirty_cells.insert(cell);
+	}
+
+	virtual void notify_connect(RTLIL::Module *module, const RTLIL::SigSig&) YS_OVERRIDE
+	{
+		auto c = cache(module);
+		if (c != nullptr)
+			c->valid = false;
+	}
+
+	virtual void notify_connect(RTLIL::Module *module, const std::vector<RTLIL::SigSig>&) YS_OVERRIDE
+	{
+		auto c = cache(module);
+		if (c != nullptr)
+			c->valid = false;
+	}
+
+	virtual void notify_blackout(RTLIL::Module *module) YS_OVERRIDE
+	{
+		auto c = cache(module);
+		if (c != nullptr)
+			c->valid = false;
+	}
+
+	static OptMergeMonitor *get(RTLIL::Design *design)
+	{
+		for (auto mon : design->monitors) {
+			auto opt_merge_mon = dynamic_cast<OptMergeMonitor*>(mon);
+			if (opt_merge_mon != nullptr)
+				return opt_merge_mon;
+		}
+		auto opt_merge_mon = new OptMergeMonitor;
+		design->monitors.insert(opt_merge_mon);
+		return opt_merge_mon;
+	}
+};
+
 struct OptMergeWorker
 {
 	RTLIL::Design *design;
@@ -41,9 +114,6 @@ struct OptMergeWorker
 
 	CellTypes ct;
 	int total_count;
-#ifdef USE_CELL_HASH_CACHE
-	dict<const RTLIL::Cell*, std::string> cell_hash_cache;
-#endif
 
 	static void sort_pmux_conn(dict<RTLIL::IdString, RTLIL::SigSpec> &conn)
 	{
@@ -68,201 +138,128 @@ struct OptMergeWorker
 		}
 	}
 
-#ifdef USE_CELL_HASH_CACHE
-	std::string int_to_hash_string(unsigned int v)
+	static bool is_commutative(RTLIL::IdString type)
 	{
-		if (v == 0)
-			return "0";
-		std::string str = "";
-		while (v > 0) {
-			str += 'a' + (v & 15);
-			v = v >> 4;
-		}
-		return str;
+		return type == "$and" || type == "$or" || type == "$xor" || type == "$xnor" || type == "$add" || type == "$mul" ||
+				type == "$logic_and" || type == "$logic_or" || type == "$_AND_" || type == "$_OR_" || type == "$_XOR_";
 	}
 
-	std::string hash_cell_parameters_and_connections(const RTLIL::Cell *cell)
+	// the sigmapped input connections of the cell, in a canonical form for
+	// commutative inputs
+	dict<RTLIL::IdString, RTLIL::SigSpec> normalized_inputs(const RTLIL::Cell *cell)
 	{
-		if (cell_hash_cache.count(cell) > 0)
-			return cell_hash_cache[cell];
-
-		std::string hash_string = cell->type.str() + "\n";
-
-		for (auto &it : cell->parameters)
-			hash_string += "P " + it.first.str() + "=" + it.second.as_string() + "\n";
+		dict<RTLIL::IdString, RTLIL::SigSpec> conn;
 
-		const dict<RTLIL::IdString, RTLIL::SigSpec> *conn = &cell->connections();
-		dict<RTLIL::IdString, RTLIL::SigSpec> alt_conn;
+		for (auto &it : cell->connections())
+			if (!cell->output(it.first))
+				conn[it.first] = assign_map(it.second);
 
-		if (cell->type == "$and" || cell->type == "$or" || cell->type == "$xor" || cell->type == "$xnor" || cell->type == "$add" || cell->type == "$mul" ||
-				cell->type == "$logic_and" || cell->type == "$logic_or" || cell->type == "$_AND_" || cell->type == "$_OR_" || cell->type == "$_XOR_") {
-			alt_conn = *conn;
-			if (assign_map(alt_conn.at("\\A")) < assign_map(alt_conn.at("\\B"))) {
-				alt_conn["\\A"] = conn->at("\\B");
-				alt_conn["\\B"] = conn->at("\\A");
-			}
-			conn = &alt_conn;
+		if (is_commutative(cell->type)) {
+			if (conn.at("\\A") < conn.at("\\B"))
+				std::swap(conn.at("\\A"), conn.at("\\B"));
 		} else
 		if (cell->type == "$reduce_xor" || cell->type == "$reduce_xnor") {
-			alt_conn = *conn;
-			assign_map.apply(alt_conn.at("\\A"));
-			alt_conn.at("\\A").sort();
-			conn = &alt_conn;
+			conn.at("\\A").sort();
 		} else
 		if (cell->type == "$reduce_and" || cell->type == "$reduce_or" || cell->type == "$reduce_bool") {
-			alt_conn = *conn;
-			assign_map.apply(alt_conn.at("\\A"));
-			alt_conn.at("\\A").sort_and_unify();
-			conn = &alt_conn;
+			conn.at("\\A").sort_and_unify();
 		} else
 		if (cell->type == "$pmux") {
-			alt_conn = *conn;
-			assign_map.apply(alt_conn.at("\\A"));
-			assign_map.apply(alt_conn.at("\\B"));
-			assign_map.apply(alt_conn.at("\\S"));
-			sort_pmux_conn(alt_conn);
-			conn = &alt_conn;
-		}
-
-		vector<string> hash_conn_strings;
-
-		for (auto &it : *conn) {
-			if (cell->output(it.first))
-				continue;
-			RTLIL::SigSpec sig = it.second;
-			assign_map.apply(sig);
-			string s = "C " + it.first.str() + "=";
-			for (auto &chunk : sig.chunks()) {
-				if (chunk.wire)
-					s += "{" + chunk.wire->name.str() + " " +
-							int_to_hash_string(chunk.offset) + " " +
-							int_to_hash_string(chunk.width) + "}";
-				else
-					s += RTLIL::Const(chunk.data).as_string();
-			}
-			hash_conn_strings.push_back(s + "\n");
+			sort_pmux_conn(conn);
 		}
 
-		std::sort(hash_conn_strings.begin(), hash_conn_strings.end());
-
-		for (auto it : hash_conn_strings)
-			hash_string += it;
-
-		cell_hash_cache[cell] = sha1(hash_string);
-		return cell_hash_cache[cell];
+		return conn;
 	}
-#endif
 
-	bool compare_cell_parameters_and_connections(const RTLIL::Cell *cell1, const RTLIL::Cell *cell2, bool &lt)
+	// hash of type, parameters and normalized inputs, equal for all cells
+	// for which compare_cell_parameters_and_connections() returns true
+	unsigned int hash_cell_parameters_and_connections(const RTLIL::Cell *cell)
 	{
-#ifdef USE_CELL_HASH_CACHE
-		std::string hash1 = hash_cell_parameters_and_connections(cell1);
-		std::string hash2 = hash_cell_parameters_and_connections(cell2);
-
-		if (hash1 != hash2) {
-			lt = hash1 < hash2;
-			return true;
-		}
-#endif
+		unsigned int h = mkhash_init;
+		h = mkhash(h, cell->type.hash());
 
-		if (cell1->parameters != cell2->parameters) {
-			std::map<RTLIL::IdString, RTLIL::Const> p1(cell1->parameters.begin(), cell1->parameters.end());
-			std::map<RTLIL::IdString, RTLIL::Const> p2(cell2->parameters.begin(), cell2->parameters.end());
-			lt = p1 < p2;
-			return true;
-		}
+		// sums, so that the order of the dict entries does not matter
+		unsigned int h_params = 0;
+		for (auto &it : cell->parameters)
+			h_params += mkhash(it.first.hash(), it.second.hash());
+		h = mkhash(h, h_params);
 
-		dict<RTLIL::IdString, RTLIL::SigSpec> conn1 = cell1->connections();
-		dict<RTLIL::IdString, RTLIL::SigSpec> conn2 = cell2->connections();
+		unsigned int h_conn = 0;
+		for (auto &it : normalized_inputs(cell))
+			h_conn += mkhash(it.first.hash(), it.second.hash());
+		h = mkhash(h, h_conn);
 
-		for (auto &it : conn1) {
-			if (cell1->output(it.first))
-				it.second = RTLIL::SigSpec();
-			else
-				assign_map.apply(it.second);
-		}
-
-		for (auto &it : conn2) {
-			if (cell2->output(it.first))
-				it.second = RTLIL::SigSpec();
-			else
-				assign_map.apply(it.second);
-		}
+		return h;
+	}
 
-		if (cell1->type == "$and" || cell1->type == "$or" || cell1->type == "$xor" || cell1->type == "$xnor" || cell1->type == "$add" || cell1->type == "$mul" ||
-				cell1->type == "$logic_and" || cell1->type == "$logic_or" || cell1->type == "$_AND_" || cell1->type == "$_OR_" || cell1->type == "$_XOR_") {
-			if (conn1.at("\\A") < conn1.at("\\B")) {
-				RTLIL::SigSpec tmp = conn1["\\A"];
-				conn1["\\A"] = conn1["\\B"];
-				conn1["\\B"] = tmp;
-			}
-			if (conn2.at("\\A") < conn2.at("\\B")) {
-				RTLIL::SigSpec tmp = conn2["\\A"];
-				conn2["\\A"] = conn2["\\B"];
-				conn2["\\B"] = tmp;
-			}
-		} else
-		if (cell1->type == "$reduce_xor" || cell1->type == "$reduce_xnor") {
-			conn1["\\A"].sort();
-			conn2["\\A"].sort();
-		} else
-		if (cell1->type == "$reduce_and" || cell1->type == "$reduce_or" || cell1->type == "$reduce_bool") {
-			conn1["\\A"].sort_and_unify();
-			conn2["\\A"].sort_and_unify();
-		} else
-		if (cell1->type == "$pmux") {
-			sort_pmux_conn(conn1);
-			sort_pmux_conn(conn2);
-		}
+	bool compare_cell_parameters_and_connections(const RTLIL::Cell *cell1, const RTLIL::Cell *cell2)
+	{
+		if (cell1->parameters != cell2->parameters)
+			return false;
 
-		if (conn1 != conn2) {
-			std::map<RTLIL::IdString, RTLIL::SigSpec> c1(conn1.begin(), conn1.end());
-			std::map<RTLIL::IdString, RTLIL::SigSpec> c2(conn2.begin(), conn2.end());
-			lt = c1 < c2;
-			return true;
-		}
+		if (normalized_inputs(cell1) != normalized_inputs(cell2))
+			return false;
 
-		if (cell1->type.substr(0, 1) == "$" && conn1.count("\\Q") != 0) {
+		if (cell1->type.substr(0, 1) == "$" && cell1->hasPort("\\Q")) {
 			std::vector<RTLIL::SigBit> q1 = dff_init_map(cell1->getPort("\\Q")).to_sigbit_vector();
 			std::vector<RTLIL::SigBit> q2 = dff_init_map(cell2->getPort("\\Q")).to_sigbit_vector();
 			for (size_t i = 0; i < q1.size(); i++)
-				if ((q1.at(i).wire == NULL || q2.at(i).wire == NULL) && q1.at(i) != q2.at(i)) {
-					lt = q1.at(i) < q2.at(i);
-					return true;
-				}
+				if ((q1.at(i).wire == NULL || q2.at(i).wire == NULL) && q1.at(i) != q2.at(i))
+					return false;
 		}
 
-		return false;
+		return true;
+	}
+
+	bool mergeable(const RTLIL::Cell *cell)
+	{
+		if (!mode_share_all && !ct.cell_known(cell->type))
+			return false;
+		return cell->known() && !cell->has_keep_attr();
 	}
 
 	bool compare_cells(const RTLIL::Cell *cell1, const RTLIL::Cell *cell2)
 	{
 		if (cell1->type != cell2->type)
-			return cell1->type < cell2->type;
-
-		if ((!mode_share_all && !ct.cell_known(cell1->type)) || !cell1->known())
-			return cell1 < cell2;
-
-		if (cell1->has_keep_attr() || cell2->has_keep_attr())
-			return cell1 < cell2;
+			return false;
 
-		bool lt;
-		if (compare_cell_parameters_and_connections(cell1, cell2, lt))
-			return lt;
+		if (!mergeable(cell1) || !mergeable(cell2))
+			return false;
 
-		return false;
+		return compare_cell_parameters_and_connections(cell1, cell2);
 	}
 
-	struct CompareCells {
-		OptMergeWorker *that;
-		CompareCells(OptMergeWorker *that) : that(that) {}
-		bool operator()(const RTLIL::Cell *cell1, const RTLIL::Cell *cell2) const {
-			return that->compare_cells(cell1, cell2);
+	void merge_cell(RTLIL::Cell *cell, RTLIL::Cell *other)
+	{
+		log("  Cell `%s' is identical to cell `%s'.\n", cell->name.c_str(), other->name.c_str());
+		for (auto &it : cell->connections()) {
+			if (cell->output(it.first)) {
+				RTLIL::SigSpec other_sig = other->getPort(it.first);
+				log("    Redirecting output %s: %s = %s\n", it.first.c_str(),
+						log_signal(it.second), log_signal(other_sig));
+				module->connect(RTLIL::SigSig(it.second, other_sig));
+				assign_map.add(it.second, other_sig);
+			}
 		}
-	};
+		log("    Removing %s cell `%s' from module `%s'.\n", cell->type.c_str(), cell->name.c_str(), module->name.c_str());
+		module->remove(cell);
+		total_count++;
+	}
 
-	OptMergeWorker(RTLIL::Design *design, RTLIL::Module *module, bool mode_nomux, bool mode_share_all) :
-		design(design), module(module), assign_map(module), mode_share_all(mode_share_all)
+	// look for a cell identical to the given one in the buckets, add the cell
+	// if there is none
+	RTLIL::Cell *find_or_insert(dict<int, std::vector<RTLIL::Cell*>> &buckets, RTLIL::Cell *cell, unsigned int hash)
+	{
+		auto &bucket = buckets[hash];
+		for (auto other : bucket)
+			if (compare_cells(cell, other))
+				return other;
+		bucket.push_back(cell);
+		return nullptr;
+	}
+
+	OptMergeWorker(RTLIL::Design *design, RTLIL::Module *module, bool mode_nomux, bool mode_share_all, OptMergeCache *cache) :
+		design(design), module(module), mode_share_all(mode_share_all)
 	{
 		total_count = 0;
 		ct.setup_internals();
@@ -279,6 +276,37 @@ struct OptMergeWorker
 		ct.cell_types.erase("$anyconst");
 
 		log("Finding identical cells in module `%s'.\n", module->name.c_str());
+
+		std::vector<RTLIL::Cell*> cells;
+		cells.reserve(module->cells_.size());
+		for (auto &it : module->cells_) {
+			if (!design->selected(module, it.second))
+				continue;
+			if (mergeable(it.second))
+				cells.push_back(it.second);
+		}
+
+		if (cache != nullptr && (!cache->valid || cache->mode_nomux != mode_nomux || cache->mode_share_all != mode_share_all)) {
+			cache->cell_hashes.clear();
+			cache->valid = false;
+		}
+
+		// the cells that were not modified since the last run are known to be
+		// different from each other, only the others need to be compared
+		std::vector<RTLIL::Cell*> dirty_cells;
+		if (cache != nullptr && cache->valid) {
+			for (auto cell : cells)
+				if (cache->dirty_cells.count(cell) || !cache->cell_hashes.count(cell))
+					dirty_cells.push_back(cell);
+			if (dirty_cells.empty()) {
+				cache->dirty_cells.clear();
+				return;
+			}
+		}
+
+		if (cache != nullptr)
+			cache->updating = true;
+
 		assign_map.set(module);
 
 		dff_init_map.set(module);
@@ -290,47 +318,68 @@ struct OptMergeWorker
 						dff_init_map.add(SigBit(it.second, i), initval[i]);
 			}
 
-		bool did_something = true;
-		while (did_something)
+		dict<RTLIL::Cell*, unsigned int, hash_ptr_ops> cell_hashes;
+		bool did_something = false;
+
+		if (cache != nullptr && cache->valid)
 		{
-#ifdef USE_CELL_HASH_CACHE
-			cell_hash_cache.clear();
-#endif
-			std::vector<RTLIL::Cell*> cells;
-			cells.reserve(module->cells_.size());
-			for (auto &it : module->cells_) {
-				if (!design->selected(module, it.second))
-					continue;
-				if (ct.cell_known(it.second->type) || (mode_share_all && it.second->known()))
-					cells.push_back(it.second);
+			dict<int, std::vector<RTLIL::Cell*>> buckets;
+			pool<RTLIL::Cell*, hash_ptr_ops> dirty_pool(dirty_cells.begin(), dirty_cells.end());
+
+			for (auto cell : cells)
+				if (!dirty_pool.count(cell)) {
+					unsigned int hash = cache->cell_hashes.at(cell);
+					buckets[hash].push_back(cell);
+					cell_hashes[cell] = hash;
+				}
+
+			// if there is something to merge, fall back to the full passes
+			// below, so that the first of the identical cells is kept
+			for (auto cell : dirty_cells) {
+				unsigned int hash = hash_cell_parameters_and_connections(cell);
+				if (find_or_insert(buckets, cell, hash) != nullptr) {
+					did_something = true;
+					break;
+				}
+				cell_hashes[cell] = hash;
 			}
+		}
+		else
+			did_something = true;
 
+		// merging cells changes the sigmap and thus the hashes of the cells
+		// driven by them, so do full passes until nothing changes
+		while (did_something)
+		{
 			did_something = false;
-			std::map<RTLIL::Cell*, RTLIL::Cell*, CompareCells> sharemap(CompareCells(this));
+			cell_hashes.clear();
+
+			dict<int, std::vector<RTLIL::Cell*>> buckets;
+			std::vector<RTLIL::Cell*> remaining_cells;
+
 			for (auto cell : cells)
 			{
-				if (sharemap.count(cell) > 0) {
+				unsigned int hash = hash_cell_parameters_and_connections(cell);
+				RTLIL::Cell *other = find_or_insert(buckets, cell, hash);
+				if (other != nullptr) {
+					merge_cell(cell, other);
 					did_something = true;
-					log("  Cell `%s' is identical to cell `%s'.\n", cell->name.c_str(), sharemap[cell]->name.c_str());
-					for (auto &it : cell->connections()) {
-						if (cell->output(it.first)) {
-							RTLIL::SigSpec other_sig = sharemap[cell]->getPort(it.first);
-							log("    Redirecting output %s: %s = %s\n", it.first.c_str(),
-									log_signal(it.second), log_signal(other_sig));
-							module->connect(RTLIL::SigSig(it.second, other_sig));
-							assign_map.add(it.second, other_sig);
-						}
-					}
-					log("    Removing %s cell `%s' from module `%s'.\n", cell->type.c_str(), cell->name.c_str(), module->name.c_str());
-#ifdef USE_CELL_HASH_CACHE
-					cell_hash_cache.erase(cell);
-#endif
-					module->remove(cell);
-					total_count++;
 				} else {
-					sharemap[cell] = cell;
+					cell_hashes[cell] = hash;
+					remaining_cells.push_back(cell);
 				}
 			}
+
+			cells.swap(remaining_cells);
+		}
+
+		if (cache != nullptr) {
+			cache->cell_hashes.swap(cell_hashes);
+			cache->dirty_cells.clear();
+			cache->mode_nomux = mode_nomux;
+			cache->mode_share_all = mode_share_all;
+			cache->valid = true;
+			cache->updating = false;
 		}
 	}
 };
@@ -352,6 +401,9 @@ struct OptMergePass : public Pass {
 		log("    -share_all\n");
 		log("        Operate on all cell types, not just built-in types.\n");
 		log("\n");
+		log("    -j <N>\n");
+		log("        Process the selected modules in parallel using N threads.\n");
+		log("\n");
 	}
 	virtual void execute(std::vector<std::string> args, RTLIL::Design *design)
 	{
@@ -359,6 +411,7 @@ struct OptMergePass : public Pass {
 
 		bool mode_nomux = false;
 		bool mode_share_all = false;
+		int num_threads = 0;
 
 		size_t argidx;
 		for (argidx = 1; argidx < args.size(); argidx++) {
@@ -371,19 +424,32 @@ struct OptMergePass : public Pass {
 				mode_share_all = true;
 				continue;
 			}
+			if (arg == "-j" && argidx+1 < args.size()) {
+				num_threads = std::max(atoi(args[++argidx].c_str()), 1);
+				continue;
+			}
 			break;
 		}
 		extra_args(args, argidx, design);
 
-		int total_count = 0;
-		for (auto module : design->selected_modules()) {
-			OptMergeWorker worker(design, module, mode_nomux, mode_share_all);
+		// the cache is only used for completely selected modules, because the
+		// cells outside of the selection are not compared
+		OptMergeMonitor *monitor = OptMergeMonitor::get(design);
+		for (auto module : design->selected_modules())
+			if (design->selected_whole_module(module))
+				monitor->caches[module];
+			else
+				monitor->caches.erase(module);
+
+		std::atomic<int> total_count(0);
+		parallel_for_modules(design->selected_modules(), num_threads, [&](RTLIL::Module *module) {
+			OptMergeWorker worker(design, module, mode_nomux, mode_share_all, monitor->cache(module));
 			total_count += worker.total_count;
-		}
+		});
 
 		if (total_count)
 			design->scratchpad_set_bool("opt.did_something", true);
-		log("Removed a total of %d cells.\n", total_count);
+		log("Removed a total of %d cells.\n", int(total_count));
 	}
 } OptMergePass;
 
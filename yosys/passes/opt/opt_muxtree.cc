@@ -453,7 +453,7 @@ struct OptMuxtreePass : public Pass {
 	{
 		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
 		log("\n");
-		log("    opt_muxtree [selection]\n");
+		log("    opt_muxtree [options] [selection]\n");
 		log("\n");
 		log("This pass analyzes the control signals for the multiplexer trees in the design\n");
 		log("and identifies inputs that can never be active. It then removes this dead\n");
@@ -461,22 +461,39 @@ struct OptMuxtreePass : public Pass {
 		log("\n");
 		log("This pass only operates on completely selected modules without processes.\n");
 		log("\n");
+		log("    -j <N>\n");
+		log("        process the selected modules in parallel using N threads\n");
+		log("\n");
 	}
 	virtual void execute(vector<std::string> args, RTLIL::Design *design)
 	{
+		int num_threads = 0;
+
 		log_header(design, "Executing OPT_MUXTREE pass (detect dead branches in mux trees).\n");
-		extra_args(args, 1, design);
 
-		int total_count = 0;
-		for (auto module : design->selected_whole_modules_warn()) {
-			if (module->has_processes_warn())
+		size_t argidx;
+		for (argidx = 1; argidx < args.size(); argidx++) {
+			if (args[argidx] == "-j" && argidx+1 < args.size()) {
+				num_threads = std::max(atoi(args[++argidx].c_str()), 1);
 				continue;
+			}
+			break;
+		}
+		extra_args(args, argidx, design);
+
+		std::vector<RTLIL::Module*> modules;
+		for (auto module : design->selected_whole_modules_warn())
+			if (!module->has_processes_warn())
+				modules.push_back(module);
+
+		std::atomic<int> total_count(0);
+		parallel_for_modules(modules, num_threads, [&](RTLIL::Module *module) {
 			OptMuxtreeWorker worker(design, module);
 			total_count += worker.removed_count;
-		}
+		});
 		if (total_count)
 			design->scratchpad_set_bool("opt.did_something", true);
-		log("Removed %d multiplexer ports.\n", total_count);
+		log("Removed %d multiplexer ports.\n", int(total_count));
 	}
 } OptMuxtreePass;
 
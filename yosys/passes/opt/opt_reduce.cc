@@ -349,10 +349,14 @@ struct OptReducePass : public Pass {
 		log("    -full\n");
 		log("      alias for -fine\n");
 		log("\n");
+		log("    -j <N>\n");
+		log("      process the selected modules in parallel using N threads\n");
+		log("\n");
 	}
 	virtual void execute(std::vector<std::string> args, RTLIL::Design *design)
 	{
 		bool do_fine = false;
+		int num_threads = 0;
 
 		log_header(design, "Executing OPT_REDUCE pass (consolidate $*mux and $reduce_* inputs).\n");
 
@@ -366,22 +370,27 @@ struct OptReducePass : public Pass {
 				do_fine = true;
 				continue;
 			}
+			if (args[argidx] == "-j" && argidx+1 < args.size()) {
+				num_threads = std::max(atoi(args[++argidx].c_str()), 1);
+				continue;
+			}
 			break;
 		}
 		extra_args(args, argidx, design);
 
-		int total_count = 0;
-		for (auto module : design->selected_modules())
+		std::atomic<int> total_count(0);
+		parallel_for_modules(design->selected_modules(), num_threads, [&](RTLIL::Module *module) {
 			while (1) {
 				OptReduceWorker worker(design, module, do_fine);
 				total_count += worker.total_count;
 				if (worker.total_count == 0)
 					break;
 			}
+		});
 
 		if (total_count)
 			design->scratchpad_set_bool("opt.did_something", true);
-		log("Performed a total of %d changes.\n", total_count);
+		log("Performed a total of %d changes.\n", int(total_count));
 	}
 } OptReducePass;
 
@@ -26,9 +26,9 @@
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
 
-SigMap assign_map, dff_init_map;
-SigSet<RTLIL::Cell*> mux_drivers;
-dict<SigBit, pool<SigBit>> init_attributes;
+thread_local SigMap assign_map, dff_init_map;
+thread_local SigSet<RTLIL::Cell*> mux_drivers;
+thread_local dict<SigBit, pool<SigBit>> init_attributes;
 bool keepdc;
 
 void remove_init_attr(SigSpec sig)
@@ -209,15 +209,17 @@ struct OptRmdffPass : public Pass {
 	{
 		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
 		log("\n");
-		log("    opt_rmdff [-keepdc] [selection]\n");
+		log("    opt_rmdff [-keepdc] [-j <N>] [selection]\n");
 		log("\n");
 		log("This pass identifies flip-flops with constant inputs and replaces them with\n");
-		log("a constant driver.\n");
+		log("a constant driver. With -j the selected modules are processed in parallel\n");
+		log("using N threads.\n");
 		log("\n");
 	}
 	virtual void execute(std::vector<std::string> args, RTLIL::Design *design)
 	{
-		int total_count = 0, total_initdrv = 0;
+		std::atomic<int> total_count(0), total_initdrv(0);
+		int num_threads = 0;
 		log_header(design, "Executing OPT_RMDFF pass (remove dff with constant values).\n");
 
 		keepdc = false;
@@ -228,17 +230,22 @@ struct OptRmdffPass : public Pass {
 				keepdc = true;
 				continue;
 			}
+			if (args[argidx] == "-j" && argidx+1 < args.size()) {
+				num_threads = std::max(atoi(args[++argidx].c_str()), 1);
+				continue;
+			}
 			break;
 		}
 		extra_args(args, argidx, design);
 
-		for (auto module : design->selected_modules())
+		parallel_for_modules(design->selected_modules(), num_threads, [&](RTLIL::Module *module)
 		{
 			pool<SigBit> driven_bits;
 			dict<SigBit, State> init_bits;
 
 			assign_map.set(module);
 			dff_init_map.set(module);
+			init_attributes.clear();
 
 			for (auto wire : module->wires())
 			{
@@ -326,7 +333,7 @@ struct OptRmdffPass : public Pass {
 				remove_init_attr(sig);
 				total_initdrv++;
 			}
-		}
+		});
 
 		assign_map.clear();
 		mux_drivers.clear();
@@ -335,10 +342,10 @@ struct OptRmdffPass : public Pass {
 			design->scratchpad_set_bool("opt.did_something", true);
 
 		if (total_initdrv)
-			log("Promoted %d init specs to constant drivers.\n", total_initdrv);
+			log("Promoted %d init specs to constant drivers.\n", int(total_initdrv));
 
 		if (total_count)
-			log("Replaced %d DFF cells.\n", total_count);
+			log("Replaced %d DFF cells.\n", int(total_count));
 	}
 } OptRmdffPass;
 
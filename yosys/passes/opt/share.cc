@@ -19,6 +19,7 @@
 
 #include "kernel/yosys.h"
 #include "kernel/satgen.h"
+#include "kernel/bitsim.h"
 #include "kernel/sigtools.h"
 #include "kernel/modtools.h"
 #include "kernel/utils.h"
@@ -36,6 +37,7 @@ struct ShareWorkerConfig
 	bool opt_force;
 	bool opt_aggressive;
 	bool opt_fast;
+	bool opt_nosim;
 	pool<RTLIL::IdString> generic_uni_ops, generic_bin_ops, generic_cbin_ops, generic_other_ops;
 };
 
@@ -1288,13 +1290,69 @@ struct ShareWorker
 						ez->assume(ez->NOT(ez->AND(sub1, sub2)));
 					}
 
-				if (!ez->solve(ez->expression(ez->OpOr, cell_active))) {
+				// random simulation of the control logic: patterns that activate the cells
+				// are models for the SAT problems below, so those don't need to be solved
+				uint64_t sim_cell_active = 0, sim_other_cell_active = 0, sim_both_active = 0;
+				int sim_word = 0;
+
+				if (!config.opt_nosim)
+				{
+					BitSim sim(&modwalker.sigmap);
+					for (auto c : sat_cells)
+						sim.add_cell(c);
+					sim.add_signal(all_ctrl_signals);
+					sim.randomize();
+					sim.simulate();
+
+					auto sim_active = [&](const pool<ssc_pair_t> &patterns, int w) {
+						uint64_t active = 0;
+						for (auto &p : patterns) {
+							uint64_t match = ~uint64_t(0);
+							for (int i = 0; i < GetSize(p.first); i++)
+								match &= p.second.bits[i] > RTLIL::State::S1 ? 0 : sim.get_mask(p.first[i], w, p.second.bits[i] == RTLIL::State::S1);
+							active |= match;
+						}
+						return active;
+					};
+
+					for (int w = 0; w < sim.num_words; w++)
+					{
+						uint64_t valid = ~uint64_t(0);
+						for (auto it : exclusive_ctrls)
+							if (sim.known(it.first) && sim.known(it.second))
+								valid &= sim.get_mask(it.first, w, false) | sim.get_mask(it.second, w, false);
+
+						uint64_t active_a = sim_active(filtered_cell_activation_patterns, w) & valid;
+						uint64_t active_b = sim_active(filtered_other_cell_activation_patterns, w) & valid;
+
+						sim_cell_active |= active_a;
+						sim_other_cell_active |= active_b;
+						if (sim_both_active == 0 && (active_a & active_b) != 0)
+							sim_both_active = active_a & active_b, sim_word = w;
+					}
+
+					if (sim_both_active != 0) {
+						all_ctrl_signals.sort_and_unify();
+						int lane = 0;
+						while (((sim_both_active >> lane) & 1) == 0)
+							lane++;
+						log("      According to the simulation this pair of cells can not be shared.\n");
+						log("      Pattern from simulation: %s = %d'", log_signal(all_ctrl_signals), GetSize(all_ctrl_signals));
+						for (int i = GetSize(all_ctrl_signals)-1; i >= 0; i--)
+							log("%c", (sim.get_undef(all_ctrl_signals[i], sim_word) >> lane) & 1 ? 'x' :
+									(sim.get(all_ctrl_signals[i], sim_word) >> lane) & 1 ? '1' : '0');
+						log("\n");
+						continue;
+					}
+				}
+
+				if (!sim_cell_active && !ez->solve(ez->expression(ez->OpOr, cell_active))) {
 					log("      According to the SAT solver the cell %s is never active. Sharing is pointless, we simply remove it.\n", log_id(cell));
 					cells_to_remove.insert(cell);
 					break;
 				}
 
-				if (!ez->solve(ez->expression(ez->OpOr, other_cell_active))) {
+				if (!sim_other_cell_active && !ez->solve(ez->expression(ez->OpOr, other_cell_active))) {
 					log("      According to the SAT solver the cell %s is never active. Sharing is pointless, we simply remove it.\n", log_id(other_cell));
 					cells_to_remove.insert(other_cell);
 					shareable_cells.erase(other_cell);
@@ -1452,6 +1510,11 @@ struct SharePass : public Pass {
 		log("  -limit N\n");
 		log("    Only perform the first N merges, then stop. This is useful for debugging.\n");
 		log("\n");
+		log("  -nosim\n");
+		log("    Per default random simulation of the control logic is used to find cells\n");
+		log("    that are active at the same time without calling the SAT solver. This\n");
+		log("    option disables the simulation.\n");
+		log("\n");
 	}
 	virtual void execute(std::vector<std::string> args, RTLIL::Design *design)
 	{
@@ -1461,6 +1524,7 @@ struct SharePass : public Pass {
 		config.opt_force = false;
 		config.opt_aggressive = false;
 		config.opt_fast = false;
+		config.opt_nosim = false;
 
 		config.generic_uni_ops.insert("$not");
 		// config.generic_uni_ops.insert("$pos");
@@ -1520,6 +1584,10 @@ struct SharePass : public Pass {
 				config.limit = atoi(args[++argidx].c_str());
 				continue;
 			}
+			if (args[argidx] == "-nosim") {
+				config.opt_nosim = true;
+				continue;
+			}
 			break;
 		}
 		extra_args(args, argidx, design);
@@ -23,15 +23,17 @@
 #include "kernel/sigtools.h"
 #include "kernel/log.h"
 #include "kernel/satgen.h"
+#include "kernel/bitsim.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <algorithm>
+#include <limits>
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
 
-bool inv_mode;
+bool inv_mode, sim_mode;
 int verbose_level, reduce_counter, reduce_stop_at;
 typedef std::map<RTLIL::SigBit, std::pair<RTLIL::Cell*, std::set<RTLIL::SigBit>>> drivers_t;
 std::string dump_prefix;
@@ -76,12 +78,13 @@ struct FindReducedInputs
 	ezSatPtr ez;
 	std::set<RTLIL::Cell*> ez_cells;
 	SatGen satgen;
+	BitSim sim;
 
 	std::map<RTLIL::SigBit, int> sat_pi;
 	std::vector<int> sat_pi_uniq_bitvec;
 
 	FindReducedInputs(SigMap &sigmap, drivers_t &drivers) :
-			sigmap(sigmap), drivers(drivers), satgen(ez.get(), &sigmap)
+			sigmap(sigmap), drivers(drivers), satgen(ez.get(), &sigmap), sim(&sigmap)
 	{
 		satgen.model_undef = true;
 	}
@@ -148,6 +151,7 @@ struct FindReducedInputs
 				if (!satgen.importCell(drv.first))
 					log_abort();
 				ez_cells.insert(drv.first);
+				sim.add_cell(drv.first);
 			}
 			for (auto &bit : drv.second)
 				register_cone_worker(pi, sigdone, bit);
@@ -165,6 +169,46 @@ struct FindReducedInputs
 		pi.insert(pi.end(), pi_set.begin(), pi_set.end());
 	}
 
+	// flip each input in a different simulation pattern and check if the output changes
+	void simulate_inputs(std::vector<RTLIL::SigBit> &pi, RTLIL::SigBit output, std::set<int> &unused_pi_idx)
+	{
+		int found_count = 0;
+
+		for (int offset = 0; offset < GetSize(pi); offset += 64)
+		{
+			std::vector<uint64_t> base_value, base_undef;
+
+			sim.randomize();
+			sim.simulate();
+
+			for (int w = 0; w < sim.num_words; w++) {
+				base_value.push_back(sim.get(output, w));
+				base_undef.push_back(sim.get_undef(output, w));
+			}
+
+			for (int i = offset; i < GetSize(pi) && i < offset + 64; i++)
+				for (int w = 0; w < sim.num_words; w++)
+					sim.set(pi[i], w, sim.get(pi[i], w) ^ (uint64_t(1) << (i - offset)));
+
+			sim.simulate();
+
+			uint64_t changed = 0;
+			for (int w = 0; w < sim.num_words; w++)
+				changed |= (base_value[w] ^ sim.get(output, w)) & ~(base_undef[w] | sim.get_undef(output, w));
+
+			for (int i = offset; i < GetSize(pi) && i < offset + 64; i++)
+				if ((changed >> (i - offset)) & 1) {
+					if (verbose_level >= 2)
+						log("         Found relevant input: %s\n", log_signal(pi[i]));
+					unused_pi_idx.erase(i);
+					found_count++;
+				}
+		}
+
+		if (verbose_level >= 1)
+			log("         Simulation found %d relevant inputs.\n", found_count);
+	}
+
 	void analyze(std::vector<RTLIL::SigBit> &reduced_inputs, RTLIL::SigBit output, int prec)
 	{
 		if (verbose_level >= 1)
@@ -189,6 +233,9 @@ struct FindReducedInputs
 		for (size_t i = 0; i < pi.size(); i++)
 			unused_pi_idx.insert(i);
 
+		if (sim_mode)
+			simulate_inputs(pi, output, unused_pi_idx);
+
 		while (1)
 		{
 			std::vector<int> model_pi_idx;
@@ -233,6 +280,8 @@ struct PerformReduction
 
 	ezSatPtr ez;
 	SatGen satgen;
+	BitSim sim;
+	int sim_patterns;
 
 	std::vector<int> sat_pi, sat_out, sat_def;
 	std::vector<RTLIL::SigBit> out_bits, pi_bits;
@@ -262,6 +311,7 @@ struct PerformReduction
 				if (!satgen.importCell(drv.first))
 					log_error("Can't create SAT model for cell %s (%s)!\n", RTLIL::id2cstr(drv.first->name), RTLIL::id2cstr(drv.first->type));
 				celldone.insert(drv.first);
+				sim.add_cell(drv.first);
 			}
 			int max_child_depth = 0;
 			for (auto &bit : drv.second)
@@ -279,7 +329,8 @@ struct PerformReduction
 	}
 
 	PerformReduction(SigMap &sigmap, drivers_t &drivers, std::set<std::pair<RTLIL::SigBit, RTLIL::SigBit>> &inv_pairs, std::vector<RTLIL::SigBit> &bits, int cone_size) :
-			sigmap(sigmap), drivers(drivers), inv_pairs(inv_pairs), satgen(ez.get(), &sigmap), out_bits(bits), cone_size(cone_size)
+			sigmap(sigmap), drivers(drivers), inv_pairs(inv_pairs), satgen(ez.get(), &sigmap), sim(&sigmap), sim_patterns(0),
+			out_bits(bits), cone_size(cone_size)
 	{
 		satgen.model_undef = true;
 
@@ -300,6 +351,50 @@ struct PerformReduction
 					sat_out[i] = ez->NOT(sat_out[i]);
 		} else
 			out_inverted = std::vector<bool>(sat_out.size(), false);
+
+		if (sim_mode) {
+			sim.randomize();
+			sim.simulate();
+		}
+	}
+
+	// signals that are defined in all simulation patterns are grouped by their values,
+	// all other signals are added to every group (like undef signals in analyze())
+	bool simulate_bucket(std::vector<int> &bucket, std::vector<std::vector<int>> &groups)
+	{
+		std::map<std::vector<uint64_t>, int> value_groups;
+		std::vector<int> undef_bits;
+
+		for (int idx : bucket) {
+			if (!sim.fully_defined(out_bits[idx])) {
+				undef_bits.push_back(idx);
+				continue;
+			}
+			std::vector<uint64_t> key;
+			for (int w = 0; w < sim.num_words; w++)
+				key.push_back(out_inverted[idx] ? ~sim.get(out_bits[idx], w) : sim.get(out_bits[idx], w));
+			if (value_groups.count(key) == 0) {
+				value_groups[key] = GetSize(groups);
+				groups.push_back(std::vector<int>());
+			}
+			groups[value_groups.at(key)].push_back(idx);
+		}
+
+		if (GetSize(groups) <= 1)
+			return false;
+
+		for (auto &group : groups)
+			group.insert(group.end(), undef_bits.begin(), undef_bits.end());
+		return true;
+	}
+
+	// use the input values from a SAT model as new simulation pattern
+	void add_sim_pattern(std::vector<bool> &model)
+	{
+		int lane = (sim.num_words - 1) * 64 + (sim_patterns++ % 64);
+		for (size_t i = 0; i < pi_bits.size(); i++)
+			sim.set_lane(pi_bits[i], lane, model[2*sat_out.size() + i]);
+		sim.simulate(sim.num_words - 1);
 	}
 
 	void analyze_const(std::vector<std::vector<equiv_bit_t>> &results, int idx)
@@ -364,6 +459,17 @@ struct PerformReduction
 			log("%s  Trying to shatter bucket with %d signals: %s\n", indt, int(bucket.size()), log_signal(bucket_sigbits));
 		}
 
+		if (sim_mode) {
+			std::vector<std::vector<int>> groups;
+			if (simulate_bucket(bucket, groups)) {
+				if (verbose_level >= 1)
+					log("%s    Simulation shattered bucket into %d groups.\n", indt, GetSize(groups));
+				for (auto &group : groups)
+					analyze(results, results_map, group, indent1 + "s", indent2 + "  ");
+				return;
+			}
+		}
+
 		std::vector<int> sat_set_list, sat_clr_list;
 		for (int idx : bucket) {
 			sat_set_list.push_back(ez->AND(sat_out[idx], sat_def[idx]));
@@ -374,7 +480,7 @@ struct PerformReduction
 		std::vector<bool> model;
 
 		modelVars.insert(modelVars.end(), sat_def.begin(), sat_def.end());
-		if (verbose_level >= 2)
+		if (verbose_level >= 2 || sim_mode)
 			modelVars.insert(modelVars.end(), sat_pi.begin(), sat_pi.end());
 
 		if (ez->solve(modelVars, model, ez->expression(ezSAT::OpOr, sat_set_list), ez->expression(ezSAT::OpOr, sat_clr_list)))
@@ -401,6 +507,9 @@ struct PerformReduction
 				iter_count++;
 			}
 
+			if (sim_mode)
+				add_sim_pattern(model);
+
 			if (verbose_level >= 1) {
 				int count_set = 0, count_clr = 0, count_undef = 0;
 				for (int idx : bucket)
@@ -775,6 +884,10 @@ struct FreducePass : public Pass {
 		log("    -inv\n");
 		log("        enable explicit handling of inverted signals\n");
 		log("\n");
+		log("    -nosim\n");
+		log("        do not use random simulation to find non-equivalent signals and\n");
+		log("        relevant inputs before calling the SAT solver\n");
+		log("\n");
 		log("    -stop <n>\n");
 		log("        stop after <n> reduction operations. this is mostly used for\n");
 		log("        debugging the freduce command itself.\n");
@@ -796,6 +909,7 @@ struct FreducePass : public Pass {
 		reduce_stop_at = 0;
 		verbose_level = 0;
 		inv_mode = false;
+		sim_mode = true;
 		dump_prefix = std::string();
 
 		log_header(design, "Executing FREDUCE pass (perform functional reduction).\n");
@@ -814,6 +928,10 @@ struct FreducePass : public Pass {
 				inv_mode = true;
 				continue;
 			}
+			if (args[argidx] == "-nosim") {
+				sim_mode = false;
+				continue;
+			}
 			if (args[argidx] == "-stop" && argidx+1 < args.size()) {
 				reduce_stop_at = atoi(args[++argidx].c_str());
 				continue;
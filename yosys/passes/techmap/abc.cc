@@ -59,6 +59,7 @@
 #endif
 
 #include "frontends/blif/blifparse.h"
+#include "passes/techmap/abc_link.h"
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
@@ -97,17 +98,62 @@ bool map_mux8;
 bool map_mux16;
 
 bool markgroups;
-int map_autoidx;
-SigMap assign_map;
-RTLIL::Module *module;
-std::vector<gate_t> signal_list;
-std::map<RTLIL::SigBit, int> signal_map;
 pool<std::string> enabled_gates;
 
-bool clk_polarity, en_polarity;
-RTLIL::SigSpec clk_sig, en_sig;
+// The state for mapping one module (or one clock domain of a module) with ABC.
+// prepare() and finish() modify the design and must be called from the main
+// thread. run() only executes ABC and can be called from a worker thread.
+struct AbcJob
+{
+	RTLIL::Design *design;
+	RTLIL::Module *module;
+	int map_autoidx;
+	SigMap assign_map;
+	std::vector<gate_t> signal_list;
+	std::map<RTLIL::SigBit, int> signal_map;
+
+	bool clk_polarity, en_polarity;
+	RTLIL::SigSpec clk_sig, en_sig;
+
+	// in batch mode the extracted cells are removed by the caller once all
+	// jobs are prepared, and the ABC output is buffered until finish()
+	bool batch_mode;
+	std::vector<RTLIL::Cell*> cells;
+	pool<RTLIL::Cell*> extracted_cells;
+
+	bool linked_abc, builtin_lib, cleanup, show_tempdir, sop_mode;
+	std::string tempdir_name, abc_script, abc_command, abc_output, genlib;
+	std::vector<int> lut_costs;
+	AbcNetlist netlist;
+	int count_output, abc_ret;
+	RTLIL::Design *mapped_design;
+
+	AbcJob(RTLIL::Design *design, RTLIL::Module *module, bool batch_mode) : design(design), module(module), batch_mode(batch_mode)
+	{
+		clk_polarity = true;
+		en_polarity = true;
+		count_output = 0;
+		abc_ret = 0;
+		mapped_design = nullptr;
+	}
+
+	int map_signal(RTLIL::SigBit bit, gate_type_t gate_type = G(NONE), int in1 = -1, int in2 = -1, int in3 = -1, int in4 = -1);
+	void mark_port(RTLIL::SigSpec sig);
+	void extract_cell(RTLIL::Cell *cell, bool keepff);
+	void remove_extracted_cells();
+	std::string remap_name(RTLIL::IdString abc_name);
+	void dump_loop_graph(FILE *f, int &nr, std::map<int, std::set<int>> &edges, std::set<int> &workpool, std::vector<int> &in_counts);
+	void handle_loops();
+
+	void prepare(std::string script_file, std::string exe_file, std::string liberty_file, std::string constr_file, bool cleanup,
+			vector<int> lut_costs, bool dff_mode, std::string clk_str, bool keepff, std::string delay_target, std::string sop_inputs,
+			std::string sop_products, std::string lutin_shared, bool fast_mode, const std::vector<RTLIL::Cell*> &cells,
+			bool show_tempdir, bool sop_mode);
+	void run();
+	void finish();
+};
 
-int map_signal(RTLIL::SigBit bit, gate_type_t gate_type = G(NONE), int in1 = -1, int in2 = -1, int in3 = -1, int in4 = -1)
+int AbcJob::map_signal(RTLIL::SigBit bit, gate_type_t gate_type, int in1, int in2, int in3, int in4)
 {
 	assign_map.apply(bit);
 
@@ -141,14 +187,14 @@ int map_signal(RTLIL::SigBit bit, gate_type_t gate_type = G(NONE), int in1 = -1,
 	return gate.id;
 }
 
-void mark_port(RTLIL::SigSpec sig)
+void AbcJob::mark_port(RTLIL::SigSpec sig)
 {
 	for (auto &bit : assign_map(sig))
 		if (bit.wire != NULL && signal_map.count(bit) > 0)
 			signal_list[signal_map[bit]].is_port = true;
 }
 
-void extract_cell(RTLIL::Cell *cell, bool keepff)
+void AbcJob::extract_cell(RTLIL::Cell *cell, bool keepff)
 {
 	if (cell->type == "$_DFF_N_" || cell->type == "$_DFF_P_")
 	{
@@ -189,7 +235,7 @@ void extract_cell(RTLIL::Cell *cell, bool keepff)
 
 		map_signal(sig_q, G(FF), map_signal(sig_d));
 
-		module->remove(cell);
+		extracted_cells.insert(cell);
 		return;
 	}
 
@@ -203,7 +249,7 @@ void extract_cell(RTLIL::Cell *cell, bool keepff)
 
 		map_signal(sig_y, cell->type == "$_BUF_" ? G(BUF) : G(NOT), map_signal(sig_a));
 
-		module->remove(cell);
+		extracted_cells.insert(cell);
 		return;
 	}
 
@@ -235,7 +281,7 @@ void extract_cell(RTLIL::Cell *cell, bool keepff)
 		else
 			log_abort();
 
-		module->remove(cell);
+		extracted_cells.insert(cell);
 		return;
 	}
 
@@ -257,7 +303,7 @@ void extract_cell(RTLIL::Cell *cell, bool keepff)
 
 		map_signal(sig_y, G(MUX), mapped_a, mapped_b, mapped_s);
 
-		module->remove(cell);
+		extracted_cells.insert(cell);
 		return;
 	}
 
@@ -279,7 +325,7 @@ void extract_cell(RTLIL::Cell *cell, bool keepff)
 
 		map_signal(sig_y, cell->type == "$_AOI3_" ? G(AOI3) : G(OAI3), mapped_a, mapped_b, mapped_c);
 
-		module->remove(cell);
+		extracted_cells.insert(cell);
 		return;
 	}
 
@@ -304,19 +350,27 @@ void extract_cell(RTLIL::Cell *cell, bool keepff)
 
 		map_signal(sig_y, cell->type == "$_AOI4_" ? G(AOI4) : G(OAI4), mapped_a, mapped_b, mapped_c, mapped_d);
 
-		module->remove(cell);
+		extracted_cells.insert(cell);
 		return;
 	}
 }
 
-std::string remap_name(RTLIL::IdString abc_name)
+void AbcJob::remove_extracted_cells()
+{
+	for (auto c : cells)
+		if (extracted_cells.count(c))
+			module->remove(c);
+	extracted_cells.clear();
+}
+
+std::string AbcJob::remap_name(RTLIL::IdString abc_name)
 {
 	std::stringstream sstr;
 	sstr << "$abc$" << map_autoidx << "$" << abc_name.substr(1);
 	return sstr.str();
 }
 
-void dump_loop_graph(FILE *f, int &nr, std::map<int, std::set<int>> &edges, std::set<int> &workpool, std::vector<int> &in_counts)
+void AbcJob::dump_loop_graph(FILE *f, int &nr, std::map<int, std::set<int>> &edges, std::set<int> &workpool, std::vector<int> &in_counts)
 {
 	if (f == NULL)
 		return;
@@ -345,7 +399,7 @@ void dump_loop_graph(FILE *f, int &nr, std::map<int, std::set<int>> &edges, std:
 	fprintf(f, "}\n");
 }
 
-void handle_loops()
+void AbcJob::handle_loops()
 {
 	// http://en.wikipedia.org/wiki/Topological_sorting
 	// (Kahn, Arthur B. (1962), "Topological sorting of large networks")
@@ -524,7 +578,7 @@ std::string replace_tempdir(std::string text, std::string tempdir_name, bool sho
 	if (show_tempdir)
 		return text;
 
-	while (1) {
+	while (!tempdir_name.empty()) {
 		size_t pos = text.find(tempdir_name);
 		if (pos == std::string::npos)
 			break;
@@ -593,46 +647,77 @@ struct abc_output_filter
 	}
 };
 
-void abc_module(RTLIL::Design *design, RTLIL::Module *current_module, std::string script_file, std::string exe_file,
-		std::string liberty_file, std::string constr_file, bool cleanup, vector<int> lut_costs, bool dff_mode, std::string clk_str,
-		bool keepff, std::string delay_target, std::string sop_inputs, std::string sop_products, std::string lutin_shared, bool fast_mode,
-		const std::vector<RTLIL::Cell*> &cells, bool show_tempdir, bool sop_mode)
+const char *gate_cover(gate_type_t type)
 {
-	module = current_module;
-	map_autoidx = autoidx++;
+	switch (type)
+	{
+	case G(BUF):  return "1 1\n";
+	case G(NOT):  return "0 1\n";
+	case G(AND):  return "11 1\n";
+	case G(NAND): return "0- 1\n-0 1\n";
+	case G(OR):   return "-1 1\n1- 1\n";
+	case G(NOR):  return "00 1\n";
+	case G(XOR):  return "01 1\n10 1\n";
+	case G(XNOR): return "00 1\n11 1\n";
+	case G(MUX):  return "1-0 1\n-11 1\n";
+	case G(AOI3): return "-00 1\n0-0 1\n";
+	case G(OAI3): return "00- 1\n--0 1\n";
+	case G(AOI4): return "-0-0 1\n-00- 1\n0--0 1\n0-0- 1\n";
+	case G(OAI4): return "00-- 1\n--00 1\n";
+	default:      log_abort();
+	}
+}
 
-	signal_map.clear();
-	signal_list.clear();
+void AbcJob::prepare(std::string script_file, std::string exe_file, std::string liberty_file, std::string constr_file, bool cleanup,
+		vector<int> lut_costs, bool dff_mode, std::string clk_str, bool keepff, std::string delay_target, std::string sop_inputs,
+		std::string sop_products, std::string lutin_shared, bool fast_mode, const std::vector<RTLIL::Cell*> &cells,
+		bool show_tempdir, bool sop_mode)
+{
+	map_autoidx = autoidx++;
+	assign_map.set(module);
 
-	if (clk_str != "$")
-	{
-		assign_map.set(module);
+	this->cells = cells;
+	this->cleanup = cleanup;
+	this->show_tempdir = show_tempdir;
+	this->sop_mode = sop_mode;
+	this->lut_costs = lut_costs;
 
-		clk_polarity = true;
+	// for clk_str == "$" the caller has set up the clock domain
+	if (clk_str != "$") {
 		clk_sig = RTLIL::SigSpec();
-
-		en_polarity = true;
 		en_sig = RTLIL::SigSpec();
 	}
-
-	std::string tempdir_name = "/tmp/yosys-abc-XXXXXX";
-	if (!cleanup)
-		tempdir_name[0] = tempdir_name[4] = '_';
-	tempdir_name = make_temp_dir(tempdir_name);
-	log_header(design, "Extracting gate netlist of module `%s' to `%s/input.blif'..\n",
-			module->name.c_str(), replace_tempdir(tempdir_name, tempdir_name, show_tempdir).c_str());
-
-	std::string abc_script = stringf("read_blif %s/input.blif; ", tempdir_name.c_str());
+	clk_sig = assign_map(clk_sig);
+	en_sig = assign_map(en_sig);
+
+	// an empty exe_file means that the ABC library linked into Yosys is used:
+	// the netlist and the libraries are passed in memory, no temp files needed
+	linked_abc = exe_file.empty();
+	log_assert(!linked_abc || !batch_mode);
+
+	if (linked_abc) {
+		log_header(design, "Extracting gate netlist of module `%s'..\n", module->name.c_str());
+	} else {
+		tempdir_name = "/tmp/yosys-abc-XXXXXX";
+		if (!cleanup)
+			tempdir_name[0] = tempdir_name[4] = '_';
+		tempdir_name = make_temp_dir(tempdir_name);
+		log_header(design, "Extracting gate netlist of module `%s' to `%s/input.blif'..\n",
+				module->name.c_str(), replace_tempdir(tempdir_name, tempdir_name, show_tempdir).c_str());
+		abc_script += stringf("read_blif %s/input.blif; ", tempdir_name.c_str());
+	}
 
 	if (!liberty_file.empty()) {
 		abc_script += stringf("read_lib -w %s; ", liberty_file.c_str());
 		if (!constr_file.empty())
 			abc_script += stringf("read_constr -v %s; ", constr_file.c_str());
 	} else
-	if (!lut_costs.empty())
-		abc_script += stringf("read_lut %s/lutdefs.txt; ", tempdir_name.c_str());
-	else
-		abc_script += stringf("read_library %s/stdcells.genlib; ", tempdir_name.c_str());
+	if (!linked_abc) {
+		if (!lut_costs.empty())
+			abc_script += stringf("read_lut %s/lutdefs.txt; ", tempdir_name.c_str());
+		else
+			abc_script += stringf("read_library %s/stdcells.genlib; ", tempdir_name.c_str());
+	}
 
 	if (!script_file.empty()) {
 		if (script_file[0] == '+') {
@@ -676,16 +761,20 @@ void abc_module(RTLIL::Design *design, RTLIL::Module *current_module, std::strin
 	for (size_t pos = abc_script.find("{S}"); pos != std::string::npos; pos = abc_script.find("{S}", pos))
 		abc_script = abc_script.substr(0, pos) + lutin_shared + abc_script.substr(pos+3);
 
-	abc_script += stringf("; write_blif %s/output.blif", tempdir_name.c_str());
+	if (!linked_abc)
+		abc_script += stringf("; write_blif %s/output.blif", tempdir_name.c_str());
 	abc_script = add_echos_to_abc_cmd(abc_script);
 
-	for (size_t i = 0; i+1 < abc_script.size(); i++)
-		if (abc_script[i] == ';' && abc_script[i+1] == ' ')
-			abc_script[i+1] = '\n';
+	if (!linked_abc)
+	{
+		for (size_t i = 0; i+1 < abc_script.size(); i++)
+			if (abc_script[i] == ';' && abc_script[i+1] == ' ')
+				abc_script[i+1] = '\n';
 
-	FILE *f = fopen(stringf("%s/abc.script", tempdir_name.c_str()).c_str(), "wt");
-	fprintf(f, "%s\n", abc_script.c_str());
-	fclose(f);
+		FILE *f = fopen(stringf("%s/abc.script", tempdir_name.c_str()).c_str(), "wt");
+		fprintf(f, "%s\n", abc_script.c_str());
+		fclose(f);
+	}
 
 	if (!clk_str.empty() && clk_str != "$")
 	{
@@ -731,9 +820,15 @@ void abc_module(RTLIL::Design *design, RTLIL::Module *current_module, std::strin
 			mark_port(RTLIL::SigSpec(wire_it.second));
 	}
 
-	for (auto &cell_it : module->cells_)
-	for (auto &port_it : cell_it.second->connections())
-		mark_port(port_it.second);
+	for (auto &cell_it : module->cells_) {
+		if (extracted_cells.count(cell_it.second))
+			continue;
+		for (auto &port_it : cell_it.second->connections())
+			mark_port(port_it.second);
+	}
+
+	if (!batch_mode)
+		remove_extracted_cells();
 
 	if (clk_sig.size() != 0)
 		mark_port(clk_sig);
@@ -743,109 +838,75 @@ void abc_module(RTLIL::Design *design, RTLIL::Module *current_module, std::strin
 
 	handle_loops();
 
-	std::string buffer = stringf("%s/input.blif", tempdir_name.c_str());
-	f = fopen(buffer.c_str(), "wt");
-	if (f == NULL)
-		log_error("Opening %s for writing failed: %s\n", buffer.c_str(), strerror(errno));
+	int count_gates = 0;
 
-	fprintf(f, ".model netlist\n");
+	for (auto &si : signal_list) {
+		if (si.is_port && si.type == G(NONE))
+			netlist.inputs.push_back(si.id);
+		if (si.is_port && si.type != G(NONE))
+			netlist.outputs.push_back(si.id);
+	}
 
-	int count_input = 0;
-	fprintf(f, ".inputs");
 	for (auto &si : signal_list) {
-		if (!si.is_port || si.type != G(NONE))
-			continue;
-		fprintf(f, " n%d", si.id);
-		count_input++;
+		if (si.bit.wire == NULL)
+			netlist.nodes.push_back({std::vector<int>(), si.id, si.bit == RTLIL::State::S1 ? "1\n" : ""});
 	}
-	if (count_input == 0)
-		fprintf(f, " dummy_input\n");
-	fprintf(f, "\n");
 
-	int count_output = 0;
-	fprintf(f, ".outputs");
 	for (auto &si : signal_list) {
-		if (!si.is_port || si.type == G(NONE))
+		if (si.type == G(NONE))
 			continue;
-		fprintf(f, " n%d", si.id);
-		count_output++;
+		int in[4] = { si.in1, si.in2, si.in3, si.in4 };
+		const char *cover = si.type == G(FF) ? nullptr : gate_cover(si.type);
+		int width = cover ? strchr(cover, ' ') - cover : 1;
+		netlist.nodes.push_back({std::vector<int>(in, in + width), si.id, cover});
+		count_gates++;
 	}
-	fprintf(f, "\n");
 
-	for (auto &si : signal_list)
-		fprintf(f, "# n%-5d %s\n", si.id, log_signal(si.bit));
+	int count_input = GetSize(netlist.inputs);
+	count_output = GetSize(netlist.outputs);
 
-	for (auto &si : signal_list) {
-		if (si.bit.wire == NULL) {
-			fprintf(f, ".names n%d\n", si.id);
-			if (si.bit == RTLIL::State::S1)
-				fprintf(f, "1\n");
+	std::string buffer;
+	FILE *f;
+
+	if (!linked_abc)
+	{
+		buffer = stringf("%s/input.blif", tempdir_name.c_str());
+		f = fopen(buffer.c_str(), "wt");
+		if (f == NULL)
+			log_error("Opening %s for writing failed: %s\n", buffer.c_str(), strerror(errno));
+
+		fprintf(f, ".model netlist\n");
+
+		fprintf(f, ".inputs");
+		for (int id : netlist.inputs)
+			fprintf(f, " n%d", id);
+		if (count_input == 0)
+			fprintf(f, " dummy_input\n");
+		fprintf(f, "\n");
+
+		fprintf(f, ".outputs");
+		for (int id : netlist.outputs)
+			fprintf(f, " n%d", id);
+		fprintf(f, "\n");
+
+		for (auto &si : signal_list)
+			fprintf(f, "# n%-5d %s\n", si.id, log_signal(si.bit));
+
+		for (auto &node : netlist.nodes) {
+			if (node.cover == nullptr) {
+				fprintf(f, ".latch n%d n%d\n", node.inputs.at(0), node.output);
+				continue;
+			}
+			fprintf(f, ".names");
+			for (int id : node.inputs)
+				fprintf(f, " n%d", id);
+			fprintf(f, " n%d\n%s", node.output, node.cover);
 		}
-	}
 
-	int count_gates = 0;
-	for (auto &si : signal_list) {
-		if (si.type == G(BUF)) {
-			fprintf(f, ".names n%d n%d\n", si.in1, si.id);
-			fprintf(f, "1 1\n");
-		} else if (si.type == G(NOT)) {
-			fprintf(f, ".names n%d n%d\n", si.in1, si.id);
-			fprintf(f, "0 1\n");
-		} else if (si.type == G(AND)) {
-			fprintf(f, ".names n%d n%d n%d\n", si.in1, si.in2, si.id);
-			fprintf(f, "11 1\n");
-		} else if (si.type == G(NAND)) {
-			fprintf(f, ".names n%d n%d n%d\n", si.in1, si.in2, si.id);
-			fprintf(f, "0- 1\n");
-			fprintf(f, "-0 1\n");
-		} else if (si.type == G(OR)) {
-			fprintf(f, ".names n%d n%d n%d\n", si.in1, si.in2, si.id);
-			fprintf(f, "-1 1\n");
-			fprintf(f, "1- 1\n");
-		} else if (si.type == G(NOR)) {
-			fprintf(f, ".names n%d n%d n%d\n", si.in1, si.in2, si.id);
-			fprintf(f, "00 1\n");
-		} else if (si.type == G(XOR)) {
-			fprintf(f, ".names n%d n%d n%d\n", si.in1, si.in2, si.id);
-			fprintf(f, "01 1\n");
-			fprintf(f, "10 1\n");
-		} else if (si.type == G(XNOR)) {
-			fprintf(f, ".names n%d n%d n%d\n", si.in1, si.in2, si.id);
-			fprintf(f, "00 1\n");
-			fprintf(f, "11 1\n");
-		} else if (si.type == G(MUX)) {
-			fprintf(f, ".names n%d n%d n%d n%d\n", si.in1, si.in2, si.in3, si.id);
-			fprintf(f, "1-0 1\n");
-			fprintf(f, "-11 1\n");
-		} else if (si.type == G(AOI3)) {
-			fprintf(f, ".names n%d n%d n%d n%d\n", si.in1, si.in2, si.in3, si.id);
-			fprintf(f, "-00 1\n");
-			fprintf(f, "0-0 1\n");
-		} else if (si.type == G(OAI3)) {
-			fprintf(f, ".names n%d n%d n%d n%d\n", si.in1, si.in2, si.in3, si.id);
-			fprintf(f, "00- 1\n");
-			fprintf(f, "--0 1\n");
-		} else if (si.type == G(AOI4)) {
-			fprintf(f, ".names n%d n%d n%d n%d n%d\n", si.in1, si.in2, si.in3, si.in4, si.id);
-			fprintf(f, "-0-0 1\n");
-			fprintf(f, "-00- 1\n");
-			fprintf(f, "0--0 1\n");
-			fprintf(f, "0-0- 1\n");
-		} else if (si.type == G(OAI4)) {
-			fprintf(f, ".names n%d n%d n%d n%d n%d\n", si.in1, si.in2, si.in3, si.in4, si.id);
-			fprintf(f, "00-- 1\n");
-			fprintf(f, "--00 1\n");
-		} else if (si.type == G(FF)) {
-			fprintf(f, ".latch n%d n%d\n", si.in1, si.id);
-		} else if (si.type != G(NONE))
-			log_abort();
-		if (si.type != G(NONE))
-			count_gates++;
+		fprintf(f, ".end\n");
+		fclose(f);
 	}
 
-	fprintf(f, ".end\n");
-	fclose(f);
-
 	log("Extracted %d gates and %d wires to a netlist network with %d inputs and %d outputs.\n",
 			count_gates, GetSize(signal_list), count_input, count_output);
 	log_push();
@@ -854,45 +915,49 @@ void abc_module(RTLIL::Design *design, RTLIL::Module *current_module, std::strin
 	{
 		log_header(design, "Executing ABC.\n");
 
-		buffer = stringf("%s/stdcells.genlib", tempdir_name.c_str());
-		f = fopen(buffer.c_str(), "wt");
-		if (f == NULL)
-			log_error("Opening %s for writing failed: %s\n", buffer.c_str(), strerror(errno));
-		fprintf(f, "GATE ZERO  1 Y=CONST0;\n");
-		fprintf(f, "GATE ONE   1 Y=CONST1;\n");
-		fprintf(f, "GATE BUF  %d Y=A;                  PIN * NONINV  1 999 1 0 1 0\n", get_cell_cost("$_BUF_"));
-		fprintf(f, "GATE NOT  %d Y=!A;                 PIN * INV     1 999 1 0 1 0\n", get_cell_cost("$_NOT_"));
+		genlib += stringf("GATE ZERO  1 Y=CONST0;\n");
+		genlib += stringf("GATE ONE   1 Y=CONST1;\n");
+		genlib += stringf("GATE BUF  %d Y=A;                  PIN * NONINV  1 999 1 0 1 0\n", get_cell_cost("$_BUF_"));
+		genlib += stringf("GATE NOT  %d Y=!A;                 PIN * INV     1 999 1 0 1 0\n", get_cell_cost("$_NOT_"));
 		if (enabled_gates.empty() || enabled_gates.count("AND"))
-			fprintf(f, "GATE AND  %d Y=A*B;                PIN * NONINV  1 999 1 0 1 0\n", get_cell_cost("$_AND_"));
+			genlib += stringf("GATE AND  %d Y=A*B;                PIN * NONINV  1 999 1 0 1 0\n", get_cell_cost("$_AND_"));
 		if (enabled_gates.empty() || enabled_gates.count("NAND"))
-			fprintf(f, "GATE NAND %d Y=!(A*B);             PIN * INV     1 999 1 0 1 0\n", get_cell_cost("$_NAND_"));
+			genlib += stringf("GATE NAND %d Y=!(A*B);             PIN * INV     1 999 1 0 1 0\n", get_cell_cost("$_NAND_"));
 		if (enabled_gates.empty() || enabled_gates.count("OR"))
-			fprintf(f, "GATE OR   %d Y=A+B;                PIN * NONINV  1 999 1 0 1 0\n", get_cell_cost("$_OR_"));
+			genlib += stringf("GATE OR   %d Y=A+B;                PIN * NONINV  1 999 1 0 1 0\n", get_cell_cost("$_OR_"));
 		if (enabled_gates.empty() || enabled_gates.count("NOR"))
-			fprintf(f, "GATE NOR  %d Y=!(A+B);             PIN * INV     1 999 1 0 1 0\n", get_cell_cost("$_NOR_"));
+			genlib += stringf("GATE NOR  %d Y=!(A+B);             PIN * INV     1 999 1 0 1 0\n", get_cell_cost("$_NOR_"));
 		if (enabled_gates.empty() || enabled_gates.count("XOR"))
-			fprintf(f, "GATE XOR  %d Y=(A*!B)+(!A*B);      PIN * UNKNOWN 1 999 1 0 1 0\n", get_cell_cost("$_XOR_"));
+			genlib += stringf("GATE XOR  %d Y=(A*!B)+(!A*B);      PIN * UNKNOWN 1 999 1 0 1 0\n", get_cell_cost("$_XOR_"));
 		if (enabled_gates.empty() || enabled_gates.count("XNOR"))
-			fprintf(f, "GATE XNOR %d Y=(A*B)+(!A*!B);      PIN * UNKNOWN 1 999 1 0 1 0\n", get_cell_cost("$_XNOR_"));
+			genlib += stringf("GATE XNOR %d Y=(A*B)+(!A*!B);      PIN * UNKNOWN 1 999 1 0 1 0\n", get_cell_cost("$_XNOR_"));
 		if (enabled_gates.empty() || enabled_gates.count("AOI3"))
-			fprintf(f, "GATE AOI3 %d Y=!((A*B)+C);         PIN * INV     1 999 1 0 1 0\n", get_cell_cost("$_AOI3_"));
+			genlib += stringf("GATE AOI3 %d Y=!((A*B)+C);         PIN * INV     1 999 1 0 1 0\n", get_cell_cost("$_AOI3_"));
 		if (enabled_gates.empty() || enabled_gates.count("OAI3"))
-			fprintf(f, "GATE OAI3 %d Y=!((A+B)*C);         PIN * INV     1 999 1 0 1 0\n", get_cell_cost("$_OAI3_"));
+			genlib += stringf("GATE OAI3 %d Y=!((A+B)*C);         PIN * INV     1 999 1 0 1 0\n", get_cell_cost("$_OAI3_"));
 		if (enabled_gates.empty() || enabled_gates.count("AOI4"))
-			fprintf(f, "GATE AOI4 %d Y=!((A*B)+(C*D));     PIN * INV     1 999 1 0 1 0\n", get_cell_cost("$_AOI4_"));
+			genlib += stringf("GATE AOI4 %d Y=!((A*B)+(C*D));     PIN * INV     1 999 1 0 1 0\n", get_cell_cost("$_AOI4_"));
 		if (enabled_gates.empty() || enabled_gates.count("OAI4"))
-			fprintf(f, "GATE OAI4 %d Y=!((A+B)*(C+D));     PIN * INV     1 999 1 0 1 0\n", get_cell_cost("$_OAI4_"));
+			genlib += stringf("GATE OAI4 %d Y=!((A+B)*(C+D));     PIN * INV     1 999 1 0 1 0\n", get_cell_cost("$_OAI4_"));
 		if (enabled_gates.empty() || enabled_gates.count("MUX"))
-			fprintf(f, "GATE MUX  %d Y=(A*B)+(S*B)+(!S*A); PIN * UNKNOWN 1 999 1 0 1 0\n", get_cell_cost("$_MUX_"));
+			genlib += stringf("GATE MUX  %d Y=(A*B)+(S*B)+(!S*A); PIN * UNKNOWN 1 999 1 0 1 0\n", get_cell_cost("$_MUX_"));
 		if (map_mux4)
-			fprintf(f, "GATE MUX4 %d Y=(!S*!T*A)+(S*!T*B)+(!S*T*C)+(S*T*D); PIN * UNKNOWN 1 999 1 0 1 0\n", 2*get_cell_cost("$_MUX_"));
+			genlib += stringf("GATE MUX4 %d Y=(!S*!T*A)+(S*!T*B)+(!S*T*C)+(S*T*D); PIN * UNKNOWN 1 999 1 0 1 0\n", 2*get_cell_cost("$_MUX_"));
 		if (map_mux8)
-			fprintf(f, "GATE MUX8 %d Y=(!S*!T*!U*A)+(S*!T*!U*B)+(!S*T*!U*C)+(S*T*!U*D)+(!S*!T*U*E)+(S*!T*U*F)+(!S*T*U*G)+(S*T*U*H); PIN * UNKNOWN 1 999 1 0 1 0\n", 4*get_cell_cost("$_MUX_"));
+			genlib += stringf("GATE MUX8 %d Y=(!S*!T*!U*A)+(S*!T*!U*B)+(!S*T*!U*C)+(S*T*!U*D)+(!S*!T*U*E)+(S*!T*U*F)+(!S*T*U*G)+(S*T*U*H); PIN * UNKNOWN 1 999 1 0 1 0\n", 4*get_cell_cost("$_MUX_"));
 		if (map_mux16)
-			fprintf(f, "GATE MUX16 %d Y=(!S*!T*!U*!V*A)+(S*!T*!U*!V*B)+(!S*T*!U*!V*C)+(S*T*!U*!V*D)+(!S*!T*U*!V*E)+(S*!T*U*!V*F)+(!S*T*U*!V*G)+(S*T*U*!V*H)+(!S*!T*!U*V*I)+(S*!T*!U*V*J)+(!S*T*!U*V*K)+(S*T*!U*V*L)+(!S*!T*U*V*M)+(S*!T*U*V*N)+(!S*T*U*V*O)+(S*T*U*V*P); PIN * UNKNOWN 1 999 1 0 1 0\n", 8*get_cell_cost("$_MUX_"));
-		fclose(f);
+			genlib += stringf("GATE MUX16 %d Y=(!S*!T*!U*!V*A)+(S*!T*!U*!V*B)+(!S*T*!U*!V*C)+(S*T*!U*!V*D)+(!S*!T*U*!V*E)+(S*!T*U*!V*F)+(!S*T*U*!V*G)+(S*T*U*!V*H)+(!S*!T*!U*V*I)+(S*!T*!U*V*J)+(!S*T*!U*V*K)+(S*T*!U*V*L)+(!S*!T*U*V*M)+(S*!T*U*V*N)+(!S*T*U*V*O)+(S*T*U*V*P); PIN * UNKNOWN 1 999 1 0 1 0\n", 8*get_cell_cost("$_MUX_"));
 
-		if (!lut_costs.empty()) {
+		if (!linked_abc) {
+			buffer = stringf("%s/stdcells.genlib", tempdir_name.c_str());
+			f = fopen(buffer.c_str(), "wt");
+			if (f == NULL)
+				log_error("Opening %s for writing failed: %s\n", buffer.c_str(), strerror(errno));
+			fprintf(f, "%s", genlib.c_str());
+			fclose(f);
+		}
+
+		if (!linked_abc && !lut_costs.empty()) {
 			buffer = stringf("%s/lutdefs.txt", tempdir_name.c_str());
 			f = fopen(buffer.c_str(), "wt");
 			if (f == NULL)
@@ -902,25 +967,75 @@ void abc_module(RTLIL::Design *design, RTLIL::Module *current_module, std::strin
 			fclose(f);
 		}
 
-		buffer = stringf("%s -s -f %s/abc.script 2>&1", exe_file.c_str(), tempdir_name.c_str());
-		log("Running ABC command: %s\n", replace_tempdir(buffer, tempdir_name, show_tempdir).c_str());
+		builtin_lib = liberty_file.empty();
+		mapped_design = new RTLIL::Design;
 
+		if (linked_abc) {
+			log("Running ABC script using the linked ABC library.\n");
+		} else {
+			abc_command = stringf("%s -s -f %s/abc.script 2>&1", exe_file.c_str(), tempdir_name.c_str());
+			log("Running ABC command: %s\n", replace_tempdir(abc_command, tempdir_name, show_tempdir).c_str());
+		}
+	}
+}
+
+void AbcJob::run()
+{
+	if (count_output == 0)
+		return;
+
+	if (linked_abc)
+	{
+#ifdef YOSYS_LINK_ABC
+		abc_output_filter filt(tempdir_name, show_tempdir);
+		if (!abc_link_run(netlist, builtin_lib && lut_costs.empty() ? genlib : std::string(), builtin_lib ? lut_costs : vector<int>(),
+				abc_script, mapped_design, builtin_lib ? "\\DFF" : "\\_dff_", sop_mode,
+				std::bind(&abc_output_filter::next_line, filt, std::placeholders::_1)))
+			abc_ret = 1;
+#else
+		log_abort();
+#endif
+	}
+	else if (batch_mode)
+	{
+		abc_ret = run_command(abc_command, [this](const std::string &line) { abc_output += line; });
+	}
+	else
+	{
 		abc_output_filter filt(tempdir_name, show_tempdir);
-		int ret = run_command(buffer, std::bind(&abc_output_filter::next_line, filt, std::placeholders::_1));
-		if (ret != 0)
-			log_error("ABC: execution of command \"%s\" failed: return code %d.\n", buffer.c_str(), ret);
+		abc_ret = run_command(abc_command, std::bind(&abc_output_filter::next_line, filt, std::placeholders::_1));
+	}
+}
+
+void AbcJob::finish()
+{
+	if (count_output > 0)
+	{
+		if (!abc_output.empty()) {
+			abc_output_filter filt(tempdir_name, show_tempdir);
+			filt.next_line(abc_output);
+		}
+
+		if (linked_abc)
+		{
+			if (abc_ret != 0)
+				log_error("ABC: execution of script \"%s\" failed.\n", abc_script.c_str());
+		}
+		else
+		{
+			if (abc_ret != 0)
+				log_error("ABC: execution of command \"%s\" failed: return code %d.\n", abc_command.c_str(), abc_ret);
 
-		buffer = stringf("%s/%s", tempdir_name.c_str(), "output.blif");
-		std::ifstream ifs;
-		ifs.open(buffer);
-		if (ifs.fail())
-			log_error("Can't open ABC output file `%s'.\n", buffer.c_str());
+			std::string buffer = stringf("%s/%s", tempdir_name.c_str(), "output.blif");
+			std::ifstream ifs;
+			ifs.open(buffer);
+			if (ifs.fail())
+				log_error("Can't open ABC output file `%s'.\n", buffer.c_str());
 
-		bool builtin_lib = liberty_file.empty();
-		RTLIL::Design *mapped_design = new RTLIL::Design;
-		parse_blif(mapped_design, ifs, builtin_lib ? "\\DFF" : "\\_dff_", false, sop_mode);
+			parse_blif(mapped_design, ifs, builtin_lib ? "\\DFF" : "\\_dff_", false, sop_mode);
 
-		ifs.close();
+			ifs.close();
+		}
 
 		log_header(design, "Re-integrating ABC results.\n");
 		RTLIL::Module *mapped_mod = mapped_design->modules_["\\netlist"];
@@ -1167,7 +1282,7 @@ void abc_module(RTLIL::Design *design, RTLIL::Module *current_module, std::strin
 		log("Don't call ABC as there is nothing to map.\n");
 	}
 
-	if (cleanup)
+	if (cleanup && !linked_abc)
 	{
 		log("Removing temp directory.\n");
 		remove_directory(tempdir_name);
@@ -1326,9 +1441,22 @@ struct AbcPass : public Pass {
 		log("        this attribute is a unique integer for each ABC process started. This\n");
 		log("        is useful for debugging the partitioning of clock domains.\n");
 		log("\n");
+		log("    -j <N>\n");
+		log("        run up to N ABC processes in parallel. With this option the netlists\n");
+		log("        of all selected modules (and with -dff of all clock domains) are\n");
+		log("        extracted first, then ABC is run on them concurrently, and finally the\n");
+		log("        results are re-integrated in a fixed order. The result does not depend\n");
+		log("        on N. This option always uses the external ABC executable.\n");
+		log("\n");
 		log("When neither -liberty nor -lut is used, the Yosys standard cell library is\n");
 		log("loaded into ABC before the ABC script is executed.\n");
 		log("\n");
+#ifdef YOSYS_LINK_ABC
+		log("This Yosys binary is linked with the ABC library. Unless -exe, -nocleanup\n");
+		log("or -j is used, ABC is run in-process and the netlists are passed to and from ABC\n");
+		log("in memory, without creating any temporary files.\n");
+		log("\n");
+#endif
 		log("This pass does not operate on modules with unprocessed processes in it.\n");
 		log("(I.e. the 'proc' pass should be used first to convert processes to netlists.)\n");
 		log("\n");
@@ -1349,6 +1477,7 @@ struct AbcPass : public Pass {
 		std::string delay_target, sop_inputs, sop_products, lutin_shared = "-S 1";
 		bool fast_mode = false, dff_mode = false, keepff = false, cleanup = true;
 		bool show_tempdir = false, sop_mode = false;
+		int num_threads = 0;
 		vector<int> lut_costs;
 		markgroups = false;
 
@@ -1370,10 +1499,12 @@ struct AbcPass : public Pass {
 			log_cmd_error("getcwd failed: %s\n", strerror(errno));
 			log_abort();
 		}
+		bool exe_given = false;
 		for (argidx = 1; argidx < args.size(); argidx++) {
 			std::string arg = args[argidx];
 			if (arg == "-exe" && argidx+1 < args.size()) {
 				exe_file = args[++argidx];
+				exe_given = true;
 				continue;
 			}
 			if (arg == "-script" && argidx+1 < args.size()) {
@@ -1508,6 +1639,10 @@ struct AbcPass : public Pass {
 				markgroups = true;
 				continue;
 			}
+			if (arg == "-j" && argidx+1 < args.size()) {
+				num_threads = std::max(atoi(args[++argidx].c_str()), 1);
+				continue;
+			}
 			break;
 		}
 		extra_args(args, argidx, design);
@@ -1517,30 +1652,56 @@ struct AbcPass : public Pass {
 		if (!constr_file.empty() && liberty_file.empty())
 			log_cmd_error("Got -constr but no -liberty!\n");
 
+#ifdef YOSYS_LINK_ABC
+		if (!exe_given && cleanup && num_threads == 0)
+			exe_file.clear();
+#else
+		(void)exe_given;
+#endif
+
+		// with -j all jobs are prepared first and finished in the same order
+		// after running ABC on them in parallel
+		std::vector<AbcJob*> jobs;
+		auto process_job = [&](AbcJob *job, bool job_dff_mode, std::string job_clk_str, const std::vector<RTLIL::Cell*> &cells) {
+			job->prepare(script_file, exe_file, liberty_file, constr_file, cleanup, lut_costs, job_dff_mode, job_clk_str, keepff,
+					delay_target, sop_inputs, sop_products, lutin_shared, fast_mode, cells, show_tempdir, sop_mode);
+			if (num_threads > 0) {
+				jobs.push_back(job);
+				log_pop();
+			} else {
+				job->run();
+				job->finish();
+				delete job;
+			}
+		};
+
 		for (auto mod : design->selected_modules())
 			if (mod->processes.size() > 0)
 				log("Skipping module %s as it contains processes.\n", log_id(mod));
 			else if (!dff_mode || !clk_str.empty())
-				abc_module(design, mod, script_file, exe_file, liberty_file, constr_file, cleanup, lut_costs, dff_mode, clk_str, keepff,
-						delay_target, sop_inputs, sop_products, lutin_shared, fast_mode, mod->selected_cells(), show_tempdir, sop_mode);
+				process_job(new AbcJob(design, mod, num_threads > 0), dff_mode, clk_str, mod->selected_cells());
 			else
 			{
-				assign_map.set(mod);
+				SigMap assign_map(mod);
 				CellTypes ct(design);
 
+				// order cells by name (not by pointer) so that the partitioning
+				// into clock domains is the same in every run
+				typedef std::set<RTLIL::Cell*, RTLIL::sort_by_name_id<RTLIL::Cell>> cell_set_t;
+
 				std::vector<RTLIL::Cell*> all_cells = mod->selected_cells();
-				std::set<RTLIL::Cell*> unassigned_cells(all_cells.begin(), all_cells.end());
+				cell_set_t unassigned_cells(all_cells.begin(), all_cells.end());
 
-				std::set<RTLIL::Cell*> expand_queue, next_expand_queue;
-				std::set<RTLIL::Cell*> expand_queue_up, next_expand_queue_up;
-				std::set<RTLIL::Cell*> expand_queue_down, next_expand_queue_down;
+				cell_set_t expand_queue, next_expand_queue;
+				cell_set_t expand_queue_up, next_expand_queue_up;
+				cell_set_t expand_queue_down, next_expand_queue_down;
 
 				typedef tuple<bool, RTLIL::SigSpec, bool, RTLIL::SigSpec> clkdomain_t;
 				std::map<clkdomain_t, std::vector<RTLIL::Cell*>> assigned_cells;
 				std::map<RTLIL::Cell*, clkdomain_t> assigned_cells_reverse;
 
 				std::map<RTLIL::Cell*, std::set<RTLIL::SigBit>> cell_to_bit, cell_to_bit_up, cell_to_bit_down;
-				std::map<RTLIL::SigBit, std::set<RTLIL::Cell*>> bit_to_cell, bit_to_cell_up, bit_to_cell_down;
+				std::map<RTLIL::SigBit, cell_set_t> bit_to_cell, bit_to_cell_up, bit_to_cell_down;
 
 				for (auto cell : all_cells)
 				{
@@ -1662,19 +1823,30 @@ struct AbcPass : public Pass {
 							std::get<2>(it.first) ? "" : "!", log_signal(std::get<3>(it.first)));
 
 				for (auto &it : assigned_cells) {
-					clk_polarity = std::get<0>(it.first);
-					clk_sig = assign_map(std::get<1>(it.first));
-					en_polarity = std::get<2>(it.first);
-					en_sig = assign_map(std::get<3>(it.first));
-					abc_module(design, mod, script_file, exe_file, liberty_file, constr_file, cleanup, lut_costs, !clk_sig.empty(), "$",
-							keepff, delay_target, sop_inputs, sop_products, lutin_shared, fast_mode, it.second, show_tempdir, sop_mode);
-					assign_map.set(mod);
+					AbcJob *job = new AbcJob(design, mod, num_threads > 0);
+					job->clk_polarity = std::get<0>(it.first);
+					job->clk_sig = std::get<1>(it.first);
+					job->en_polarity = std::get<2>(it.first);
+					job->en_sig = std::get<3>(it.first);
+					process_job(job, !job->clk_sig.empty(), "$", it.second);
 				}
 			}
 
-		assign_map.clear();
-		signal_list.clear();
-		signal_map.clear();
+		if (!jobs.empty())
+		{
+			for (auto job : jobs)
+				job->remove_extracted_cells();
+
+			log_header(design, "Running %d ABC jobs using up to %d threads.\n", GetSize(jobs), num_threads);
+			parallel_for(GetSize(jobs), num_threads, [&](int i) { jobs[i]->run(); });
+
+			for (int i = 0; i < GetSize(jobs); i++) {
+				log_header(design, "Results of ABC job %d for module `%s'.\n", i+1, jobs[i]->module->name.c_str());
+				log_push();
+				jobs[i]->finish();
+				delete jobs[i];
+			}
+		}
 
 		log_pop();
 	}
@@ -0,0 +1,353 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Clifford Wolf <clifford@clifford.at>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+// This file is only compiled with LINK_ABC=1. It is the only place where the
+// ABC headers are included. It mirrors what the "read_blif" and "write_blif"
+// commands of ABC and parse_blif() do, without going through files.
+
+#include "kernel/yosys.h"
+#include "passes/techmap/abc_link.h"
+
+#include <unistd.h>
+
+// the ABC headers need the platform defines that abc/arch_flags.c creates
+#if !defined(LIN) && !defined(LIN64)
+#  if defined(__LP64__) || defined(_LP64)
+#    define LIN64
+#  else
+#    define LIN
+#  endif
+#endif
+
+#include "base/abc/abc.h"
+#include "base/main/main.h"
+#include "base/cmd/cmd.h"
+#include "base/io/ioAbc.h"
+#include "map/mio/mio.h"
+#include "map/if/if.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+using namespace abc;
+
+static Abc_Ntk_t *abc_link_create_network(const AbcNetlist &netlist)
+{
+	Abc_Ntk_t *ntk = Abc_NtkAlloc(ABC_NTK_NETLIST, ABC_FUNC_SOP, 1);
+	ntk->pName = Extra_UtilStrsav((char*)"netlist");
+	ntk->pSpec = Extra_UtilStrsav((char*)"netlist");
+
+	auto name = [](int id) { return stringf("n%d", id); };
+
+	for (int id : netlist.inputs)
+		Io_ReadCreatePi(ntk, (char*)name(id).c_str());
+	if (netlist.inputs.empty())
+		Io_ReadCreatePi(ntk, (char*)"dummy_input");
+
+	for (int id : netlist.outputs)
+		Io_ReadCreatePo(ntk, (char*)name(id).c_str());
+
+	// like the BLIF reader, create all latches before the logic nodes
+	for (auto &node : netlist.nodes)
+	{
+		if (node.cover != nullptr)
+			continue;
+		log_assert(GetSize(node.inputs) == 1);
+		Abc_Obj_t *latch = Io_ReadCreateLatch(ntk, (char*)name(node.inputs[0]).c_str(), (char*)name(node.output).c_str());
+		Abc_LatchSetInitDc(latch);
+	}
+
+	for (auto &node : netlist.nodes)
+	{
+		if (node.cover == nullptr)
+			continue;
+
+		std::vector<std::string> input_names;
+		std::vector<char*> input_ptrs;
+		for (int id : node.inputs)
+			input_names.push_back(name(id));
+		for (auto &n : input_names)
+			input_ptrs.push_back((char*)n.c_str());
+
+		Abc_Obj_t *obj = Io_ReadCreateNode(ntk, (char*)name(node.output).c_str(), input_ptrs.data(), GetSize(input_ptrs));
+		Mem_Flex_t *man = (Mem_Flex_t*)ntk->pManFunc;
+
+		if (node.inputs.empty())
+			obj->pData = node.cover[0] == '1' ? Abc_SopCreateConst1(man) : Abc_SopCreateConst0(man);
+		else
+			obj->pData = Abc_SopRegister(man, (char*)node.cover);
+	}
+
+	Abc_NtkFinalizeRead(ntk);
+
+	if (!Abc_NtkCheckRead(ntk)) {
+		Abc_NtkDelete(ntk);
+		return nullptr;
+	}
+
+	Abc_Ntk_t *logic_ntk = Abc_NtkToLogic(ntk);
+	Abc_NtkDelete(ntk);
+	return logic_ntk;
+}
+
+static bool abc_link_load_library(const std::string &genlib, const std::vector<int> &lut_costs)
+{
+	if (!genlib.empty())
+	{
+		// the genlib parsers expect the terminator that ABC adds when loading a file
+		std::string buffer = genlib + "\n.end\n";
+		Vec_Str_t *str = Vec_StrAllocArrayCopy((char*)buffer.c_str(), GetSize(buffer) + 1);
+		Vec_Str_t *str2 = Vec_StrDup(str);
+		int ret = Mio_UpdateGenlib2(str, str2, (char*)"stdcells.genlib", 0);
+		Vec_StrFree(str);
+		Vec_StrFree(str2);
+		if (!ret)
+			return false;
+	}
+
+	if (!lut_costs.empty())
+	{
+		if (GetSize(lut_costs) >= IF_MAX_LUTSIZE)
+			return false;
+
+		If_LibLut_t *lib = ABC_CALLOC(If_LibLut_t, 1);
+		lib->pName = Abc_UtilStrsav((char*)"lutdefs.txt");
+		lib->LutMax = GetSize(lut_costs);
+		for (int i = 0; i < GetSize(lut_costs); i++) {
+			lib->pLutAreas[i+1] = lut_costs[i];
+			lib->pLutDelays[i+1][0] = 1.0;
+		}
+
+		If_LibLutFree((If_LibLut_t*)Abc_FrameReadLibLut());
+		Abc_FrameSetLibLut(lib);
+	}
+
+	return true;
+}
+
+static bool abc_link_import_network(Abc_Ntk_t *ntk, RTLIL::Design *design, std::string dff_name, bool sop_mode)
+{
+	Abc_Ntk_t *netlist = Abc_NtkToNetlist(ntk);
+	if (netlist == nullptr) {
+		printf("Converting the mapped network to a netlist has failed.\n");
+		return false;
+	}
+
+	if (!Abc_NtkHasSop(netlist) && !Abc_NtkHasMapping(netlist))
+		Abc_NtkToSop(netlist, -1, ABC_INFINITY);
+
+	RTLIL::Module *module = new RTLIL::Module;
+	module->name = "\\netlist";
+	design->add(module);
+
+	auto net_wire = [&](Abc_Obj_t *net) -> RTLIL::Wire* {
+		RTLIL::IdString id = RTLIL::escape_id(Abc_ObjName(net));
+		RTLIL::Wire *wire = module->wire(id);
+		if (wire == nullptr)
+			wire = module->addWire(id);
+		return wire;
+	};
+
+	Abc_Obj_t *obj;
+	int i;
+
+	Abc_NtkForEachPi(netlist, obj, i)
+		net_wire(Abc_ObjFanout0(obj))->port_input = true;
+
+	Abc_NtkForEachPo(netlist, obj, i)
+		net_wire(Abc_ObjFanin0(obj))->port_output = true;
+
+	Abc_NtkForEachLatch(netlist, obj, i)
+	{
+		RTLIL::Wire *d = net_wire(Abc_ObjFanin0(Abc_ObjFanin0(obj)));
+		RTLIL::Wire *q = net_wire(Abc_ObjFanout0(Abc_ObjFanout0(obj)));
+
+		if (Abc_LatchIsInit0(obj) || Abc_LatchIsInit1(obj))
+			q->attributes["\\init"] = RTLIL::Const(Abc_LatchIsInit1(obj) ? 1 : 0, 1);
+
+		RTLIL::Cell *cell = module->addCell(NEW_ID, dff_name);
+		cell->setPort("\\D", d);
+		cell->setPort("\\Q", q);
+	}
+
+	bool mapped = Abc_NtkHasMapping(netlist);
+
+	Abc_NtkForEachNode(netlist, obj, i)
+	{
+		RTLIL::Wire *output = net_wire(Abc_ObjFanout0(obj));
+
+		if (mapped && Abc_ObjIsBarBuf(obj)) {
+			module->connect(output, net_wire(Abc_ObjFanin0(obj)));
+			continue;
+		}
+
+		if (mapped)
+		{
+			Mio_Gate_t *gate = (Mio_Gate_t*)obj->pData;
+			RTLIL::Cell *cell = module->addCell(NEW_ID, RTLIL::escape_id(Mio_GateReadName(gate)));
+
+			int k = 0;
+			for (Mio_Pin_t *pin = Mio_GateReadPins(gate); pin; pin = Mio_PinReadNext(pin), k++)
+				cell->setPort(RTLIL::escape_id(Mio_PinReadName(pin)), net_wire(Abc_ObjFanin(obj, k)));
+			cell->setPort(RTLIL::escape_id(Mio_GateReadOutName(gate)), output);
+
+			// gates with two outputs are represented by two consecutive nodes
+			if (Mio_GateReadTwin(gate) != nullptr) {
+				Abc_Obj_t *twin = Abc_NtkFetchTwinNode(obj);
+				if (twin != nullptr) {
+					cell->setPort(RTLIL::escape_id(Mio_GateReadOutName((Mio_Gate_t*)twin->pData)), net_wire(Abc_ObjFanout0(twin)));
+					i++;
+				}
+			}
+			continue;
+		}
+
+		char *sop = (char*)obj->pData;
+		int width = Abc_ObjFaninNum(obj);
+
+		if (width == 0) {
+			module->connect(output, Abc_SopIsConst1(sop) ? RTLIL::State::S1 : RTLIL::State::S0);
+			continue;
+		}
+
+		RTLIL::SigSpec inputs;
+		for (int k = 0; k < width; k++)
+			inputs.append(net_wire(Abc_ObjFanin(obj, k)));
+
+		bool polarity = !Abc_SopIsComplement(sop);
+		char *cube;
+
+		if (sop_mode)
+		{
+			RTLIL::Const table;
+			int depth = 0;
+
+			Abc_SopForEachCube(sop, width, cube) {
+				for (int k = 0; k < width; k++) {
+					table.bits.push_back(cube[k] == '0' ? RTLIL::State::S1 : RTLIL::State::S0);
+					table.bits.push_back(cube[k] == '1' ? RTLIL::State::S1 : RTLIL::State::S0);
+				}
+				depth++;
+			}
+
+			RTLIL::Cell *cell = module->addCell(NEW_ID, "$sop");
+			cell->parameters["\\WIDTH"] = RTLIL::Const(width);
+			cell->parameters["\\DEPTH"] = RTLIL::Const(depth);
+			cell->parameters["\\TABLE"] = table;
+			cell->setPort("\\A", inputs);
+
+			if (polarity) {
+				cell->setPort("\\Y", output);
+			} else {
+				RTLIL::Wire *tempnet = module->addWire(NEW_ID);
+				module->addNotGate(NEW_ID, tempnet, output);
+				cell->setPort("\\Y", tempnet);
+			}
+		}
+		else
+		{
+			if (width > 8) {
+				printf("Node %s has %d inputs, which is too many for a $lut cell.\n", Abc_ObjName(Abc_ObjFanout0(obj)), width);
+				Abc_NtkDelete(netlist);
+				return false;
+			}
+
+			RTLIL::Const lut(polarity ? RTLIL::State::S0 : RTLIL::State::S1, 1 << width);
+
+			Abc_SopForEachCube(sop, width, cube)
+				for (int idx = 0; idx < (1 << width); idx++) {
+					bool match = true;
+					for (int k = 0; k < width && match; k++)
+						if (cube[k] != '-' && (cube[k] == '1') != ((idx & (1 << k)) != 0))
+							match = false;
+					if (match)
+						lut.bits[idx] = polarity ? RTLIL::State::S1 : RTLIL::State::S0;
+				}
+
+			RTLIL::Cell *cell = module->addCell(NEW_ID, "$lut");
+			cell->parameters["\\WIDTH"] = RTLIL::Const(width);
+			cell->parameters["\\LUT"] = lut;
+			cell->setPort("\\A", inputs);
+			cell->setPort("\\Y", output);
+		}
+	}
+
+	module->fixup_ports();
+	Abc_NtkDelete(netlist);
+	return true;
+}
+
+bool abc_link_run(const AbcNetlist &netlist, const std::string &genlib, const std::vector<int> &lut_costs,
+		const std::string &script, RTLIL::Design *mapped_design, std::string dff_name, bool sop_mode,
+		std::function<void(const std::string&)> process_line)
+{
+	static bool abc_started = false;
+	if (!abc_started) {
+		Abc_Start();
+		abc_started = true;
+	}
+
+	Abc_Frame_t *abc = Abc_FrameGetGlobalFrame();
+
+	// ABC writes its messages to stdout and stderr. Collect them in an
+	// (unnamed) temporary file, so that they can go through the log.
+	FILE *out = tmpfile();
+	if (out == nullptr)
+		log_error("ABC: Can't create temporary file for the ABC output: %s\n", strerror(errno));
+
+	fflush(stdout);
+	fflush(stderr);
+	int saved_stdout = dup(STDOUT_FILENO);
+	int saved_stderr = dup(STDERR_FILENO);
+	dup2(fileno(out), STDOUT_FILENO);
+	dup2(fileno(out), STDERR_FILENO);
+
+	bool ok = false;
+	Abc_Ntk_t *ntk = abc_link_create_network(netlist);
+
+	if (ntk == nullptr)
+		printf("Creating the ABC network has failed.\n");
+	else if (!abc_link_load_library(genlib, lut_costs))
+		printf("Loading the library has failed.\n"), Abc_NtkDelete(ntk);
+	else {
+		Abc_FrameReplaceCurrentNetwork(abc, ntk);
+		Abc_FrameClearVerifStatus(abc);
+		ok = Cmd_CommandExecute(abc, script.c_str()) == 0 && Abc_FrameReadNtk(abc) != nullptr;
+	}
+
+	if (ok)
+		ok = abc_link_import_network(Abc_FrameReadNtk(abc), mapped_design, dff_name, sop_mode);
+	Abc_FrameDeleteAllNetworks(abc);
+
+	fflush(stdout);
+	fflush(stderr);
+	dup2(saved_stdout, STDOUT_FILENO);
+	dup2(saved_stderr, STDERR_FILENO);
+	close(saved_stdout);
+	close(saved_stderr);
+
+	char logbuf[128];
+	rewind(out);
+	while (fgets(logbuf, 128, out) != nullptr)
+		process_line(logbuf);
+	fclose(out);
+
+	return ok;
+}
+
+YOSYS_NAMESPACE_END
@@ -0,0 +1,56 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Clifford Wolf <clifford@clifford.at>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef ABC_LINK_H
+#define ABC_LINK_H
+
+#include "kernel/yosys.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+// The in-memory equivalent of the input.blif file the abc pass writes for
+// the external yosys-abc. Signals are named "n<index>" in ABC.
+struct AbcNetlist
+{
+	struct node_t {
+		std::vector<int> inputs;
+		int output;
+		// the BLIF cover (e.g. "11 1\n"), or nullptr for a latch
+		const char *cover;
+	};
+
+	std::vector<int> inputs, outputs;
+	std::vector<node_t> nodes;
+};
+
+// Run the ABC script on the netlist using the ABC library that is linked into
+// Yosys (LINK_ABC=1). The script must not read or write any networks. Either
+// the genlib text or the LUT costs is loaded as library (unless both are
+// empty, e.g. when the script reads a liberty file itself).
+//
+// The result is added to mapped_design as module "netlist", just like
+// parse_blif() would create it from the output of "write_blif". The output of
+// ABC is passed to process_line. Returns false if an ABC command failed.
+bool abc_link_run(const AbcNetlist &netlist, const std::string &genlib, const std::vector<int> &lut_costs,
+		const std::string &script, RTLIL::Design *mapped_design, std::string dff_name, bool sop_mode,
+		std::function<void(const std::string&)> process_line);
+
+YOSYS_NAMESPACE_END
+
+#endif
@@ -21,6 +21,7 @@
 #include "kernel/utils.h"
 #include "kernel/sigtools.h"
 #include "libs/sha1/sha1.h"
+#include "frontends/verilog/verilog_frontend.h"
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -60,6 +61,37 @@ void apply_prefix(std::string prefix, RTLIL::SigSpec &sig, RTLIL::Module *module
 	sig = chunks;
 }
 
+// removes all objects from the dict and returns them in the order in which they were added
+template<typename T>
+std::vector<T*> take_objects(dict<RTLIL::IdString, T*> &objects)
+{
+	std::vector<T*> result;
+	for (auto &it : objects)
+		result.push_back(it.second);
+	std::reverse(result.begin(), result.end());
+	objects.clear();
+	return result;
+}
+
+// parsed map libraries, shared by all techmap calls. the key is made of the frontend
+// options and the names and contents of the map files. techmap modifies the map design
+// (derived modules, _TECHMAP_DO_* commands), so every call works on a copy.
+dict<std::string, RTLIL::Design*> map_library_cache;
+
+// Module::clone() reverses the order of the wires and cells. the cached libraries are
+// stored as copies, so that the copies made from them are back in the original order.
+RTLIL::Design *copy_map_library(RTLIL::Design *lib)
+{
+	std::vector<RTLIL::Module*> modules;
+	for (auto mod : lib->modules())
+		modules.push_back(mod);
+
+	RTLIL::Design *map = new RTLIL::Design;
+	for (auto it = modules.rbegin(); it != modules.rend(); it++)
+		map->add((*it)->clone());
+	return map;
+}
+
 struct TechmapWorker
 {
 	std::map<RTLIL::IdString, void(*)(RTLIL::Module*, RTLIL::Cell*)> simplemap_mappers;
@@ -79,11 +111,30 @@ struct TechmapWorker
 
 	typedef std::map<std::string, std::vector<TechmapWireData>> TechmapWires;
 
+	// std containers, so that concurrent lookups in techmap_module_expand() are safe
+	struct TechmapTemplate {
+		std::map<RTLIL::IdString, RTLIL::IdString> positional_ports;
+		std::map<RTLIL::IdString, RTLIL::Wire*> port_wires;
+		std::set<RTLIL::SigBit> written_port_bits;
+		std::set<RTLIL::IdString> special_wires;
+		bool replace_cell = false;
+	};
+
+	struct TechmapJob {
+		RTLIL::Cell *cell;
+		RTLIL::Module *tpl;
+		std::string orig_cell_name;
+	};
+
+	std::map<RTLIL::Module*, TechmapTemplate> template_cache;
+	std::vector<TechmapJob> pending_jobs;
+
 	bool extern_mode;
 	bool assert_mode;
 	bool flatten_mode;
 	bool recursive_mode;
 	bool autoproc_mode;
+	int num_threads;
 
 	TechmapWorker()
 	{
@@ -92,6 +143,7 @@ struct TechmapWorker
 		flatten_mode = false;
 		recursive_mode = false;
 		autoproc_mode = false;
+		num_threads = 0;
 	}
 
 	std::string constmap_tpl_name(SigMap &sigmap, RTLIL::Module *tpl, RTLIL::Cell *cell, bool verbose)
@@ -156,7 +208,50 @@ struct TechmapWorker
 		return result;
 	}
 
-	void techmap_module_worker(RTLIL::Design *design, RTLIL::Module *module, RTLIL::Cell *cell, RTLIL::Module *tpl)
+	// the per-template data used by techmap_module_expand(). it is computed once, when a
+	// template is first used, and is only read afterwards (also by the threads of -j).
+	TechmapTemplate &techmap_template(RTLIL::Module *tpl)
+	{
+		if (template_cache.count(tpl))
+			return template_cache.at(tpl);
+
+		TechmapTemplate &data = template_cache[tpl];
+
+		for (auto &it : tpl->wires_) {
+			if (it.second->port_id > 0) {
+				data.positional_ports[stringf("$%d", it.second->port_id)] = it.first;
+				data.port_wires[it.first] = it.second;
+			}
+			if (it.second->get_bool_attribute("\\_techmap_special_"))
+				data.special_wires.insert(it.first);
+		}
+
+		for (auto &it : tpl->cells_)
+			if (it.first == "\\_TECHMAP_REPLACE_")
+				data.replace_cell = true;
+
+		SigMap tpl_sigmap(tpl);
+		pool<SigBit> tpl_written_bits;
+
+		for (auto &it1 : tpl->cells_)
+		for (auto &it2 : it1.second->connections_)
+			if (it1.second->output(it2.first))
+				for (auto bit : tpl_sigmap(it2.second))
+					tpl_written_bits.insert(bit);
+		for (auto &it1 : tpl->connections_)
+			for (auto bit : tpl_sigmap(it1.first))
+				tpl_written_bits.insert(bit);
+
+		for (auto &it : data.port_wires)
+			for (auto bit : SigSpec(it.second))
+				if (tpl_written_bits.count(tpl_sigmap(bit)))
+					data.written_port_bits.insert(bit);
+
+		return data;
+	}
+
+	// everything that must run before the expansion of a cell and that can't run in parallel
+	std::string techmap_module_prepare(RTLIL::Module *module, RTLIL::Cell *cell, RTLIL::Module *tpl)
 	{
 		if (tpl->processes.size() != 0) {
 			log("Technology map yielded processes:");
@@ -170,20 +265,29 @@ struct TechmapWorker
 				log_error("Technology map yielded processes -> this is not supported (use -autoproc to run 'proc' automatically).\n");
 		}
 
+		// in flatten mode the templates are design modules that may still change
+		if (flatten_mode)
+			template_cache.erase(tpl);
+
 		std::string orig_cell_name;
+
+		if (techmap_template(tpl).replace_cell && !flatten_mode) {
+			orig_cell_name = cell->name.str();
+			module->rename(cell, stringf("$techmap%d", autoidx++) + cell->name.str());
+		}
+
+		return orig_cell_name;
+	}
+
+	// creates the wires, cells, memories and connections for the expansion of the cell in the
+	// staging module. except for the sigmaps of flatten mode only the staging module is modified.
+	void techmap_module_expand(RTLIL::Module *module, RTLIL::Cell *cell, RTLIL::Module *tpl, const std::string &orig_cell_name, RTLIL::Module *staging)
+	{
+		const TechmapTemplate &data = template_cache.at(tpl);
 		pool<string> extra_src_attrs;
 
 		if (!flatten_mode)
-		{
-			for (auto &it : tpl->cells_)
-				if (it.first == "\\_TECHMAP_REPLACE_") {
-					orig_cell_name = cell->name.str();
-					module->rename(cell, stringf("$techmap%d", autoidx++) + cell->name.str());
-					break;
-				}
-
 			extra_src_attrs = cell->get_strpool_attribute("\\src");
-		}
 
 		dict<IdString, IdString> memory_renames;
 
@@ -198,75 +302,57 @@ struct TechmapWorker
 			m->attributes = it.second->attributes;
 			if (m->attributes.count("\\src"))
 				m->add_strpool_attribute("\\src", extra_src_attrs);
-			module->memories[m->name] = m;
+			staging->memories[m->name] = m;
 			memory_renames[it.first] = m->name;
-			design->select(module, m);
 		}
 
-		std::map<RTLIL::IdString, RTLIL::IdString> positional_ports;
-
 		for (auto &it : tpl->wires_) {
-			if (it.second->port_id > 0)
-				positional_ports[stringf("$%d", it.second->port_id)] = it.first;
 			std::string w_name = it.second->name.str();
 			apply_prefix(cell->name.str(), w_name);
-			RTLIL::Wire *w = module->addWire(w_name, it.second);
+			RTLIL::Wire *w = staging->addWire(w_name, it.second);
 			w->port_input = false;
 			w->port_output = false;
 			w->port_id = 0;
-			if (it.second->get_bool_attribute("\\_techmap_special_"))
+			if (data.special_wires.count(it.first))
 				w->attributes.clear();
 			if (w->attributes.count("\\src"))
 				w->add_strpool_attribute("\\src", extra_src_attrs);
-			design->select(module, w);
 		}
 
-		SigMap tpl_sigmap(tpl);
-		pool<SigBit> tpl_written_bits;
-
-		for (auto &it1 : tpl->cells_)
-		for (auto &it2 : it1.second->connections_)
-			if (it1.second->output(it2.first))
-				for (auto bit : tpl_sigmap(it2.second))
-					tpl_written_bits.insert(bit);
-		for (auto &it1 : tpl->connections_)
-			for (auto bit : tpl_sigmap(it1.first))
-				tpl_written_bits.insert(bit);
-
 		SigMap port_signal_map;
 		SigSig port_signal_assign;
 
 		for (auto &it : cell->connections())
 		{
 			RTLIL::IdString portname = it.first;
-			if (positional_ports.count(portname) > 0)
-				portname = positional_ports.at(portname);
-			if (tpl->wires_.count(portname) == 0 || tpl->wires_.at(portname)->port_id == 0) {
+			if (data.positional_ports.count(portname) > 0)
+				portname = data.positional_ports.at(portname);
+			if (data.port_wires.count(portname) == 0) {
 				if (portname.substr(0, 1) == "$")
 					log_error("Can't map port `%s' of cell `%s' to template `%s'!\n", portname.c_str(), cell->name.c_str(), tpl->name.c_str());
 				continue;
 			}
 
-			RTLIL::Wire *w = tpl->wires_.at(portname);
+			RTLIL::Wire *w = data.port_wires.at(portname);
 			RTLIL::SigSig c, extra_connect;
 
 			if (w->port_output && !w->port_input) {
 				c.first = it.second;
 				c.second = RTLIL::SigSpec(w);
-				apply_prefix(cell->name.str(), c.second, module);
+				apply_prefix(cell->name.str(), c.second, staging);
 				extra_connect.first = c.second;
 				extra_connect.second = c.first;
 			} else if (!w->port_output && w->port_input) {
 				c.first = RTLIL::SigSpec(w);
 				c.second = it.second;
-				apply_prefix(cell->name.str(), c.first, module);
+				apply_prefix(cell->name.str(), c.first, staging);
 				extra_connect.first = c.first;
 				extra_connect.second = c.second;
 			} else {
 				SigSpec sig_tpl = w, sig_tpl_pf = w, sig_mod = it.second;
-				apply_prefix(cell->name.str(), sig_tpl_pf, module);
+				apply_prefix(cell->name.str(), sig_tpl_pf, staging);
 				for (int i = 0; i < GetSize(sig_tpl) && i < GetSize(sig_mod); i++) {
-					if (tpl_written_bits.count(tpl_sigmap(sig_tpl[i]))) {
+					if (data.written_port_bits.count(sig_tpl[i])) {
 						c.first.append(sig_mod[i]);
 						c.second.append(sig_tpl_pf[i]);
 					} else {
@@ -298,7 +384,7 @@ struct TechmapWorker
 					log_error("Mismatch in directionality for cell port %s.%s.%s: %s <= %s\n",
 						log_id(module), log_id(cell), log_id(it.first), log_signal(c.first), log_signal(c.second));
 
-				module->connect(c);
+				staging->connect(c);
 			}
 			else
 			{
@@ -311,14 +397,14 @@ struct TechmapWorker
 				if (!w->port_output && w->port_input) {
 					port_signal_map.add(c.first, c.second);
 				} else {
-					module->connect(c);
+					staging->connect(c);
 					extra_connect = SigSig();
 				}
 
 				for (auto &attr : w->attributes) {
 					if (attr.first == "\\src")
 						continue;
-					module->connect(extra_connect);
+					staging->connect(extra_connect);
 					break;
 				}
 			}
@@ -334,14 +420,13 @@ struct TechmapWorker
 			else
 				apply_prefix(cell->name.str(), c_name);
 
-			RTLIL::Cell *c = module->addCell(c_name, it.second);
-			design->select(module, c);
+			RTLIL::Cell *c = staging->addCell(c_name, it.second);
 
 			if (!flatten_mode && c->type.substr(0, 2) == "\\$")
 				c->type = c->type.substr(1);
 
 			for (auto &it2 : c->connections_) {
-				apply_prefix(cell->name.str(), it2.second, module);
+				apply_prefix(cell->name.str(), it2.second, staging);
 				port_signal_map.apply(it2.second);
 			}
 
@@ -368,16 +453,119 @@ struct TechmapWorker
 
 		for (auto &it : tpl->connections()) {
 			RTLIL::SigSig c = it;
-			apply_prefix(cell->name.str(), c.first, module);
-			apply_prefix(cell->name.str(), c.second, module);
+			apply_prefix(cell->name.str(), c.first, staging);
+			apply_prefix(cell->name.str(), c.second, staging);
 			port_signal_map.apply(c.first);
 			port_signal_map.apply(c.second);
-			module->connect(c);
+			staging->connect(c);
 		}
+	}
 
+	// moves the objects from the staging module to the module and removes the mapped cell
+	void techmap_module_commit(RTLIL::Design *design, RTLIL::Module *module, RTLIL::Cell *cell, RTLIL::Module *staging)
+	{
+		for (auto m : take_objects(staging->memories)) {
+			log_assert(module->count_id(m->name) == 0);
+			module->memories[m->name] = m;
+			design->select(module, m);
+		}
+
+		for (auto w : take_objects(staging->wires_)) {
+			log_assert(module->count_id(w->name) == 0);
+			module->wires_[w->name] = w;
+			w->module = module;
+			design->select(module, w);
+		}
+
+		for (auto c : take_objects(staging->cells_)) {
+			log_assert(module->count_id(c->name) == 0);
+			module->cells_[c->name] = c;
+			c->module = module;
+			design->select(module, c);
+		}
+
+		for (auto &conn : staging->connections_)
+			module->connect(conn);
+
+		delete staging;
 		module->remove(cell);
 	}
 
+	void techmap_module_worker(RTLIL::Design *design, RTLIL::Module *module, RTLIL::Cell *cell, RTLIL::Module *tpl)
+	{
+		std::string orig_cell_name = techmap_module_prepare(module, cell, tpl);
+		RTLIL::Module *staging = new RTLIL::Module;
+		techmap_module_expand(module, cell, tpl, orig_cell_name, staging);
+		techmap_module_commit(design, module, cell, staging);
+	}
+
+	// expands the cells collected by techmap_module() with -j in parallel, and then
+	// commits the results in the order in which the cells were collected
+	void techmap_module_flush(RTLIL::Design *design, RTLIL::Module *module)
+	{
+		int num_jobs = GetSize(pending_jobs);
+		if (num_jobs == 0)
+			return;
+
+		std::vector<RTLIL::Module*> staging(num_jobs);
+		for (auto &it : staging)
+			it = new RTLIL::Module;
+
+		std::vector<std::string> job_logs(num_jobs);
+		std::vector<log_thread_error_exception> job_errors(num_jobs);
+		std::vector<char> job_failed(num_jobs);
+
+		auto job = [&](int k) {
+			auto &pending = pending_jobs[k];
+			log_thread_buffer = &job_logs[k];
+			RTLIL::IdString::set_thread_job(k);
+			try {
+				techmap_module_expand(module, pending.cell, pending.tpl, pending.orig_cell_name, staging[k]);
+			} catch (log_thread_error_exception &e) {
+				job_errors[k] = e;
+				job_failed[k] = true;
+			} catch (...) {
+				log_id_cache_clear();
+				RTLIL::IdString::set_thread_job(-1);
+				log_thread_buffer = nullptr;
+				throw;
+			}
+			log_id_cache_clear();
+			RTLIL::IdString::set_thread_job(-1);
+			log_thread_buffer = nullptr;
+		};
+
+		log_id_cache_clear();
+		RTLIL::IdString::begin_threaded(num_jobs);
+
+		try {
+			parallel_for(num_jobs, std::min(num_threads, num_jobs), job);
+		} catch (...) {
+			RTLIL::IdString::end_threaded();
+			for (auto it : staging)
+				delete it;
+			pending_jobs.clear();
+			throw;
+		}
+
+		RTLIL::IdString::end_threaded();
+
+		for (int k = 0; k < num_jobs; k++) {
+			log("%s", job_logs[k].c_str());
+			if (job_failed[k]) {
+				for (int i = k; i < num_jobs; i++)
+					delete staging[i];
+				pending_jobs.clear();
+				if (job_errors[k].cmd_error)
+					log_cmd_error("%s", job_errors[k].message.c_str());
+				log_error("%s", job_errors[k].message.c_str());
+			}
+			techmap_module_commit(design, module, pending_jobs[k].cell, staging[k]);
+		}
+
+		pending_jobs.clear();
+	}
+
 	bool techmap_module(RTLIL::Design *design, RTLIL::Module *module, RTLIL::Design *map, std::set<RTLIL::Cell*> &handled_cells,
 			const std::map<RTLIL::IdString, std::set<RTLIL::IdString, RTLIL::sort_by_id_str>> &celltypeMap, bool in_recursion)
 	{
@@ -675,6 +863,9 @@ struct TechmapWorker
 
 				if (techmap_do_cache.count(tpl) == 0)
 				{
+					// the commands below may modify the templates of the pending cells
+					techmap_module_flush(design, module);
+
 					bool keep_running = true;
 					techmap_do_cache[tpl] = true;
 
@@ -829,6 +1020,8 @@ struct TechmapWorker
 						}
 						while (techmap_module(map, tpl, map, handled_cells, celltypeMap, true)) { }
 					}
+
+					template_cache.erase(tpl);
 				}
 
 				if (techmap_do_cache.at(tpl) == false)
@@ -863,7 +1056,11 @@ struct TechmapWorker
 				else
 				{
 					log("%s %s.%s using %s.\n", mapmsg_prefix.c_str(), log_id(module), log_id(cell), log_id(tpl));
-					techmap_module_worker(design, module, cell, tpl);
+					if (num_threads > 0 && !flatten_mode && !in_recursion) {
+						std::string orig_cell_name = techmap_module_prepare(module, cell, tpl);
+						pending_jobs.push_back(TechmapJob{cell, tpl, orig_cell_name});
+					} else
+						techmap_module_worker(design, module, cell, tpl);
 					cell = NULL;
 				}
 				did_something = true;
@@ -877,6 +1074,8 @@ struct TechmapWorker
 			handled_cells.insert(cell);
 		}
 
+		techmap_module_flush(design, module);
+
 		if (log_continue) {
 			log_header(design, "Continuing TECHMAP pass.\n");
 			log_continue = false;
@@ -932,6 +1131,17 @@ struct TechmapPass : public Pass {
 		log("        map file. Note that the Verilog frontend is also called with the\n");
 		log("        '-ignore_redef' option set.\n");
 		log("\n");
+		log("    -j <N>\n");
+		log("        expand the cells in parallel using N threads. the expansions are\n");
+		log("        created in separate buffers and then added to the module in the\n");
+		log("        order in which the cells were matched, so the result does not depend\n");
+		log("        on N. cells in map modules (see -recursive and 'RECURSION; ' below)\n");
+		log("        are always expanded one at a time.\n");
+		log("\n");
+		log("The parsed map files are kept in memory and reused by later techmap calls\n");
+		log("with the same map files (by name and content) and frontend options. Changes to\n");
+		log("files included from a map file are not detected.\n");
+		log("\n");
 		log("When a module in the map file has the 'techmap_celltype' attribute set, it will\n");
 		log("match cells with a type that match the text value of this attribute. Otherwise\n");
 		log("the module name will be used to match the cell.\n");
@@ -1065,15 +1275,56 @@ struct TechmapPass : public Pass {
 				worker.autoproc_mode = true;
 				continue;
 			}
+			if (args[argidx] == "-j" && argidx+1 < args.size()) {
+				worker.num_threads = std::max(atoi(args[++argidx].c_str()), 1);
+				continue;
+			}
 			break;
 		}
 		extra_args(args, argidx, design);
 
+		bool map_from_files = true;
+		for (auto &fn : map_files)
+			if (fn.substr(0, 1) == "%")
+				map_from_files = false;
+
 		RTLIL::Design *map = new RTLIL::Design;
-		if (map_files.empty()) {
-			std::istringstream f(stdcells_code);
-			Frontend::frontend_call(map, &f, "<techmap.v>", verilog_frontend);
-		} else
+		if (map_from_files)
+		{
+			std::vector<std::pair<std::string, std::string>> map_code;
+			if (map_files.empty())
+				map_code.push_back(std::pair<std::string, std::string>("<techmap.v>", stdcells_code));
+			for (auto fn : map_files) {
+				std::ifstream f;
+				rewrite_filename(fn);
+				f.open(fn.c_str());
+				if (f.fail())
+					log_cmd_error("Can't open map file `%s'\n", fn.c_str());
+				std::stringstream buf;
+				buf << f.rdbuf();
+				map_code.push_back(std::pair<std::string, std::string>(fn, buf.str()));
+			}
+
+			std::string key = verilog_frontend;
+			for (auto &arg : frontend_verilog_defaults())
+				key += " " + arg;
+			for (auto &it : map_code)
+				key += "\n" + it.first + "\n" + sha1(it.second);
+
+			if (map_library_cache.count(key) == 0) {
+				for (auto &it : map_code) {
+					const std::string &fn = it.first;
+					std::istringstream f(it.second);
+					Frontend::frontend_call(map, &f, fn, (fn.size() > 3 && fn.substr(fn.size()-3) == ".il") ? "ilang" : verilog_frontend);
+				}
+				map_library_cache[key] = copy_map_library(map);
+			} else {
+				log("Using cached map library.\n");
+				delete map;
+				map = copy_map_library(map_library_cache.at(key));
+			}
+		}
+		else
 			for (auto &fn : map_files)
 				if (fn.substr(0, 1) == "%") {
 					if (!saved_designs.count(fn.substr(1))) {